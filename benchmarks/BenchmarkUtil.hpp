@@ -0,0 +1,36 @@
+/**
+ * BenchmarkUtil.hpp
+ *
+ * Small helpers shared by the benchmark executables. Each benchmark prints a plain text table to stdout.
+ */
+
+#ifndef TRAFFIC_MONITOR_BENCHMARKUTIL_H
+#define TRAFFIC_MONITOR_BENCHMARKUTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+/**
+ * Runs setup() followed by a timed run() for the given number of iterations and reports the median time of run()
+ * @param iterations int    number of timed runs
+ * @param setup     called before each run, outside of the timed region
+ * @param run       the code being measured
+ * @return median duration of run() in microseconds
+ */
+template<typename Setup, typename Run>
+double median_microseconds(int iterations, Setup setup, Run run) {
+  std::vector<double> samples;
+  samples.reserve(iterations);
+  for (int i = 0; i < iterations; i++) {
+    setup();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    run();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples.empty() ? 0.0 : samples[samples.size() / 2];
+}
+
+#endif //TRAFFIC_MONITOR_BENCHMARKUTIL_H
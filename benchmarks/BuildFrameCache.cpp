@@ -0,0 +1,64 @@
+/**
+ * BuildFrameCache.cpp
+ *
+ * Decodes a video once into a frame cache, which the benchmarks and traffic-monitor --source then replay without
+ * decoding. See FrameCache.hpp for the layout. Frames are stored in BGR, or as their luminance alone to quarter the size
+ * of the cache when only luminance is benchmarked. Usage:
+ *
+ *   build_frame_cache [video, default data/car_only.mp4] [cache, default data/car_only.frames] [bgr|gray, default bgr]
+ */
+
+#include <cstdio>
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+#include "FrameCache.hpp"
+#include "Luminance.hpp"
+
+int main(int argc, char *argv[]) {
+  const std::string video_path = argc > 1 ? argv[1] : "data/car_only.mp4";
+  const std::string cache_path = argc > 2 ? argv[2] : "data/car_only.frames";
+  RawPixelFormat format = RawPixelFormat::BGR;
+  if (argc > 3 && (!FrameSource::parse_raw_format(argv[3], format) || format == RawPixelFormat::YUYV)) {
+    std::fprintf(stderr, "Unsupported format %s, expected bgr or gray\n", argv[3]);
+    return 1;
+  }
+
+  VideoFileFrameSource source(video_path);
+  if (!source.open()) {
+    std::fprintf(stderr, "Could not open %s\n", video_path.c_str());
+    return 1;
+  }
+  const double fps = source.get_fps();
+
+  FrameCacheWriter writer;
+  if (!writer.open(cache_path, source.get_frame_size(), format, fps)) {
+    std::fprintf(stderr, "Could not create %s\n", cache_path.c_str());
+    return 1;
+  }
+
+  SourceFrame frame;
+  cv::Mat luminance;
+  while (source.read(frame)) {
+    bool written;
+    if (format == RawPixelFormat::GRAY) {
+      extract_luminance(frame.image, luminance);
+      written = writer.write(luminance, frame.timestamp);
+    } else {
+      written = writer.write(frame.image, frame.timestamp);
+    }
+    if (!written) {
+      std::fprintf(stderr, "Could not write frame %u to %s\n", frame.index, cache_path.c_str());
+      return 1;
+    }
+  }
+  if (!writer.close()) {
+    std::fprintf(stderr, "Could not finish %s\n", cache_path.c_str());
+    return 1;
+  }
+
+  std::printf("%u frames of %dx%d at %.2f fps written to %s\n", writer.get_frame_count(), source.get_frame_size().width,
+              source.get_frame_size().height, fps, cache_path.c_str());
+  return 0;
+}
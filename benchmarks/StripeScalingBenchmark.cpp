@@ -0,0 +1,75 @@
+/**
+ * StripeScalingBenchmark.cpp
+ *
+ * Measures how stripe-parallel background subtraction scales with the number of stripes. Frames of a video are scaled
+ * to 1080p and held in memory, then subtracted with 1, 2, 4 and 8 stripes, each with OpenCV's thread pool limited to
+ * that many threads so that the single stripe run is the single core baseline. Usage:
+ *
+ *   benchmark_stripe_scaling [video or .frames cache, default data/car_only.mp4] [frames, default 120]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "BackgroundSubtractor.hpp"
+#include "FrameSource.hpp"
+
+int main(int argc, char *argv[]) {
+  const std::string video_path = argc > 1 ? argv[1] : "data/car_only.mp4";
+  const int max_frames = argc > 2 ? std::atoi(argv[2]) : 120;
+
+  cv::Ptr<FrameSource> source = FrameSource::create(video_path);
+  if (!source->open()) {
+    std::fprintf(stderr, "Could not open %s\n", video_path.c_str());
+    return 1;
+  }
+  std::vector<cv::Mat> frames;
+  SourceFrame frame;
+  while ((int) frames.size() < max_frames && source->read(frame)) {
+    cv::Mat scaled;
+    cv::resize(frame.image, scaled, cv::Size(1920, 1080));
+    frames.push_back(scaled);
+  }
+  if (frames.empty()) {
+    std::fprintf(stderr, "No frames in %s\n", video_path.c_str());
+    return 1;
+  }
+
+  const BackgroundEngine engines[] = {BackgroundEngine::MOG2, BackgroundEngine::RUNNING_AVERAGE};
+  const int stripe_counts[] = {1, 2, 4, 8};
+
+  std::printf("%16s %8s %8s %12s %10s %10s\n", "engine", "stripes", "frames", "ms_per_frame", "speedup", "efficiency");
+  for (BackgroundEngine engine : engines) {
+    double baseline_ms = 0.0;
+    for (int stripes : stripe_counts) {
+      cv::setNumThreads(stripes);
+      BackgroundSubtractor subtractor;
+      subtractor.set_engine(engine);
+      subtractor.set_stripes(stripes);
+      cv::Mat foreground;
+
+      // The first frame allocates the models, so it is left out of the timing
+      subtractor.subtract(frames.front(), foreground);
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (size_t i = 1; i < frames.size(); i++) {
+        subtractor.subtract(frames[i], foreground);
+      }
+      std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+      const size_t timed_frames = frames.size() > 1 ? frames.size() - 1 : 1;
+      const double ms_per_frame = std::chrono::duration<double, std::milli>(end - start).count() / timed_frames;
+      if (stripes == 1) {
+        baseline_ms = ms_per_frame;
+      }
+      const double speedup = ms_per_frame > 0.0 ? baseline_ms / ms_per_frame : 0.0;
+      std::printf("%16s %8d %8zu %12.2f %10.2f %10.2f\n", BackgroundModel::engine_name(engine), stripes, timed_frames,
+                  ms_per_frame, speedup, speedup / stripes);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * TrackerBenchmark.cpp
+ *
+ * Measures the per-frame cost of Tracker::match_current_frame_to_existing_blobs. Vehicles are laid out at a constant
+ * density, so as the number of vehicles grows the field of view grows with it, and a configurable number of finished
+ * tracks is kept alongside the live ones. The grid based matcher should stay flat as the number of finished tracks
+ * grows and grow linearly with the number of live vehicles, while the original brute-force scan grows with the product
+ * of the two.
+ *
+ * A second table compares the greedy and global matching strategies on simulated dense multi-lane traffic with noisy
+ * detections, reporting identity switches, detections lost to a double-claimed track, and the per-frame matching cost.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include <opencv2/opencv.hpp>
+
+#include "BenchmarkUtil.hpp"
+#include "TrackStore.hpp"
+#include "Tracker.hpp"
+
+static Blob make_vehicle(int x, int y) {
+  std::vector<cv::Point> contour;
+  contour.emplace_back(cv::Point(x, y));
+  contour.emplace_back(cv::Point(x + 60, y));
+  contour.emplace_back(cv::Point(x + 60, y + 40));
+  contour.emplace_back(cv::Point(x, y + 40));
+  return Blob(contour);
+}
+
+/**
+ * The matcher as it was before the spatial index: every current blob is compared against every existing blob
+ */
+static void brute_force_match(Tracker &tracker, std::vector<Blob> &existingBlobs, std::vector<Blob> &currentFrameBlobs) {
+  for (Blob &existingBlob : existingBlobs) {
+    existingBlob.blnCurrentMatchFoundOrNewBlob = false;
+    existingBlob.predict_next_position();
+  }
+
+  for (Blob &currentFrameBlob : currentFrameBlobs) {
+    int intIndexOfLeastDistance = 0;
+    double dblLeastDistance = 100000.0;
+    for (unsigned int i = 0; i < existingBlobs.size(); i++) {
+      if (existingBlobs[i].blnStillBeingTracked) {
+        double dblDistance =
+            std::sqrt(std::pow(std::abs(currentFrameBlob.centerPositions.back().x - existingBlobs[i].predictedNextPosition.x), 2) +
+                std::pow(std::abs(currentFrameBlob.centerPositions.back().y - existingBlobs[i].predictedNextPosition.y), 2));
+        if (dblDistance < dblLeastDistance) {
+          dblLeastDistance = dblDistance;
+          intIndexOfLeastDistance = i;
+        }
+      }
+    }
+
+    if (dblLeastDistance < currentFrameBlob.dblCurrentDiagonalSize * 0.5) {
+      tracker.add_blob_to_existing_blobs(currentFrameBlob, existingBlobs, intIndexOfLeastDistance);
+    } else {
+      tracker.add_new_blob(currentFrameBlob, existingBlobs);
+    }
+  }
+
+  for (Blob &existingBlob : existingBlobs) {
+    if (!existingBlob.blnCurrentMatchFoundOrNewBlob) {
+      existingBlob.intNumOfConsecutiveFramesWithoutAMatch++;
+    }
+    if (existingBlob.intNumOfConsecutiveFramesWithoutAMatch >= 5) {
+      existingBlob.blnStillBeingTracked = false;
+    }
+  }
+}
+
+/**
+ * Builds a scene of live vehicles on a square lattice, 120 pixels apart, plus finished tracks scattered over the same
+ * area. The current frame contains every live vehicle moved 4 pixels to the right.
+ */
+static void build_scene(int live, int finished, std::vector<Blob> &existing, std::vector<Blob> &current) {
+  existing.clear();
+  current.clear();
+  const int columns = std::max(1, (int) std::ceil(std::sqrt((double) live)));
+  for (int i = 0; i < live; i++) {
+    int x = (i % columns) * 120;
+    int y = (i / columns) * 120;
+    existing.push_back(make_vehicle(x, y));
+    current.push_back(make_vehicle(x + 4, y));
+  }
+  for (int i = 0; i < finished; i++) {
+    Blob blob = make_vehicle((i * 37) % (columns * 120), (i * 53) % (columns * 120));
+    blob.blnStillBeingTracked = false;
+    existing.push_back(blob);
+  }
+}
+
+struct SimulatedVehicle {
+  double x;
+  int y;
+  double speed;
+  unsigned int track_id;
+};
+
+struct StrategyResult {
+  unsigned long long detections;
+  unsigned long long id_switches;
+  unsigned long long lost_detections;
+  double mean_match_us;
+};
+
+/**
+ * Simulates vehicles travelling left to right in adjacent lanes and runs the tracker over the noisy detections
+ */
+static StrategyResult simulate_traffic(MatchingStrategy strategy, int lanes, int frames) {
+  const int frame_width = 1920;
+  const int lane_spacing = 48;
+  std::mt19937 random(7);
+  std::uniform_real_distribution<double> gap(70.0, 110.0);
+  std::uniform_int_distribution<int> jitter(-4, 4);
+  std::uniform_real_distribution<double> acceleration(-1.5, 1.5);
+
+  std::vector<std::vector<SimulatedVehicle>> traffic(lanes);
+  std::vector<double> lane_speed(lanes);
+  for (int lane = 0; lane < lanes; lane++) {
+    lane_speed[lane] = 8.0 + 2.0 * lane;
+  }
+
+  Tracker tracker;
+  tracker.set_matching_strategy(strategy);
+  TrackStore store;
+  unsigned int next_track_id = 1;
+  StrategyResult result = {0, 0, 0, 0.0};
+  double total_match_us = 0.0;
+
+  for (int frame = 0; frame < frames; frame++) {
+    // Move the traffic, retire vehicles which have left and let new vehicles enter
+    std::vector<Blob> detections;
+    std::vector<SimulatedVehicle *> detected_vehicles;
+    for (int lane = 0; lane < lanes; lane++) {
+      std::vector<SimulatedVehicle> &vehicles = traffic[lane];
+      for (SimulatedVehicle &vehicle : vehicles) {
+        vehicle.speed = std::max(2.0, vehicle.speed + acceleration(random));
+        vehicle.x += vehicle.speed;
+      }
+      while (!vehicles.empty() && vehicles.front().x > frame_width) {
+        vehicles.erase(vehicles.begin());
+      }
+      if (vehicles.empty() || vehicles.back().x > gap(random)) {
+        SimulatedVehicle vehicle = {0.0, 20 + lane * lane_spacing, lane_speed[lane], 0};
+        vehicles.push_back(vehicle);
+      }
+      for (SimulatedVehicle &vehicle : vehicles) {
+        detections.push_back(make_vehicle((int) vehicle.x + jitter(random), vehicle.y + jitter(random)));
+        detected_vehicles.push_back(&vehicle);
+      }
+    }
+
+    std::vector<Blob> &blobs = store.get_blobs();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    tracker.match_current_frame_to_existing_blobs(blobs, detections);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    total_match_us += std::chrono::duration<double, std::micro>(end - start).count();
+
+    for (Blob &blob : blobs) {
+      if (blob.id == 0) {
+        blob.id = next_track_id++;
+      }
+    }
+
+    // Find the track which now holds each detection. A detection with no track was overwritten by another detection.
+    for (unsigned int i = 0; i < detections.size(); i++) {
+      result.detections++;
+      unsigned int track_id = 0;
+      for (const Blob &blob : blobs) {
+        if (blob.blnCurrentMatchFoundOrNewBlob && blob.currentBoundingRect == detections[i].currentBoundingRect) {
+          track_id = blob.id;
+          break;
+        }
+      }
+      SimulatedVehicle &vehicle = *detected_vehicles[i];
+      if (track_id == 0) {
+        result.lost_detections++;
+      } else if (vehicle.track_id != 0 && vehicle.track_id != track_id) {
+        result.id_switches++;
+      }
+      if (track_id != 0) {
+        vehicle.track_id = track_id;
+      }
+    }
+    store.compact();
+  }
+
+  result.mean_match_us = total_match_us / frames;
+  return result;
+}
+
+int main() {
+  const int live_counts[] = {4, 16, 64, 256};
+  const int finished_counts[] = {0, 1000, 10000};
+  const int iterations = 50;
+
+  std::printf("%8s %10s %16s %16s\n", "live", "finished", "brute_force_us", "grid_us");
+  for (int live : live_counts) {
+    for (int finished : finished_counts) {
+      Tracker tracker;
+      std::vector<Blob> scene_existing;
+      std::vector<Blob> scene_current;
+      build_scene(live, finished, scene_existing, scene_current);
+
+      std::vector<Blob> existing;
+      std::vector<Blob> current;
+      auto setup = [&]() {
+        existing = scene_existing;
+        current = scene_current;
+      };
+
+      double brute_force = median_microseconds(iterations, setup, [&]() {
+        brute_force_match(tracker, existing, current);
+      });
+      double grid = median_microseconds(iterations, setup, [&]() {
+        tracker.match_current_frame_to_existing_blobs(existing, current);
+      });
+      std::printf("%8d %10d %16.1f %16.1f\n", live, finished, brute_force, grid);
+    }
+  }
+
+  std::printf("\n%8s %8s %12s %12s %12s %16s\n", "strategy", "lanes", "detections", "id_switches", "lost", "match_us");
+  const int lane_counts[] = {2, 6, 12};
+  for (int lanes : lane_counts) {
+    StrategyResult greedy = simulate_traffic(MatchingStrategy::GREEDY, lanes, 600);
+    StrategyResult global = simulate_traffic(MatchingStrategy::GLOBAL, lanes, 600);
+    std::printf("%8s %8d %12llu %12llu %12llu %16.1f\n", "greedy", lanes, greedy.detections, greedy.id_switches,
+                greedy.lost_detections, greedy.mean_match_us);
+    std::printf("%8s %8d %12llu %12llu %12llu %16.1f\n", "global", lanes, global.detections, global.id_switches,
+                global.lost_detections, global.mean_match_us);
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * WorkingScaleBenchmark.cpp
+ *
+ * Measures detection, i.e. background subtraction followed by blob extraction, on 480p, 720p and 1080p input, either at
+ * native resolution or on a copy downscaled to 480 rows as AppConfig does with a working scale. The frames of a video
+ * are resized to each input resolution and held in memory. The blob filter is rescaled for each working size, so the
+ * blob counts should agree across resolutions. Usage:
+ *
+ *   benchmark_working_scale [video or .frames cache, default data/car_only.mp4] [frames, default 120]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "BackgroundSubtractor.hpp"
+#include "BlobExtractor.hpp"
+#include "FrameSource.hpp"
+
+int main(int argc, char *argv[]) {
+  const std::string video_path = argc > 1 ? argv[1] : "data/car_only.mp4";
+  const int max_frames = argc > 2 ? std::atoi(argv[2]) : 120;
+
+  cv::Ptr<FrameSource> source = FrameSource::create(video_path);
+  if (!source->open()) {
+    std::fprintf(stderr, "Could not open %s\n", video_path.c_str());
+    return 1;
+  }
+  std::vector<cv::Mat> source_frames;
+  SourceFrame frame;
+  while ((int) source_frames.size() < max_frames && source->read(frame)) {
+    source_frames.push_back(frame.image.clone());
+  }
+  if (source_frames.empty()) {
+    std::fprintf(stderr, "No frames in %s\n", video_path.c_str());
+    return 1;
+  }
+
+  const cv::Size input_sizes[] = {cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080)};
+
+  std::printf("%10s %10s %8s %12s %10s %8s\n", "input", "working", "frames", "ms_per_frame", "fps", "blobs");
+  for (const cv::Size &input_size : input_sizes) {
+    std::vector<cv::Mat> frames;
+    for (const cv::Mat &source : source_frames) {
+      cv::Mat resized;
+      cv::resize(source, resized, input_size);
+      frames.push_back(resized);
+    }
+
+    std::vector<double> scales(1, 1.0);
+    if (input_size.height > 480) {
+      scales.push_back(480.0 / input_size.height);
+    }
+    for (double scale : scales) {
+      const cv::Size working_size(cvRound(input_size.width * scale), cvRound(input_size.height * scale));
+      const double frame_scale = input_size.width / (double) working_size.width;
+
+      BackgroundSubtractor subtractor;
+      BlobExtractor extractor(BlobFilter().scaled_to(working_size));
+      cv::Mat working_frame;
+      cv::Mat foreground;
+      std::vector<Blob> blobs;
+      unsigned long long blob_count = 0;
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (cv::Mat &input : frames) {
+        cv::Mat *detection_frame = &input;
+        if (working_size != input_size) {
+          cv::resize(input, working_frame, working_size, 0, 0, cv::INTER_AREA);
+          detection_frame = &working_frame;
+        }
+        subtractor.subtract(*detection_frame, foreground);
+        blobs.clear();
+        extractor.extract(foreground, blobs, cv::Point(0, 0), frame_scale);
+        blob_count += blobs.size();
+      }
+      std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+      const double ms_per_frame = std::chrono::duration<double, std::milli>(end - start).count() / frames.size();
+      const std::string input_name = std::to_string(input_size.height) + "p";
+      const std::string working_name = std::to_string(working_size.height) + "p";
+      std::printf("%10s %10s %8zu %12.2f %10.1f %8llu\n", input_name.c_str(), working_name.c_str(), frames.size(),
+                  ms_per_frame, ms_per_frame > 0.0 ? 1000.0 / ms_per_frame : 0.0, blob_count);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,42 @@
+/**
+ * AllocationCounter.hpp
+ *
+ * Counts heap allocations made through the global operator new. Used to confirm that the steady state frame loop does
+ * not allocate once its buffers have been warmed up. Counting is compiled in when TRAFFIC_MONITOR_COUNT_ALLOCATIONS is
+ * defined, which the tests of the frame loop do for themselves (see tests/frame_pool/CMakeLists.txt) and the top level
+ * CMakeLists.txt can do for every build. Otherwise every count reads as zero and operator new is left alone.
+ */
+
+#ifndef TRAFFIC_MONITOR_ALLOCATIONCOUNTER_H
+#define TRAFFIC_MONITOR_ALLOCATIONCOUNTER_H
+
+bool allocation_counting_enabled();
+
+// Allocations made by every thread since the process started
+unsigned long long allocation_count();
+
+// Allocations made by the calling thread since it started
+unsigned long long thread_allocation_count();
+
+/**
+ * Adds the number of allocations the calling thread makes while this object is in scope to a running total
+ */
+class ScopedAllocationCounter {
+ public:
+  explicit ScopedAllocationCounter(unsigned long long &total_)
+      : total(total_),
+        start(thread_allocation_count()) {}
+
+  ~ScopedAllocationCounter() {
+    total += thread_allocation_count() - start;
+  }
+
+  ScopedAllocationCounter(const ScopedAllocationCounter &) = delete;
+  ScopedAllocationCounter &operator=(const ScopedAllocationCounter &) = delete;
+
+ private:
+  unsigned long long &total;
+  const unsigned long long start;
+};
+
+#endif //TRAFFIC_MONITOR_ALLOCATIONCOUNTER_H
@@ -1,14 +1,28 @@
 #ifndef TRAFFIC_MONITOR_RUN_H
 #define TRAFFIC_MONITOR_RUN_H
 
+#include <atomic>
+#include <chrono>
+
 #include "Tracker.hpp"
 #include "BackgroundSubtractor.hpp"
+#include "BlobExtractor.hpp"
+#include "BoundedQueue.hpp"
+#include "ClipRecorder.hpp"
+#include "FramePacket.hpp"
+#include "FrameSource.hpp"
+#include "FramePool.hpp"
+#include "MotionGate.hpp"
+#include "QualityController.hpp"
+#include "SnapshotWriter.hpp"
+#include "SpeedEventLog.hpp"
+#include "TrackStore.hpp"
+#include "Transform.hpp"
 
 class AppConfig {
  private:
   Tracker tracker;
   BackgroundSubtractor bgs;
-  cv::VideoCapture capVideo;
   std::vector<cv::Point> start_points;
   std::vector<cv::Point> end_points;
   std::vector<cv::Point> crossing_lines;
@@ -17,7 +31,76 @@ class AppConfig {
   int FRAME_HEIGHT;
   std::string SOURCE_VIDEO_PATH;
   int calibration_region_area;
-  bool live_capture;
+  // Frames are read from frame_source, or from the source for SOURCE_VIDEO_PATH when none is set, through a decoder
+  // thread prefetching up to prefetch_frames ahead. capture_source is the source being read during a run.
+  cv::Ptr<FrameSource> frame_source;
+  size_t prefetch_frames;
+  cv::Ptr<FrameSource> capture_source;
+
+  // Pipeline configuration and per-run state shared between the stages
+  bool pipelined;
+  size_t queue_capacity;
+  std::atomic<bool> stop_requested;
+  std::atomic<bool> preview_requested;
+  bool headless;
+  unsigned int preview_interval;
+  bool first_frame;
+  double pixels_to_meters;
+  TrackStore track_store;
+  std::vector<cv::Point> calibration_start_points;
+  std::vector<cv::Point> calibration_end_points;
+  std::vector<QueueStats> queue_stats;
+  unsigned long long frame_allocations;
+  // Chrome trace-event file written at the end of a run, when profiling is compiled in. Empty to keep no trace.
+  std::string trace_path;
+  Transform transformer;
+
+  BlobExtractor blob_extractor;
+  BlobFilter blob_filter;
+  RegionOfInterest region_of_interest;
+  // Detection runs on frames scaled by working_scale, of working_size
+  double working_scale;
+  cv::Size working_size;
+  // Detection runs on a single luminance channel. capture_raw is set when the source delivers it without conversion.
+  bool luminance_only;
+  bool capture_raw;
+  // While the gate is idle, frames are held back for pre-roll and only update the background model now and then
+  bool motion_gating;
+  MotionGate motion_gate;
+  unsigned long long idle_frames;
+  // Degrades processing in steps while frames take longer than the frame interval. The controller is fed by the
+  // encoding stage and quality_level publishes its level to the other stages. The detection stage alone changes the
+  // working size and the background model to match, and remembers the level it applied.
+  bool adaptive_quality;
+  QualityController quality_controller;
+  std::atomic<int> quality_level;
+  QualityLevel applied_quality_level;
+  cv::Size frame_size;
+  SpeedEventLog speed_event_log;
+  SnapshotWriter snapshot_writer;
+  // Every frame is written to output.h264 while recording continuously. Clips only keep the frames around each vehicle.
+  bool continuous_recording;
+  bool clip_recording;
+  ClipRecorder clip_recorder;
+
+  static const size_t MAX_BLOBS_PER_FRAME = 64;
+
+  bool should_stop() const;
+  bool capture_frame(FramePacket &packet);
+  void detect_blobs(FramePacket &packet);
+  void subtract_background(FramePacket &packet);
+  void skip_detection(FramePacket &packet);
+  bool apply_working_scale(const double scale);
+  void apply_quality_level();
+  void record_processing_time(const FramePacket &packet, const double output_seconds);
+  template<typename Emit>
+  void gate_detection(FramePacket *packet, BoundedQueue<FramePacket *> &pre_roll, Emit emit);
+  template<typename Emit>
+  void flush_pre_roll(BoundedQueue<FramePacket *> &pre_roll, bool detect, Emit emit);
+  void track_blobs(FramePacket &packet);
+  void output_frame(FramePacket &packet, cv::VideoWriter &out_video);
+  void run_sequential(cv::VideoWriter &out_video, FramePool &pool);
+  void run_pipelined(cv::VideoWriter &out_video, FramePool &pool);
 
  public:
   AppConfig();
@@ -46,6 +129,15 @@ class AppConfig {
   const std::string &get_SOURCE_VIDEO_PATH() const;
   void set_SOURCE_VIDEO_PATH(const std::string &PATH_);
 
+  const cv::Ptr<FrameSource> &get_frame_source() const;
+  void set_frame_source(const cv::Ptr<FrameSource> &frame_source_);
+
+  const size_t &get_prefetch_frames() const;
+  void set_prefetch_frames(const size_t prefetch_frames_);
+
+  const std::string &get_trace_path() const;
+  void set_trace_path(const std::string &trace_path_);
+
   const std::vector<cv::Point> &get_start_points() const;
   void set_start_points(const std::vector<cv::Point> &start_points);
 
@@ -64,6 +156,62 @@ class AppConfig {
   const int &get_calibration_region_area() const;
   void set_calibration_region_area(const int area_);
 
+  const bool &get_pipelined() const;
+  void set_pipelined(const bool pipelined_);
+
+  const size_t &get_queue_capacity() const;
+  void set_queue_capacity(const size_t capacity_);
+
+  const std::vector<QueueStats> &get_queue_stats() const;
+
+  const unsigned long long &get_frame_allocations() const;
+
+  const TrackStore &get_track_store() const;
+  void set_track_store(const TrackStore &track_store_);
+
+  const BlobFilter &get_blob_filter() const;
+  void set_blob_filter(const BlobFilter &filter_);
+
+  const RegionOfInterest &get_region_of_interest() const;
+  void set_region_of_interest(const RegionOfInterest &region_);
+
+  const double &get_working_scale() const;
+  void set_working_scale(const double working_scale_);
+
+  const bool &get_luminance_only() const;
+  void set_luminance_only(const bool luminance_only_);
+
+  const bool &get_motion_gating() const;
+  void set_motion_gating(const bool motion_gating_);
+
+  const MotionGate &get_motion_gate() const;
+  void set_motion_gate(const MotionGate &motion_gate_);
+
+  const bool &get_adaptive_quality() const;
+  void set_adaptive_quality(const bool adaptive_quality_);
+
+  const QualityController &get_quality_controller() const;
+  void set_quality_controller(const QualityController &quality_controller_);
+
+  SpeedEventLog &get_speed_event_log();
+  SnapshotWriter &get_snapshot_writer();
+
+  const bool &get_continuous_recording() const;
+  void set_continuous_recording(const bool continuous_recording_);
+
+  const bool &get_clip_recording() const;
+  void set_clip_recording(const bool clip_recording_);
+
+  ClipRecorder &get_clip_recorder();
+
+  const bool &get_headless() const;
+  void set_headless(const bool headless_);
+
+  const unsigned int &get_preview_interval() const;
+  void set_preview_interval(const unsigned int interval_);
+
+  void request_preview();
+  void request_stop();
 
   void run();
 };
@@ -0,0 +1,55 @@
+/**
+ * AssignmentSolver.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_ASSIGNMENTSOLVER_H
+#define TRAFFIC_MONITOR_ASSIGNMENTSOLVER_H
+
+#include <vector>
+
+/**
+ * A permitted pairing of a row (a blob in the current frame) with a column (an existing track) and its cost
+ */
+struct AssignmentEdge {
+  int row;
+  int col;
+  double cost;
+};
+
+class AssignmentSolver {
+ public:
+  AssignmentSolver();
+  explicit AssignmentSolver(double unassigned_cost_);
+
+  const double &get_unassigned_cost() const;
+  void set_unassigned_cost(const double unassigned_cost_);
+
+  void solve(int rows, int cols, const std::vector<AssignmentEdge> &edges, std::vector<int> &row_to_col);
+
+ private:
+  int find_root(int node);
+  void solve_component(const std::vector<int> &component_rows,
+                       const std::vector<int> &component_cols,
+                       const std::vector<int> &component_edges,
+                       const std::vector<AssignmentEdge> &edges,
+                       std::vector<int> &row_to_col);
+
+  double unassigned_cost;
+
+  // Scratch storage reused between calls
+  std::vector<int> parent;
+  std::vector<int> local_index;
+  std::vector<int> component_of_node;
+  std::vector<std::vector<int>> rows_by_component;
+  std::vector<std::vector<int>> cols_by_component;
+  std::vector<std::vector<int>> edges_by_component;
+  std::vector<double> cost;
+  std::vector<double> u;
+  std::vector<double> v;
+  std::vector<int> p;
+  std::vector<int> way;
+  std::vector<double> minv;
+  std::vector<char> used;
+};
+
+#endif //TRAFFIC_MONITOR_ASSIGNMENTSOLVER_H
@@ -0,0 +1,83 @@
+/**
+ * BackgroundModel.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_BACKGROUNDMODEL_H
+#define TRAFFIC_MONITOR_BACKGROUNDMODEL_H
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * The background model engines BackgroundSubtractor can run.
+ * MOG2 is OpenCV's Gaussian mixture model with shadow detection. It is the most robust, and the most expensive.
+ * RUNNING_AVERAGE keeps an integer running average of the grayscale frame and marks pixels which differ from it. It is
+ * several times cheaper and suits low-power boards watching a steady scene.
+ */
+enum class BackgroundEngine {
+  MOG2,
+  RUNNING_AVERAGE
+};
+
+class BackgroundModel {
+ public:
+  virtual ~BackgroundModel();
+
+  /**
+   * Updates the model with a frame and produces its raw foreground mask
+   * @param frame cv::Mat     the captured frame
+   * @param foreground cv::Mat    receives an 8 bit single channel mask where 255 is foreground. Reused without
+   * reallocation when it already has the size of the frame and type CV_8UC1.
+   */
+  void apply(const cv::Mat &frame, cv::Mat &foreground);
+
+  /**
+   * Produces the raw foreground mask of a frame, optionally without learning from it
+   * @param frame cv::Mat     the captured frame
+   * @param foreground cv::Mat    receives an 8 bit single channel mask where 255 is foreground
+   * @param update_model bool     whether the model learns from this frame. Skipping updates saves work when the
+   * pipeline is falling behind, at the cost of adapting more slowly.
+   */
+  virtual void apply(const cv::Mat &frame, cv::Mat &foreground, bool update_model) = 0;
+
+  virtual BackgroundEngine get_engine() const = 0;
+
+  static cv::Ptr<BackgroundModel> create(BackgroundEngine engine);
+  static const char *engine_name(BackgroundEngine engine);
+};
+
+class Mog2BackgroundModel : public BackgroundModel {
+ public:
+  Mog2BackgroundModel();
+
+  using BackgroundModel::apply;
+  void apply(const cv::Mat &frame, cv::Mat &foreground, bool update_model) override;
+  BackgroundEngine get_engine() const override;
+
+ private:
+  cv::Ptr<cv::BackgroundSubtractorMOG2> mog_subtractor;
+};
+
+class RunningAverageBackgroundModel : public BackgroundModel {
+ public:
+  RunningAverageBackgroundModel();
+  RunningAverageBackgroundModel(int learning_shift_, int difference_threshold_);
+
+  const int &get_learning_shift() const;
+  void set_learning_shift(const int learning_shift_);
+
+  const int &get_difference_threshold() const;
+  void set_difference_threshold(const int difference_threshold_);
+
+  using BackgroundModel::apply;
+  void apply(const cv::Mat &frame, cv::Mat &foreground, bool update_model) override;
+  BackgroundEngine get_engine() const override;
+
+ private:
+  int learning_shift;
+  int difference_threshold;
+  cv::Mat gray;
+  // The average in 8.8 fixed point, so slow learning rates still move it
+  cv::Mat background;
+};
+
+#endif //TRAFFIC_MONITOR_BACKGROUNDMODEL_H
@@ -5,8 +5,14 @@
 #ifndef TRAFFIC_MONITOR_BACKGROUNDSUBTRACTOR_H
 #define TRAFFIC_MONITOR_BACKGROUNDSUBTRACTOR_H
 
+#include <vector>
+
 #include <opencv2/opencv.hpp>
 
+#include "BackgroundModel.hpp"
+#include "MaskPostProcessor.hpp"
+#include "RegionOfInterest.hpp"
+
 class BackgroundSubtractor {
  public:
   BackgroundSubtractor();
@@ -14,11 +20,45 @@ class BackgroundSubtractor {
   virtual ~BackgroundSubtractor();
   void set_foreground_frame(const cv::Mat &foreground_frame_);
   const cv::Mat &get_foreground_frame() const;
+  const BackgroundEngine &get_engine() const;
+  void set_engine(const BackgroundEngine engine_);
+  const int &get_stripes() const;
+  void set_stripes(const int stripes_);
+  const RegionOfInterest &get_region_of_interest() const;
+  void set_region_of_interest(const RegionOfInterest &region_);
+  bool set_working_size(const cv::Size &size, const RegionOfInterest &region_);
+  const cv::Rect &get_processed_rect() const;
+  const unsigned int &get_update_interval() const;
+  void set_update_interval(const unsigned int update_interval_);
   void subtract(cv::Mat &input_frame, cv::Mat &output_frame);
 
  private:
+  void subtract_striped(const cv::Mat &input, cv::Mat &output, bool update_model);
+  void reset_models();
+
+  // The models learnt at a working size other than the current one
+  struct KeptModels {
+    cv::Size size;
+    cv::Ptr<BackgroundModel> model;
+    std::vector<cv::Ptr<BackgroundModel>> stripe_models;
+  };
+
   cv::Mat foreground_frame;
-  cv::Ptr<cv::BackgroundSubtractorMOG2> mog_subtractor;
+  BackgroundEngine engine;
+  cv::Ptr<BackgroundModel> model;
+  MaskPostProcessor post_processor;
+  // Stripe-parallel mode: one model and one set of post-processing row buffers per horizontal stripe
+  int stripes;
+  std::vector<cv::Ptr<BackgroundModel>> stripe_models;
+  std::vector<std::vector<unsigned char>> stripe_scratch;
+  cv::Mat raw_foreground;
+  RegionOfInterest region;
+  // Size of the frames set_working_size() last prepared the models for. Empty until it is first called.
+  cv::Size working_size;
+  std::vector<KeptModels> kept_models;
+  // The models learn from every update_interval-th frame
+  unsigned int update_interval;
+  unsigned long long frames_subtracted;
   double alpha;
   int threshold;
   bool enable_threshold;
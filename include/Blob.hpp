@@ -7,25 +7,40 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "SpeedFit.hpp"
+
 
 class Blob {
  public:
   std::vector<cv::Point> currentContour;
   cv::Rect currentBoundingRect;
   std::vector<cv::Point> centerPositions;
+  // The first centre position this blob was seen at. Kept separately as centerPositions may be trimmed.
+  cv::Point origin_position;
   bool blnCurrentMatchFoundOrNewBlob;
   bool blnStillBeingTracked;
   double dblCurrentDiagonalSize;
   int intNumOfConsecutiveFramesWithoutAMatch;
   unsigned int start_frame;
   unsigned int end_frame;
+  // Capture timestamps of the frames the blob entered and left the calibration region in, in seconds
+  double start_time;
+  double end_time;
   double speed;
+  // Standard error of the speed in kilometers per hour, and how far the positions strayed from a constant speed in
+  // pixels. Both are 0 when the speed was timed from the entry and exit frames alone.
+  double speed_error;
+  double speed_residual;
+  // Every position within the calibration region against time, which the speed is fitted from
+  SpeedFit speed_fit;
   bool tracking_speed;
   double start_dist;
   double end_dist;
   cv::Point predictedNextPosition;
   unsigned int id;
   bool moving_left;
+  // Index of this blob's state in the tracker's MotionModel for the current frame, or -1 if it has none
+  int motion_slot;
 
   explicit Blob(std::vector<cv::Point> _contour);
   void predict_next_position();
@@ -0,0 +1,80 @@
+/**
+ * BlobExtractor.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_BLOBEXTRACTOR_H
+#define TRAFFIC_MONITOR_BLOBEXTRACTOR_H
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "Blob.hpp"
+
+/**
+ * Thresholds a connected foreground region must pass to be treated as a vehicle. The area is that of the region's
+ * bounding box, and the fill is the area of its convex hull as a fraction of the bounding box. The sizes are in pixels
+ * of a frame of reference_size; scaled_to() converts them for frames of another size.
+ */
+struct BlobFilter {
+  int min_area = 1000;
+  int max_area = 25000;
+  int min_width = 50;
+  int min_height = 50;
+  double min_fill = 0.5;
+  cv::Size reference_size = cv::Size(640, 480);
+
+  BlobFilter scaled_to(const cv::Size &frame_size) const;
+};
+
+class BlobExtractor {
+ public:
+  BlobExtractor();
+  explicit BlobExtractor(const BlobFilter &filter_);
+
+  const BlobFilter &get_filter() const;
+  void set_filter(const BlobFilter &filter_);
+
+  const int &get_component_count() const;
+  const int &get_hull_count() const;
+
+  void extract(const cv::Mat &foreground, std::vector<Blob> &blobs);
+  void extract(const cv::Mat &foreground, std::vector<Blob> &blobs, const cv::Point &offset, double frame_scale);
+
+ private:
+  // A horizontal run of foreground pixels along one row, from begin up to but not including end
+  struct ForegroundRun {
+    int row;
+    int begin;
+    int end;
+    // While labelling, a run of the same region found earlier (or the run itself). Afterwards, the region's index.
+    int parent;
+  };
+
+  // Bounding box of a connected foreground region, inclusive of right and bottom, and the first of its runs
+  struct ForegroundRegion {
+    int left;
+    int top;
+    int right;
+    int bottom;
+    int first_run;
+  };
+
+  bool passes_size_filter(int width, int height) const;
+  void label_runs(const cv::Mat &foreground);
+  int find_root(int run);
+  void compute_hull(int region, const cv::Point &offset);
+
+  BlobFilter filter;
+  int component_count;
+  int hull_count;
+
+  // Scratch buffers reused between frames. They only grow, so once they have held the busiest frame extraction makes
+  // no allocations of its own.
+  std::vector<ForegroundRun> runs;
+  std::vector<ForegroundRegion> regions;
+  std::vector<cv::Point> hull_points;
+  std::vector<cv::Point> hull;
+};
+
+#endif //TRAFFIC_MONITOR_BLOBEXTRACTOR_H
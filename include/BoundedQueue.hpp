@@ -0,0 +1,213 @@
+/**
+ * BoundedQueue.hpp
+ *
+ * A fixed capacity, thread safe FIFO used to hand frames between the stages of the processing pipeline. Producers block
+ * while the queue is full which keeps memory bounded and applies back-pressure to the capture stage. Closing the queue
+ * wakes every waiting thread; consumers continue to drain the remaining items before pop() reports the end of stream.
+ * Storage is a ring allocated once at construction and items are swapped in and out of their slots, so steady state
+ * pushes and pops never touch the heap. A successful try_push()/pop() hands back whatever previously occupied the slot.
+ */
+
+#ifndef TRAFFIC_MONITOR_BOUNDEDQUEUE_H
+#define TRAFFIC_MONITOR_BOUNDEDQUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Summary of how full a queue was over the course of a run
+ */
+struct QueueStats {
+  std::string name;
+  size_t capacity;
+  size_t max_depth;
+  double mean_depth;
+};
+
+template<typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity_)
+      : slots(capacity_ > 0 ? capacity_ : 1),
+        capacity(capacity_ > 0 ? capacity_ : 1),
+        head(0),
+        count(0),
+        closed(false),
+        max_depth(0),
+        depth_sum(0),
+        push_count(0) {}
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  /**
+   * Adds an item to the back of the queue, waiting for space if the queue is full
+   * @param item T   the item to move into the queue
+   * @return false if the queue was closed before the item could be added
+   */
+  bool push(T item) {
+    return push_swap(item);
+  }
+
+  /**
+   * Adds an item to the back of the queue, waiting for space if the queue is full, and hands back whatever previously
+   * occupied its slot. Lets a producer recycle buffers the consumer has finished with instead of allocating new ones.
+   * @param item T   the item to move into the queue. Receives the previous content of the slot.
+   * @return false if the queue was closed before the item could be added
+   */
+  bool push_swap(T &item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_full.wait(lock, [this]() { return closed || count < capacity; });
+    if (closed) {
+      return false;
+    }
+    enqueue(item);
+    lock.unlock();
+    not_empty.notify_one();
+    return true;
+  }
+
+  /**
+   * Adds an item to the back of the queue without waiting
+   * @param item T   the item to move into the queue. Left untouched if it could not be added.
+   * @return false if the queue is full or closed
+   */
+  bool try_push(T &item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (closed || count >= capacity) {
+      return false;
+    }
+    enqueue(item);
+    lock.unlock();
+    not_empty.notify_one();
+    return true;
+  }
+
+  /**
+   * Removes the item at the front of the queue, waiting for one to arrive if the queue is empty
+   * @param item T   receives the removed item
+   * @return false once the queue has been closed and every item has been drained
+   */
+  bool pop(T &item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait(lock, [this]() { return closed || count > 0; });
+    if (count == 0) {
+      return false;
+    }
+    dequeue(item);
+    lock.unlock();
+    not_full.notify_one();
+    return true;
+  }
+
+  /**
+   * Removes the item at the front of the queue, waiting at most timeout for one to arrive
+   * @param item T   receives the removed item
+   * @param timeout std::chrono::duration     longest time to wait
+   * @return false if the wait timed out, or the queue has been closed and every item has been drained
+   */
+  template<typename Rep, typename Period>
+  bool pop_for(T &item, const std::chrono::duration<Rep, Period> &timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait_for(lock, timeout, [this]() { return closed || count > 0; });
+    if (count == 0) {
+      return false;
+    }
+    dequeue(item);
+    lock.unlock();
+    not_full.notify_one();
+    return true;
+  }
+
+  /**
+   * Removes the item at the front of the queue without waiting
+   * @param item T   receives the removed item
+   * @return false if the queue is empty
+   */
+  bool try_pop(T &item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (count == 0) {
+      return false;
+    }
+    dequeue(item);
+    lock.unlock();
+    not_full.notify_one();
+    return true;
+  }
+
+  /**
+   * Marks the end of the stream. Pending items may still be popped, but no further items will be accepted.
+   */
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closed = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+  }
+
+  bool is_closed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return closed;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+  }
+
+  size_t get_capacity() const {
+    return capacity;
+  }
+
+  /**
+   * Summarises the depth of the queue as observed each time an item was pushed
+   * @param name std::string    label to use when reporting the statistics
+   */
+  QueueStats get_stats(const std::string &name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    QueueStats stats;
+    stats.name = name;
+    stats.capacity = capacity;
+    stats.max_depth = max_depth;
+    stats.mean_depth = push_count > 0 ? (double) depth_sum / push_count : 0.0;
+    return stats;
+  }
+
+ private:
+  void enqueue(T &item) {
+    std::swap(slots[(head + count) % capacity], item);
+    count++;
+    if (count > max_depth) {
+      max_depth = count;
+    }
+    depth_sum += count;
+    push_count++;
+  }
+
+  void dequeue(T &item) {
+    std::swap(slots[head], item);
+    head = (head + 1) % capacity;
+    count--;
+  }
+
+  std::vector<T> slots;
+  const size_t capacity;
+  size_t head;
+  size_t count;
+  bool closed;
+  size_t max_depth;
+  unsigned long long depth_sum;
+  unsigned long long push_count;
+  mutable std::mutex mutex;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+};
+
+#endif //TRAFFIC_MONITOR_BOUNDEDQUEUE_H
@@ -0,0 +1,97 @@
+/**
+ * ClipRecorder.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_CLIPRECORDER_H
+#define TRAFFIC_MONITOR_CLIPRECORDER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "BoundedQueue.hpp"
+#include "FrameRingBuffer.hpp"
+#include "SpeedEventLog.hpp"
+
+class ClipRecorder {
+ public:
+  ClipRecorder();
+  ~ClipRecorder();
+
+  ClipRecorder(const ClipRecorder &) = delete;
+  ClipRecorder &operator=(const ClipRecorder &) = delete;
+
+  const std::string &get_directory() const;
+  void set_directory(const std::string &directory_);
+
+  const double &get_pre_roll() const;
+  void set_pre_roll(const double pre_roll_);
+
+  const double &get_post_roll() const;
+  void set_post_roll(const double post_roll_);
+
+  const double &get_min_speed() const;
+  void set_min_speed(const double min_speed_);
+
+  const double &get_fps() const;
+  void set_fps(const double fps_);
+
+  const int &get_fourcc() const;
+  void set_fourcc(const int fourcc_, const std::string &extension_);
+
+  FrameRingBuffer &get_buffer();
+
+  void open();
+  bool request(const SpeedEvent &event);
+  void push(const cv::Mat &frame, unsigned int frame_count, double timestamp);
+  void close();
+  bool is_open() const;
+
+  unsigned long long get_written() const;
+  unsigned long long get_dropped() const;
+  unsigned long long get_failed() const;
+
+ private:
+  struct ClipJob {
+    unsigned int vehicle_id = 0;
+    std::vector<BufferedFrame> frames;
+  };
+
+  void dispatch(bool flush);
+  void buffer_loop();
+  void write_loop();
+
+  // Configuration
+  std::string directory;
+  double pre_roll;
+  double post_roll;
+  double min_speed;
+  double fps;
+  int fourcc;
+  std::string extension;
+
+  // Frames are copied by the encoding stage into staged, whose buffer is recycled through incoming, and compressed into
+  // buffer by the buffering thread, which also cuts the clips from it
+  BufferedFrame staged;
+  std::unique_ptr<BoundedQueue<BufferedFrame>> incoming;
+  std::thread buffering;
+  FrameRingBuffer buffer;
+  // Vehicles which have been timed but whose post-roll has not been captured yet. Added to by the tracking stage.
+  std::mutex pending_mutex;
+  std::vector<SpeedEvent> pending;
+  ClipJob job;
+
+  std::unique_ptr<BoundedQueue<ClipJob>> queue;
+  std::thread writer;
+
+  std::atomic<unsigned long long> written;
+  std::atomic<unsigned long long> dropped;
+  std::atomic<unsigned long long> failed;
+};
+
+#endif //TRAFFIC_MONITOR_CLIPRECORDER_H
@@ -0,0 +1,96 @@
+/**
+ * FrameCache.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_FRAMECACHE_H
+#define TRAFFIC_MONITOR_FRAMECACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "FrameSource.hpp"
+
+/**
+ * The header at the start of a frame cache file. Frames follow from data_offset, each in a record of frame_stride
+ * bytes which holds its timestamp as a double and, from byte PIXEL_OFFSET of the record, its pixels packed row by row.
+ * Records are page aligned so that each frame can be mapped, and released, on its own. Values are in the byte order
+ * of the machine which wrote the cache.
+ */
+struct FrameCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  // A RawPixelFormat
+  uint32_t format;
+  uint32_t frame_count;
+  uint32_t reserved;
+  uint64_t frame_bytes;
+  uint64_t frame_stride;
+  uint64_t data_offset;
+  double fps;
+};
+
+/**
+ * Writes the frames of a stream into a frame cache file, which MappedFrameSource replays
+ */
+class FrameCacheWriter {
+ public:
+  FrameCacheWriter();
+  ~FrameCacheWriter();
+
+  FrameCacheWriter(const FrameCacheWriter &) = delete;
+  FrameCacheWriter &operator=(const FrameCacheWriter &) = delete;
+
+  bool open(const std::string &path, const cv::Size &frame_size, RawPixelFormat format, double fps);
+  bool write(const cv::Mat &frame, double timestamp);
+  bool close();
+  bool is_open() const;
+
+  const uint32_t &get_frame_count() const;
+
+  static const uint64_t PIXEL_OFFSET = 64;
+
+ private:
+  bool write_fully(const void *data, size_t size);
+
+  int fd;
+  FrameCacheHeader header;
+  std::string record;
+};
+
+/**
+ * Replays a frame cache. Frames are views straight into the page cache, so reading them involves no decoding and no
+ * copies unless they have to be converted to BGR.
+ */
+class MappedFrameSource : public FrameSource {
+ public:
+  explicit MappedFrameSource(const std::string &path_);
+  ~MappedFrameSource() override;
+
+  MappedFrameSource(const MappedFrameSource &) = delete;
+  MappedFrameSource &operator=(const MappedFrameSource &) = delete;
+
+  const std::string &get_path() const;
+
+  bool open() override;
+  bool read(SourceFrame &frame) override;
+  void close() override;
+  bool is_open() const override;
+  cv::Size get_frame_size() const override;
+  bool is_raw() const override;
+
+  unsigned int get_frame_count() const;
+  RawPixelFormat get_format() const;
+
+ private:
+  struct Mapping;
+
+  std::string path;
+  std::shared_ptr<Mapping> mapping;
+  FrameCacheHeader header;
+  unsigned int next_frame;
+};
+
+#endif //TRAFFIC_MONITOR_FRAMECACHE_H
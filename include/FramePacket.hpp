@@ -0,0 +1,54 @@
+/**
+ * FramePacket.hpp
+ *
+ * Everything the pipeline knows about a single captured frame. A packet is created by the capture stage and handed,
+ * in order, through background subtraction, tracking and finally encoding.
+ */
+
+#ifndef TRAFFIC_MONITOR_FRAMEPACKET_H
+#define TRAFFIC_MONITOR_FRAMEPACKET_H
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "Blob.hpp"
+
+struct FramePacket {
+  // Index of the frame within the stream. Used by Tracker::track_car_speed() to time vehicles at the nominal FPS.
+  unsigned int frame_count = 0;
+  // When the frame was captured, in seconds. Taken from the driver or the file where possible. Used to time vehicles
+  // when the tracker uses SpeedTiming::TIMESTAMPS.
+  double timestamp = 0.0;
+  // The captured frame in BGR. The tracking stage draws its overlays on this frame before it is encoded.
+  cv::Mat frame;
+  // The captured frame in the camera's own grayscale or YUYV layout, when it is captured without conversion. The
+  // tracking stage converts it into frame. Empty when the source delivers BGR.
+  cv::Mat raw;
+  // Keeps the source's buffer behind raw from being reused while the packet is in flight, when the source lends out
+  // its buffers rather than copying them. Dropped when the packet is returned to its pool.
+  std::shared_ptr<void> lease;
+  // Luminance of the frame which detection runs on, when detecting on luminance only
+  cv::Mat luminance;
+  // Downscaled copy of the frame which detection runs on. Only populated when the working scale is below 1.
+  cv::Mat working_frame;
+  // Foreground mask produced by the background subtractor, at the working scale
+  cv::Mat foreground;
+  // Blobs detected within the foreground mask which passed the vehicle size filters
+  std::vector<Blob> blobs;
+  // Whether detection ran on this frame. False on the frames skipped at QualityLevel::SKIP_FRAMES, which the tracker
+  // predicts through without matching or ageing its tracks.
+  bool detected = true;
+  // Whether this frame is shown in the preview window. Headless runs only annotate the frames which are shown.
+  bool show_preview = false;
+  // Annotated copy of the frame for the preview window. Only populated when running headless.
+  cv::Mat preview;
+  // Heap allocations made by every stage while processing this frame. See AllocationCounter.hpp.
+  unsigned long long allocations = 0;
+  // Time the detection and tracking stages spent on this frame, in seconds. Read by the QualityController.
+  double detect_seconds = 0.0;
+  double track_seconds = 0.0;
+};
+
+#endif //TRAFFIC_MONITOR_FRAMEPACKET_H
@@ -0,0 +1,39 @@
+/**
+ * FramePool.hpp
+ *
+ * A fixed set of FramePackets allocated once at startup. The pipeline acquires a packet for every captured frame and
+ * releases it once the frame has been written, so the frame buffers, masks and blob vectors are reused rather than
+ * reallocated for every frame.
+ */
+
+#ifndef TRAFFIC_MONITOR_FRAMEPOOL_H
+#define TRAFFIC_MONITOR_FRAMEPOOL_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "BoundedQueue.hpp"
+#include "FramePacket.hpp"
+
+class FramePool {
+ public:
+  FramePool(size_t size_, cv::Size frame_size, int frame_type, size_t max_blobs);
+  FramePool(size_t size_, cv::Size frame_size, int frame_type, size_t max_blobs, cv::Size working_size);
+
+  FramePool(const FramePool &) = delete;
+  FramePool &operator=(const FramePool &) = delete;
+
+  FramePacket *acquire();
+  void release(FramePacket *packet);
+  void close();
+
+  size_t get_size() const;
+  size_t get_available() const;
+
+ private:
+  std::vector<FramePacket> packets;
+  BoundedQueue<FramePacket *> free_packets;
+};
+
+#endif //TRAFFIC_MONITOR_FRAMEPOOL_H
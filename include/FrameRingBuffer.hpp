@@ -0,0 +1,64 @@
+/**
+ * FrameRingBuffer.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_FRAMERINGBUFFER_H
+#define TRAFFIC_MONITOR_FRAMERINGBUFFER_H
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * A frame held by FrameRingBuffer. Either raw holds the pixels, or jpeg holds them compressed. Both are shared rather
+ * than copied when a frame is collected, and never written to once buffered, so collected frames may be read on another
+ * thread while the buffer moves on.
+ */
+struct BufferedFrame {
+  unsigned int frame_count = 0;
+  double timestamp = 0.0;
+  cv::Mat raw;
+  std::shared_ptr<const std::vector<unsigned char>> jpeg;
+
+  size_t bytes() const;
+  bool decode(cv::Mat &frame) const;
+};
+
+class FrameRingBuffer {
+ public:
+  FrameRingBuffer();
+
+  const double &get_duration() const;
+  void set_duration(const double duration_);
+
+  const size_t &get_memory_limit() const;
+  void set_memory_limit(const size_t memory_limit_);
+
+  const int &get_jpeg_quality() const;
+  void set_jpeg_quality(const int jpeg_quality_);
+
+  void push(const cv::Mat &frame, unsigned int frame_count, double timestamp);
+  bool find(unsigned int frame_count, double &timestamp) const;
+  void collect(double from, double to, std::vector<BufferedFrame> &collected) const;
+  void clear();
+
+  bool empty() const;
+  size_t size() const;
+  const size_t &get_bytes() const;
+  const BufferedFrame &oldest() const;
+  const BufferedFrame &newest() const;
+
+ private:
+  // Configuration
+  double duration;
+  size_t memory_limit;
+  int jpeg_quality;
+
+  // Oldest frame first
+  std::deque<BufferedFrame> frames;
+  size_t bytes;
+};
+
+#endif //TRAFFIC_MONITOR_FRAMERINGBUFFER_H
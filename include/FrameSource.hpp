@@ -0,0 +1,242 @@
+/**
+ * FrameSource.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_FRAMESOURCE_H
+#define TRAFFIC_MONITOR_FRAMESOURCE_H
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <opencv2/opencv.hpp>
+
+#include "BoundedQueue.hpp"
+
+/**
+ * A frame as delivered by a FrameSource
+ */
+struct SourceFrame {
+  // The frame in BGR, or in the camera's own grayscale or YUYV layout when the source is raw. See FrameSource::is_raw().
+  cv::Mat image;
+  // Index of the frame within the stream, counting from 0. Skips the frames a camera's driver reports it dropped.
+  unsigned int index = 0;
+  // When the frame was captured, in seconds. Taken from the driver or the file where possible, and always increasing.
+  double timestamp = 0.0;
+  // Set when image is a view of a buffer the source lends out rather than a copy. The buffer is handed back to the
+  // source once every copy of the lease has been dropped, and must not be written to.
+  std::shared_ptr<void> lease;
+};
+
+/**
+ * Pixel layouts of headerless raw frame files. GRAY is 8 bit luminance, YUYV is packed 4:2:2 as V4L2 delivers it and
+ * BGR is OpenCV's 8 bit colour layout.
+ */
+enum class RawPixelFormat {
+  GRAY,
+  YUYV,
+  BGR
+};
+
+class FrameSource {
+ public:
+  FrameSource();
+  virtual ~FrameSource();
+
+  const double &get_fps() const;
+  void set_fps(const double fps_);
+
+  const cv::Size &get_requested_size() const;
+  void set_requested_size(const cv::Size &requested_size_);
+
+  const bool &get_raw_requested() const;
+  void set_raw_requested(const bool raw_requested_);
+
+  /**
+   * Opens the source and starts the stream from its first frame
+   * @return false if the source could not be opened
+   */
+  virtual bool open() = 0;
+
+  /**
+   * Reads the next frame
+   * @param frame SourceFrame     receives the frame, its index and its timestamp. The buffer already held by
+   * frame.image is reused where the source can decode into it, and may be handed back to the source for later frames.
+   * @return false once the end of the stream has been reached, or the source failed
+   */
+  virtual bool read(SourceFrame &frame) = 0;
+
+  virtual void close() = 0;
+  virtual bool is_open() const = 0;
+
+  /**
+   * Size of the frames the source delivers. Only valid once it has been opened.
+   */
+  virtual cv::Size get_frame_size() const = 0;
+
+  /**
+   * Whether frames are delivered in the camera's own grayscale or YUYV layout rather than BGR. Only ever set when raw
+   * frames were requested, and only valid once the source has been opened.
+   */
+  virtual bool is_raw() const;
+
+  /**
+   * Whether the source is a camera, whose frames arrive in real time
+   */
+  virtual bool is_live() const;
+
+  /**
+   * Number of frames the source skipped since it was opened, as reported by a camera's driver
+   */
+  virtual unsigned long long get_dropped_frames() const;
+
+  static cv::Ptr<FrameSource> create(const std::string &path);
+  static bool parse_raw_format(const std::string &name, RawPixelFormat &format);
+
+ protected:
+  void restart_stream();
+  void stamp(SourceFrame &frame, double reported_timestamp);
+
+  // Configuration
+  double fps;
+  cv::Size requested_size;
+  bool raw_requested;
+
+ private:
+  // Numbering and timestamps of the frames read since the source was opened
+  unsigned int frames_read;
+  double last_timestamp;
+  std::chrono::steady_clock::time_point last_read_time;
+};
+
+/**
+ * Common base of the sources read through cv::VideoCapture
+ */
+class VideoCaptureFrameSource : public FrameSource {
+ public:
+  bool read(SourceFrame &frame) override;
+  void close() override;
+  bool is_open() const override;
+  cv::Size get_frame_size() const override;
+
+ protected:
+  cv::VideoCapture capture;
+  cv::Size frame_size;
+};
+
+class CameraFrameSource : public VideoCaptureFrameSource {
+ public:
+  CameraFrameSource();
+  explicit CameraFrameSource(int device_);
+
+  const int &get_device() const;
+  void set_device(const int device_);
+
+  bool open() override;
+  bool is_raw() const override;
+  bool is_live() const override;
+
+ private:
+  bool negotiate_raw_capture();
+
+  int device;
+  bool raw;
+};
+
+class VideoFileFrameSource : public VideoCaptureFrameSource {
+ public:
+  explicit VideoFileFrameSource(const std::string &path_);
+
+  const std::string &get_path() const;
+
+  bool open() override;
+
+ private:
+  std::string path;
+};
+
+class ImageSequenceFrameSource : public FrameSource {
+ public:
+  explicit ImageSequenceFrameSource(const std::string &pattern_);
+
+  const std::string &get_pattern() const;
+
+  bool open() override;
+  bool read(SourceFrame &frame) override;
+  void close() override;
+  bool is_open() const override;
+  cv::Size get_frame_size() const override;
+
+ private:
+  std::string image_path(int number) const;
+
+  std::string pattern;
+  int first_number;
+  int next_number;
+  bool opened;
+  // The first image is decoded by open() to learn the frame size, and handed out by the first read()
+  cv::Mat first_image;
+  cv::Size frame_size;
+};
+
+class RawFileFrameSource : public FrameSource {
+ public:
+  RawFileFrameSource(const std::string &path_, const cv::Size &frame_size_, RawPixelFormat format_);
+  ~RawFileFrameSource() override;
+
+  RawFileFrameSource(const RawFileFrameSource &) = delete;
+  RawFileFrameSource &operator=(const RawFileFrameSource &) = delete;
+
+  const std::string &get_path() const;
+  const RawPixelFormat &get_format() const;
+
+  bool open() override;
+  bool read(SourceFrame &frame) override;
+  void close() override;
+  bool is_open() const override;
+  cv::Size get_frame_size() const override;
+  bool is_raw() const override;
+
+ private:
+  std::string path;
+  cv::Size frame_size;
+  RawPixelFormat format;
+  std::FILE *file;
+  // Frames are read here first when they have to be converted to BGR
+  cv::Mat converted;
+};
+
+class PrefetchingFrameSource : public FrameSource {
+ public:
+  PrefetchingFrameSource(const cv::Ptr<FrameSource> &source_, size_t depth_);
+  ~PrefetchingFrameSource() override;
+
+  PrefetchingFrameSource(const PrefetchingFrameSource &) = delete;
+  PrefetchingFrameSource &operator=(const PrefetchingFrameSource &) = delete;
+
+  const cv::Ptr<FrameSource> &get_source() const;
+  const size_t &get_depth() const;
+
+  bool open() override;
+  bool read(SourceFrame &frame) override;
+  void close() override;
+  bool is_open() const override;
+  cv::Size get_frame_size() const override;
+  bool is_raw() const override;
+  bool is_live() const override;
+  unsigned long long get_dropped_frames() const override;
+
+  QueueStats get_stats(const std::string &name) const;
+
+ private:
+  void decode_loop();
+
+  cv::Ptr<FrameSource> source;
+  size_t depth;
+  std::unique_ptr<BoundedQueue<SourceFrame>> queue;
+  std::thread decoder;
+};
+
+#endif //TRAFFIC_MONITOR_FRAMESOURCE_H
@@ -0,0 +1,13 @@
+/**
+ * Luminance.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_LUMINANCE_H
+#define TRAFFIC_MONITOR_LUMINANCE_H
+
+#include <opencv2/opencv.hpp>
+
+void extract_luminance(const cv::Mat &frame, cv::Mat &luminance);
+void convert_to_bgr(const cv::Mat &frame, cv::Mat &bgr);
+
+#endif //TRAFFIC_MONITOR_LUMINANCE_H
@@ -0,0 +1,56 @@
+/**
+ * MaskPostProcessor.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_MASKPOSTPROCESSOR_H
+#define TRAFFIC_MONITOR_MASKPOSTPROCESSOR_H
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * Instruction set used by the post-processing kernel. SCALAR is always available; the others depend on the CPU.
+ */
+enum class SimdPath {
+  SCALAR,
+  SSE2,
+  AVX2,
+  NEON
+};
+
+class MaskPostProcessor {
+ public:
+  MaskPostProcessor();
+  MaskPostProcessor(int threshold_, bool enable_threshold_, bool enable_open_close_);
+
+  const int &get_threshold() const;
+  void set_threshold(const int threshold_);
+
+  const bool &get_enable_threshold() const;
+  void set_enable_threshold(const bool enable_threshold_);
+
+  const bool &get_enable_open_close() const;
+  void set_enable_open_close(const bool enable_open_close_);
+
+  const SimdPath &get_simd_path() const;
+  void set_simd_path(const SimdPath simd_path_);
+
+  void apply(const cv::Mat &input, cv::Mat &output);
+  void apply_rows(const cv::Mat &input, cv::Mat &output, int row_begin, int row_end,
+                  std::vector<unsigned char> &band_scratch) const;
+
+  static bool is_supported(SimdPath simd_path);
+  static SimdPath best_simd_path();
+  static const char *simd_path_name(SimdPath simd_path);
+
+ private:
+  int threshold;
+  bool enable_threshold;
+  bool enable_open_close;
+  SimdPath simd_path;
+  // Row buffers for the fused kernel, reused between frames
+  std::vector<unsigned char> scratch;
+};
+
+#endif //TRAFFIC_MONITOR_MASKPOSTPROCESSOR_H
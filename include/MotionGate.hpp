@@ -0,0 +1,91 @@
+/**
+ * MotionGate.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_MOTIONGATE_H
+#define TRAFFIC_MONITOR_MOTIONGATE_H
+
+#include <opencv2/opencv.hpp>
+
+#include "BackgroundModel.hpp"
+#include "RegionOfInterest.hpp"
+
+/**
+ * IDLE while nothing moves, so the expensive detection stages can be skipped. ACTIVE from the first frame with motion
+ * until hold_frames frames in a row have shown none.
+ */
+enum class GateState {
+  IDLE,
+  ACTIVE
+};
+
+class MotionGate {
+ public:
+  MotionGate();
+
+  const int &get_sample_width() const;
+  void set_sample_width(const int sample_width_);
+
+  const int &get_difference_threshold() const;
+  void set_difference_threshold(const int difference_threshold_);
+
+  const double &get_min_changed_fraction() const;
+  void set_min_changed_fraction(const double min_changed_fraction_);
+
+  const unsigned int &get_hold_frames() const;
+  void set_hold_frames(const unsigned int hold_frames_);
+
+  const unsigned int &get_pre_roll_frames() const;
+  void set_pre_roll_frames(const unsigned int pre_roll_frames_);
+
+  const unsigned int &get_idle_update_interval() const;
+  void set_idle_update_interval(const unsigned int idle_update_interval_);
+
+  void set_region_of_interest(const RegionOfInterest &region_);
+
+  bool update(const cv::Mat &frame);
+  void reset();
+
+  const GateState &get_state() const;
+  bool is_active() const;
+  const double &get_changed_fraction() const;
+  const unsigned long long &get_frames() const;
+  const unsigned long long &get_active_frames() const;
+  const unsigned long long &get_activations() const;
+  double get_duty_cycle() const;
+
+  static const char *state_name(GateState state);
+
+ private:
+  void prepare_watch_mask(const cv::Size &sample_size, const cv::Size &frame_size);
+
+  // Configuration
+  int sample_width;
+  int difference_threshold;
+  double min_changed_fraction;
+  unsigned int hold_frames;
+  unsigned int pre_roll_frames;
+  unsigned int idle_update_interval;
+  RegionOfInterest region;
+
+  // State and metrics
+  GateState state;
+  unsigned int quiet_frames;
+  double changed_fraction;
+  unsigned long long frames;
+  unsigned long long active_frames;
+  unsigned long long activations;
+
+  // A running average of the sampled pixels, against which motion is measured
+  RunningAverageBackgroundModel sample_model;
+
+  // Scratch buffers reused between frames
+  cv::Mat sample;
+  cv::Mat changed;
+  // Sampled pixels within the region of interest, for samples of watched_size
+  cv::Mat watch_mask;
+  cv::Size watched_size;
+  int watched_pixels;
+};
+
+#endif //TRAFFIC_MONITOR_MOTIONGATE_H
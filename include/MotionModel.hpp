@@ -0,0 +1,60 @@
+/**
+ * MotionModel.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_MOTIONMODEL_H
+#define TRAFFIC_MONITOR_MOTIONMODEL_H
+
+#include <cstddef>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+class MotionModel {
+ public:
+  MotionModel();
+  MotionModel(float process_noise_, float measurement_noise_, float initial_velocity_variance_);
+
+  const float &get_process_noise() const;
+  void set_process_noise(const float process_noise_);
+
+  const float &get_measurement_noise() const;
+  void set_measurement_noise(const float measurement_noise_);
+
+  const float &get_initial_velocity_variance() const;
+  void set_initial_velocity_variance(const float initial_velocity_variance_);
+
+  void begin_frame();
+  int carry(int slot);
+  int add(const cv::Point &position, const cv::Point &velocity);
+  void predict();
+  void correct(int slot, const cv::Point &measurement);
+  cv::Point get_position(int slot) const;
+  cv::Point get_velocity(int slot) const;
+  size_t size() const;
+  void clear();
+
+ private:
+  // Constant velocity state of every track, one array per component. Both axes share a covariance because they are
+  // predicted and corrected at the same instants with the same noise.
+  struct States {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> vx;
+    std::vector<float> vy;
+    std::vector<float> p_pos;
+    std::vector<float> p_cross;
+    std::vector<float> p_vel;
+
+    void clear();
+    size_t push_back(float x_, float y_, float vx_, float vy_, float p_pos_, float p_cross_, float p_vel_);
+  };
+
+  float process_noise;
+  float measurement_noise;
+  float initial_velocity_variance;
+  States states[2];
+  int current;
+};
+
+#endif //TRAFFIC_MONITOR_MOTIONMODEL_H
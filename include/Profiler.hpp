@@ -0,0 +1,129 @@
+/**
+ * Profiler.hpp
+ *
+ * Times the stages of the frame loop. PROFILE_SCOPE("name") times the rest of the enclosing block as the stage "name",
+ * adding each time to a latency histogram per stage, and to a Chrome trace-event file when tracing. Profiling is
+ * compiled in when TRAFFIC_MONITOR_PROFILE is defined (see the top level CMakeLists.txt); otherwise the macros expand
+ * to nothing and there are no stages to report.
+ */
+
+#ifndef TRAFFIC_MONITOR_PROFILER_H
+#define TRAFFIC_MONITOR_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A copy of the counts of one or more LatencyHistograms, in nanoseconds
+ */
+struct LatencySnapshot {
+  std::vector<uint64_t> counts;
+  uint64_t count = 0;
+  uint64_t total = 0;
+  uint64_t max = 0;
+
+  uint64_t percentile(double fraction) const;
+};
+
+/**
+ * Counts durations in buckets which grow with the duration, eight to each power of two, so any percentile is known to
+ * within 12.5% using a fixed 2.4 KiB of counters. Safe to record into from several threads while others read.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  LatencyHistogram(const LatencyHistogram &) = delete;
+  LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+  void record(uint64_t nanoseconds);
+  void reset();
+  void add_to(LatencySnapshot &snapshot) const;
+  LatencySnapshot snapshot() const;
+
+  static unsigned int bucket_of(uint64_t nanoseconds);
+  static uint64_t bucket_midpoint(unsigned int bucket);
+
+  // Durations of 2^40 ns, about 18 minutes, and longer share the last bucket
+  static const unsigned int BUCKETS = 304;
+
+ private:
+  std::atomic<uint64_t> counts[BUCKETS];
+  std::atomic<uint64_t> total;
+  std::atomic<uint64_t> max;
+};
+
+/**
+ * Latency of one stage, summed over every thread it ran on, in seconds
+ */
+struct StageSummary {
+  std::string name;
+  uint64_t count = 0;
+  double total = 0.0;
+  double p50 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+bool profiling_enabled();
+
+// Identifies the stage called name, registering it on first use. name must outlive the process, as literals do.
+unsigned int profile_stage(const char *name);
+
+// Names the calling thread in traces
+void profile_thread(const char *name);
+
+// Nanoseconds on a monotonic clock since the profiler was first used
+uint64_t profile_now();
+
+void profile_record(unsigned int stage, uint64_t start, uint64_t end);
+
+// Forgets every recorded time and trace event
+void profile_reset();
+
+// Whether each timed stage is also kept as a trace event
+void profile_set_tracing(bool tracing);
+bool profile_is_tracing();
+
+// Stages which have run since the last reset, in the order they were registered
+std::vector<StageSummary> profile_summaries();
+
+bool profile_write_trace(const std::string &path);
+
+/**
+ * Records the time from construction to destruction as one run of a stage
+ */
+class ScopedStageTimer {
+ public:
+  explicit ScopedStageTimer(unsigned int stage_)
+      : stage(stage_),
+        start(profile_now()) {}
+
+  ~ScopedStageTimer() {
+    profile_record(stage, start, profile_now());
+  }
+
+  ScopedStageTimer(const ScopedStageTimer &) = delete;
+  ScopedStageTimer &operator=(const ScopedStageTimer &) = delete;
+
+ private:
+  const unsigned int stage;
+  const uint64_t start;
+};
+
+#ifdef TRAFFIC_MONITOR_PROFILE
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) \
+  static const unsigned int PROFILE_CONCAT(profile_stage_, __LINE__) = profile_stage(name); \
+  ScopedStageTimer PROFILE_CONCAT(profile_timer_, __LINE__)(PROFILE_CONCAT(profile_stage_, __LINE__))
+#define PROFILE_THREAD(name) profile_thread(name)
+#else
+#define PROFILE_SCOPE(name) do {} while (0)
+#define PROFILE_THREAD(name) do {} while (0)
+#endif
+
+#endif //TRAFFIC_MONITOR_PROFILER_H
@@ -0,0 +1,81 @@
+/**
+ * QualityController.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_QUALITYCONTROLLER_H
+#define TRAFFIC_MONITOR_QUALITYCONTROLLER_H
+
+/**
+ * The steps processing is degraded through when frames take longer than the frame interval. Each level keeps every
+ * saving of the levels before it.
+ * NO_PREVIEW stops showing the preview, and annotating it when headless. Recorded frames keep their overlays.
+ * REDUCED_RESOLUTION halves the working scale detection runs at. The first time it is reached the background is learnt
+ * at the reduced size, which is logged. The model for each size is kept, so later moves either way resume it.
+ * SPARSE_BACKGROUND updates the background model on every other frame only.
+ * SKIP_FRAMES detects vehicles on every other frame only, and the tracker predicts through the frames between.
+ */
+enum class QualityLevel {
+  FULL,
+  NO_PREVIEW,
+  REDUCED_RESOLUTION,
+  SPARSE_BACKGROUND,
+  SKIP_FRAMES
+};
+
+class QualityController {
+ public:
+  QualityController();
+
+  const double &get_frame_interval() const;
+  void set_frame_interval(const double frame_interval_);
+
+  const double &get_degrade_load() const;
+  void set_degrade_load(const double degrade_load_);
+
+  const double &get_recover_load() const;
+  void set_recover_load(const double recover_load_);
+
+  const unsigned int &get_degrade_frames() const;
+  void set_degrade_frames(const unsigned int degrade_frames_);
+
+  const unsigned int &get_recover_frames() const;
+  void set_recover_frames(const unsigned int recover_frames_);
+
+  const double &get_smoothing() const;
+  void set_smoothing(const double smoothing_);
+
+  const QualityLevel &get_max_level() const;
+  void set_max_level(const QualityLevel max_level_);
+
+  bool record(const double seconds);
+  void reset();
+
+  const QualityLevel &get_level() const;
+  const double &get_average_seconds() const;
+  double get_load() const;
+  const unsigned long long &get_degradations() const;
+  const unsigned long long &get_recoveries() const;
+
+  static const char *level_name(QualityLevel level);
+
+ private:
+  // Configuration
+  double frame_interval;
+  double degrade_load;
+  double recover_load;
+  unsigned int degrade_frames;
+  unsigned int recover_frames;
+  double smoothing;
+  QualityLevel max_level;
+
+  // State and metrics
+  QualityLevel level;
+  double average_seconds;
+  unsigned long long samples;
+  unsigned int pressure_frames;
+  unsigned int headroom_frames;
+  unsigned long long degradations;
+  unsigned long long recoveries;
+};
+
+#endif //TRAFFIC_MONITOR_QUALITYCONTROLLER_H
@@ -0,0 +1,44 @@
+/**
+ * RegionOfInterest.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_REGIONOFINTEREST_H
+#define TRAFFIC_MONITOR_REGIONOFINTEREST_H
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * The parts of the frame which are worth processing, as one or more polygons in frame coordinates, usually drawn around
+ * the road. An empty region covers the whole frame.
+ */
+class RegionOfInterest {
+ public:
+  RegionOfInterest();
+  explicit RegionOfInterest(const std::vector<std::vector<cv::Point>> &polygons_);
+
+  const std::vector<std::vector<cv::Point>> &get_polygons() const;
+  void set_polygons(const std::vector<std::vector<cv::Point>> &polygons_);
+  void add_polygon(const std::vector<cv::Point> &polygon);
+
+  bool empty() const;
+  RegionOfInterest scaled(double scale) const;
+
+  void prepare(const cv::Size &frame_size_);
+  const cv::Rect &get_bounding_rect() const;
+  const cv::Mat &get_mask() const;
+  bool is_rectangular() const;
+
+ private:
+  std::vector<std::vector<cv::Point>> polygons;
+
+  // Derived from the polygons by prepare() for one frame size
+  bool prepared;
+  cv::Size frame_size;
+  cv::Rect bounding_rect;
+  cv::Mat mask;
+  bool rectangular;
+};
+
+#endif //TRAFFIC_MONITOR_REGIONOFINTEREST_H
@@ -0,0 +1,74 @@
+/**
+ * SnapshotWriter.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_SNAPSHOTWRITER_H
+#define TRAFFIC_MONITOR_SNAPSHOTWRITER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "BoundedQueue.hpp"
+
+class SnapshotWriter {
+ public:
+  SnapshotWriter();
+  ~SnapshotWriter();
+
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  const std::string &get_directory() const;
+  void set_directory(const std::string &directory_);
+
+  const unsigned int &get_workers() const;
+  void set_workers(const unsigned int workers_);
+
+  const size_t &get_capacity() const;
+  void set_capacity(const size_t capacity_);
+
+  const int &get_jpeg_quality() const;
+  void set_jpeg_quality(const int jpeg_quality_);
+
+  const int &get_max_dimension() const;
+  void set_max_dimension(const int max_dimension_);
+
+  void open();
+  bool submit(const cv::Mat &frame, const cv::Rect &rect, unsigned int vehicle_id);
+  void close();
+  bool is_open() const;
+
+  unsigned long long get_written() const;
+  unsigned long long get_dropped() const;
+  unsigned long long get_failed() const;
+
+ private:
+  // A crop owned by the queue, so the frame it was cut from can be reused straight away
+  struct Snapshot {
+    cv::Mat image;
+    unsigned int vehicle_id = 0;
+  };
+
+  void encode_loop();
+
+  // Configuration
+  std::string directory;
+  unsigned int workers;
+  size_t capacity;
+  int jpeg_quality;
+  int max_dimension;
+
+  std::unique_ptr<BoundedQueue<Snapshot>> queue;
+  std::vector<std::thread> threads;
+
+  std::atomic<unsigned long long> written;
+  std::atomic<unsigned long long> dropped;
+  std::atomic<unsigned long long> failed;
+};
+
+#endif //TRAFFIC_MONITOR_SNAPSHOTWRITER_H
@@ -0,0 +1,46 @@
+/**
+ * SpatialGrid.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_SPATIALGRID_H
+#define TRAFFIC_MONITOR_SPATIALGRID_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+class SpatialGrid {
+ public:
+  SpatialGrid();
+  explicit SpatialGrid(int cell_size_);
+
+  const int &get_cell_size() const;
+  void set_cell_size(const int cell_size_);
+
+  void clear();
+  void insert(const cv::Point &point, int index);
+  void build();
+  int find_nearest(const cv::Point &point, double radius) const;
+  void find_within(const cv::Point &point, double radius, std::vector<int> &indices) const;
+
+  static long long squared_distance(const cv::Point &point1, const cv::Point &point2);
+
+ private:
+  struct Entry {
+    uint64_t key;
+    cv::Point point;
+    int index;
+  };
+
+  int cell_of(int coordinate) const;
+  static uint64_t key_of(int cell_x, int cell_y);
+  std::pair<std::vector<Entry>::const_iterator, std::vector<Entry>::const_iterator> cell_range(int cell_x,
+                                                                                              int cell_y) const;
+
+  int cell_size;
+  std::vector<Entry> entries;
+};
+
+#endif //TRAFFIC_MONITOR_SPATIALGRID_H
@@ -0,0 +1,113 @@
+/**
+ * SpeedEventLog.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_SPEEDEVENTLOG_H
+#define TRAFFIC_MONITOR_SPEEDEVENTLOG_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "BoundedQueue.hpp"
+
+/**
+ * Layout of the speed log.
+ * TEXT is one "id speed" line per vehicle, as written before the log gained other formats.
+ * CSV has a header row and one row per vehicle with its timing and direction.
+ * JSON_LINES has one JSON object per line with the same fields as CSV.
+ */
+enum class SpeedLogFormat {
+  TEXT,
+  CSV,
+  JSON_LINES
+};
+
+/**
+ * When the log is forced to storage with fsync. NEVER leaves it to the operating system, ON_CLOSE syncs once when the
+ * log is closed and ON_FLUSH syncs after every batch.
+ */
+enum class SyncPolicy {
+  NEVER,
+  ON_CLOSE,
+  ON_FLUSH
+};
+
+/**
+ * A vehicle which has been timed across the calibration region
+ */
+struct SpeedEvent {
+  unsigned int vehicle_id = 0;
+  // Capture timestamps of the frames the vehicle entered and left the region in, in seconds
+  double start_time = 0.0;
+  double end_time = 0.0;
+  unsigned int start_frame = 0;
+  unsigned int end_frame = 0;
+  bool moving_left = false;
+  // Kilometers per hour, and the standard error of the estimate
+  double speed = 0.0;
+  double speed_error = 0.0;
+};
+
+class SpeedEventLog {
+ public:
+  SpeedEventLog();
+  ~SpeedEventLog();
+
+  SpeedEventLog(const SpeedEventLog &) = delete;
+  SpeedEventLog &operator=(const SpeedEventLog &) = delete;
+
+  const std::string &get_path() const;
+  void set_path(const std::string &path_);
+
+  const SpeedLogFormat &get_format() const;
+  void set_format(const SpeedLogFormat format_);
+
+  const size_t &get_capacity() const;
+  void set_capacity(const size_t capacity_);
+
+  const double &get_flush_interval() const;
+  void set_flush_interval(const double flush_interval_);
+
+  const unsigned int &get_flush_count() const;
+  void set_flush_count(const unsigned int flush_count_);
+
+  const SyncPolicy &get_sync_policy() const;
+  void set_sync_policy(const SyncPolicy sync_policy_);
+
+  bool open();
+  bool log(const SpeedEvent &event);
+  void close();
+  bool is_open() const;
+
+  unsigned long long get_written() const;
+  unsigned long long get_dropped() const;
+  unsigned long long get_flushes() const;
+
+  static void format_event(const SpeedEvent &event, SpeedLogFormat format, std::string &output);
+  static bool parse_format(const std::string &name, SpeedLogFormat &format);
+
+ private:
+  void write_loop();
+  bool write_batch(const std::string &batch);
+
+  // Configuration
+  std::string path;
+  SpeedLogFormat format;
+  size_t capacity;
+  double flush_interval;
+  unsigned int flush_count;
+  SyncPolicy sync_policy;
+
+  // The writer thread owns the file while the log is open
+  int fd;
+  std::unique_ptr<BoundedQueue<SpeedEvent>> queue;
+  std::thread writer;
+
+  std::atomic<unsigned long long> written;
+  std::atomic<unsigned long long> dropped;
+  std::atomic<unsigned long long> flushes;
+};
+
+#endif //TRAFFIC_MONITOR_SPEEDEVENTLOG_H
@@ -0,0 +1,35 @@
+/**
+ * SpeedFit.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_SPEEDFIT_H
+#define TRAFFIC_MONITOR_SPEEDFIT_H
+
+class SpeedFit {
+ public:
+  SpeedFit();
+
+  void add(const double time, const double position);
+  void reset();
+
+  const unsigned int &get_samples() const;
+  bool is_valid() const;
+  double get_slope() const;
+  double get_slope_error() const;
+  double get_residual() const;
+
+ private:
+  double residual_sum_of_squares() const;
+
+  unsigned int samples;
+  // Times and positions are taken relative to the first sample, so large driver timestamps keep their precision
+  double time_origin;
+  double position_origin;
+  double sum_time;
+  double sum_position;
+  double sum_time_squared;
+  double sum_time_position;
+  double sum_position_squared;
+};
+
+#endif //TRAFFIC_MONITOR_SPEEDFIT_H
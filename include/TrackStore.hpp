@@ -0,0 +1,41 @@
+/**
+ * TrackStore.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_TRACKSTORE_H
+#define TRAFFIC_MONITOR_TRACKSTORE_H
+
+#include <vector>
+
+#include "Blob.hpp"
+
+class TrackStore {
+ public:
+  TrackStore();
+  TrackStore(size_t max_history_, size_t memory_ceiling_);
+
+  std::vector<Blob> &get_blobs();
+  const std::vector<Blob> &get_blobs() const;
+
+  const size_t &get_max_history() const;
+  void set_max_history(const size_t max_history_);
+
+  const size_t &get_memory_ceiling() const;
+  void set_memory_ceiling(const size_t memory_ceiling_);
+
+  const unsigned long long &get_retired_count() const;
+
+  size_t compact();
+  size_t estimated_memory() const;
+  void clear();
+
+  static size_t estimated_memory(const Blob &blob);
+
+ private:
+  std::vector<Blob> blobs;
+  size_t max_history;
+  size_t memory_ceiling;
+  unsigned long long retired_count;
+};
+
+#endif //TRAFFIC_MONITOR_TRACKSTORE_H
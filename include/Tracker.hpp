@@ -1,9 +1,40 @@
+#ifndef TRAFFIC_MONITOR_TRACKER_H
+#define TRAFFIC_MONITOR_TRACKER_H
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "AssignmentSolver.hpp"
 #include "Blob.hpp"
+#include "ClipRecorder.hpp"
+#include "MotionModel.hpp"
+#include "SpatialGrid.hpp"
+#include "SnapshotWriter.hpp"
+#include "SpeedEventLog.hpp"
+
+/**
+ * How blobs in the current frame are paired with the existing tracks.
+ * GREEDY matches each blob to its nearest track in turn, so two blobs may claim the same track.
+ * GLOBAL solves the gated assignment over all blobs and tracks at once, so each track is claimed at most once.
+ */
+enum class MatchingStrategy {
+  GREEDY,
+  GLOBAL
+};
+
+/**
+ * How the time a vehicle took to cross the calibration region is measured.
+ * FRAME_COUNT divides the number of frames between entry and exit by the nominal FPS. It is only correct when every
+ * frame arrives at exactly that rate.
+ * TIMESTAMPS takes the difference between the capture timestamps of the entry and exit frames, so dropped, skipped or
+ * irregularly timed frames do not distort the speed.
+ */
+enum class SpeedTiming {
+  FRAME_COUNT,
+  TIMESTAMPS
+};
 
 class Tracker {
  private:
@@ -12,6 +43,26 @@ class Tracker {
   cv::Mat frame2;
   std::vector<Blob> blobs;
   double fps;
+  MatchingStrategy matching_strategy;
+  SpeedTiming speed_timing;
+  SpatialGrid match_grid;
+  AssignmentSolver assignment_solver;
+  std::vector<AssignmentEdge> assignment_edges;
+  std::vector<int> assignment;
+  std::vector<int> match_candidates;
+  MotionModel motion_model;
+  // Receives every timed vehicle when set. Owned by the caller.
+  SpeedEventLog *speed_event_log;
+  // Encodes the image of every timed vehicle when set. Owned by the caller.
+  SnapshotWriter *snapshot_writer;
+  // Receives every timed vehicle for a clip when set. Owned by the caller.
+  ClipRecorder *clip_recorder;
+
+  void predict_tracked_blobs(std::vector<Blob> &existingBlobs);
+  void index_predicted_positions(std::vector<Blob> &existingBlobs, std::vector<Blob> &currentFrameBlobs);
+  void match_greedy(std::vector<Blob> &existingBlobs, std::vector<Blob> &currentFrameBlobs);
+  void match_global(std::vector<Blob> &existingBlobs, std::vector<Blob> &currentFrameBlobs);
+  void report_vehicle(const Blob &blob);
 
  public:
   const cv::Scalar SCALAR_BLACK = cv::Scalar(0.0, 0.0, 0.0);
@@ -32,7 +83,16 @@ class Tracker {
   const cv::Mat &get_frame2();
   const std::vector<Blob> &get_blobs();
   const double &get_fps();
+  const MatchingStrategy &get_matching_strategy() const;
+  void set_matching_strategy(const MatchingStrategy &strategy_);
+  const SpeedTiming &get_speed_timing() const;
+  void set_speed_timing(const SpeedTiming &timing_);
+  MotionModel &get_motion_model();
+  void set_speed_event_log(SpeedEventLog *speed_event_log_);
+  void set_snapshot_writer(SnapshotWriter *snapshot_writer_);
+  void set_clip_recorder(ClipRecorder *clip_recorder_);
   void match_current_frame_to_existing_blobs(std::vector<Blob> &existingBlobs, std::vector<Blob> &currentFrameBlobs);
+  void predict_undetected_frame(std::vector<Blob> &existingBlobs);
   void add_blob_to_existing_blobs(Blob &currentFrameBlob, std::vector<Blob> &existingBlobs, int &intIndex);
   void add_new_blob(Blob &currentFrameBlob, std::vector<Blob> &existingBlobs);
   double distance_between_points(cv::Point point1, cv::Point point2);
@@ -44,9 +104,17 @@ class Tracker {
                        std::vector<cv::Point> &end_point,
                        double conversion,
                        unsigned int frame_count);
+  void track_car_speed(std::vector<Blob> &blobs,
+                       std::vector<cv::Point> &start_point,
+                       std::vector<cv::Point> &end_point,
+                       double conversion,
+                       unsigned int frame_count,
+                       double timestamp);
   bool blob_crossed_line(std::vector<Blob> &blobs, int x_line_pos);
   void draw_blob_info_on_image(std::vector<Blob> &blobs, cv::Mat &imgFrame2Copy);
   void draw_car_count_on_image(const int &carCount, cv::Mat &imgFrame2Copy);
   void write_tracked_car_image(const cv::Mat &frame, cv::Rect bounding_rectangle, unsigned int car_id, std::string file_path);
   void write_tracked_car_speed(double speed, int blob_id, std::string file_path);
 };
+
+#endif //TRAFFIC_MONITOR_TRACKER_H
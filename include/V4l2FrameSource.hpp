@@ -0,0 +1,69 @@
+/**
+ * V4l2FrameSource.hpp
+ */
+
+#ifndef TRAFFIC_MONITOR_V4L2FRAMESOURCE_H
+#define TRAFFIC_MONITOR_V4L2FRAMESOURCE_H
+
+#include <memory>
+#include <string>
+
+#include "FrameSource.hpp"
+
+// The open device and its memory mapped buffers. Shared with every lease so that buffers stay mapped while in use.
+struct V4l2Device;
+
+class V4l2FrameSource : public FrameSource {
+ public:
+  explicit V4l2FrameSource(const std::string &device_path_);
+  ~V4l2FrameSource() override;
+
+  V4l2FrameSource(const V4l2FrameSource &) = delete;
+  V4l2FrameSource &operator=(const V4l2FrameSource &) = delete;
+
+  const std::string &get_device_path() const;
+
+  const unsigned int &get_buffer_count() const;
+  void set_buffer_count(const unsigned int buffer_count_);
+
+  const unsigned int &get_reserved_buffers() const;
+  void set_reserved_buffers(const unsigned int reserved_buffers_);
+
+  const int &get_timeout_ms() const;
+  void set_timeout_ms(const int timeout_ms_);
+
+  bool open() override;
+  bool read(SourceFrame &frame) override;
+  void close() override;
+  bool is_open() const override;
+  cv::Size get_frame_size() const override;
+  bool is_raw() const override;
+  bool is_live() const override;
+  unsigned long long get_dropped_frames() const override;
+
+  unsigned int get_mapped_buffers() const;
+  unsigned int get_queued_buffers() const;
+  const unsigned long long &get_copied_frames() const;
+
+  static bool is_vivid(const std::string &device_path);
+
+ private:
+  // Configuration
+  std::string device_path;
+  unsigned int buffer_count;
+  unsigned int reserved_buffers;
+  int timeout_ms;
+
+  // Stream state
+  std::shared_ptr<V4l2Device> device;
+  cv::Size frame_size;
+  int frame_type;
+  size_t bytes_per_line;
+  bool first_sequence_seen;
+  unsigned int first_sequence;
+  unsigned int last_sequence;
+  unsigned long long dropped_frames;
+  unsigned long long copied_frames;
+};
+
+#endif //TRAFFIC_MONITOR_V4L2FRAMESOURCE_H
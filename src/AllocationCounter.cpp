@@ -0,0 +1,101 @@
+/**
+ * AllocationCounter.cpp
+ *
+ * Replaces the global allocation functions with versions which count each call before deferring to malloc/free. The
+ * replacements live in this translation unit so they are linked in whenever the counters are referenced.
+ */
+
+#include "AllocationCounter.hpp"
+
+#ifdef TRAFFIC_MONITOR_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<unsigned long long> total_allocations(0);
+thread_local unsigned long long thread_allocations = 0;
+
+void *counted_allocate(std::size_t size) {
+  total_allocations.fetch_add(1, std::memory_order_relaxed);
+  thread_allocations++;
+  return std::malloc(size == 0 ? 1 : size);
+}
+}
+
+void *operator new(std::size_t size) {
+  void *ptr = counted_allocate(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](std::size_t size) {
+  void *ptr = counted_allocate(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return counted_allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return counted_allocate(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+bool allocation_counting_enabled() {
+  return true;
+}
+
+unsigned long long allocation_count() {
+  return total_allocations.load(std::memory_order_relaxed);
+}
+
+unsigned long long thread_allocation_count() {
+  return thread_allocations;
+}
+
+#else
+
+bool allocation_counting_enabled() {
+  return false;
+}
+
+unsigned long long allocation_count() {
+  return 0;
+}
+
+unsigned long long thread_allocation_count() {
+  return 0;
+}
+
+#endif
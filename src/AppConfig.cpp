@@ -24,20 +24,67 @@
  *  calib_rect = transformer.transform_calibration_rectangle(calib_rect);
 
  */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <thread>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/opencv.hpp>
 
 
+#include "AllocationCounter.hpp"
 #include "Blob.hpp"
-#include "Transform.hpp"
 #include "AppConfig.hpp"
+#include "Luminance.hpp"
+#include "Profiler.hpp"
+
+namespace {
+// Set from signal handlers, which may only touch lock-free flags
+static_assert(ATOMIC_BOOL_LOCK_FREE == 2, "signal handlers need lock-free flags");
+std::atomic<bool> shutdown_signal_received(false);
+std::atomic<bool> preview_signal_received(false);
+
+void handle_shutdown_signal(int) {
+  shutdown_signal_received = true;
+}
+
+void handle_preview_signal(int) {
+  preview_signal_received = true;
+}
+
+double seconds_since(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+}
 
 /**
  * Default constructor for AppConfig
  */
-AppConfig::AppConfig() = default;
+AppConfig::AppConfig()
+    : prefetch_frames(4),
+      pipelined(true),
+      queue_capacity(4),
+      stop_requested(false),
+      preview_requested(false),
+      headless(false),
+      preview_interval(0),
+      first_frame(true),
+      pixels_to_meters(1.0),
+      frame_allocations(0),
+      working_scale(1.0),
+      luminance_only(false),
+      capture_raw(false),
+      motion_gating(false),
+      idle_frames(0),
+      adaptive_quality(false),
+      quality_level(static_cast<int>(QualityLevel::FULL)),
+      applied_quality_level(QualityLevel::FULL),
+      continuous_recording(true),
+      clip_recording(false) {}
 
 /**
  * Constructor for AppConfig
@@ -73,15 +120,30 @@ AppConfig::AppConfig(Tracker &tracker_,
       FPS(fps_),
       FRAME_WIDTH(frame_width_),
       FRAME_HEIGHT(frame_height_),
-      calibration_region_area(calibration_region_area_) {
-  live_capture = true;
-
-  if (!video_path_.empty()) {
-    live_capture = false;
-    set_SOURCE_VIDEO_PATH(video_path_);
-  }
-
-};
+      calibration_region_area(calibration_region_area_),
+      prefetch_frames(4),
+      pipelined(true),
+      queue_capacity(4),
+      stop_requested(false),
+      preview_requested(false),
+      headless(false),
+      preview_interval(0),
+      first_frame(true),
+      pixels_to_meters(1.0),
+      frame_allocations(0),
+      region_of_interest(bgs_.get_region_of_interest()),
+      working_scale(1.0),
+      luminance_only(false),
+      capture_raw(false),
+      motion_gating(false),
+      idle_frames(0),
+      adaptive_quality(false),
+      quality_level(static_cast<int>(QualityLevel::FULL)),
+      applied_quality_level(QualityLevel::FULL),
+      continuous_recording(true),
+      clip_recording(false) {
+  set_SOURCE_VIDEO_PATH(video_path_);
+}
 
 AppConfig::~AppConfig() = default;
 
@@ -140,50 +202,346 @@ const std::string &AppConfig::get_SOURCE_VIDEO_PATH() const {
   return SOURCE_VIDEO_PATH;
 }
 
+/**
+ * Sets where frames are read from when no frame source is set. See FrameSource::create().
+ * @param PATH_ std::string     a video file, a printf style image sequence such as frames/%06d.png, /dev/videoN for a
+ * camera, or empty for the first camera
+ */
 void AppConfig::set_SOURCE_VIDEO_PATH(const std::string &PATH_) {
   AppConfig::SOURCE_VIDEO_PATH = PATH_;
 }
 
+const cv::Ptr<FrameSource> &AppConfig::get_frame_source() const {
+  return frame_source;
+}
+
+/**
+ * Sets the source frames are read from, in place of the one for SOURCE_VIDEO_PATH. It is asked for the configured FPS
+ * and frame size, and for raw frames when detecting on luminance only.
+ * @param frame_source_ FrameSource     the source, or an empty pointer to read SOURCE_VIDEO_PATH
+ */
+void AppConfig::set_frame_source(const cv::Ptr<FrameSource> &frame_source_) {
+  frame_source = frame_source_;
+}
+
+const size_t &AppConfig::get_prefetch_frames() const {
+  return prefetch_frames;
+}
+
+/**
+ * Sets how many frames a decoder thread may decode ahead of the capture stage. Decoding then overlaps processing, so a
+ * recording is replayed as fast as the pipeline can process it.
+ * @param prefetch_frames_ size_t   number of frames. 0 decodes each frame on the capture stage as it is needed.
+ */
+void AppConfig::set_prefetch_frames(const size_t prefetch_frames_) {
+  prefetch_frames = prefetch_frames_;
+}
+
+const std::string &AppConfig::get_trace_path() const {
+  return trace_path;
+}
+
+/**
+ * Sets where a Chrome trace-event file of every timed stage is written at the end of each run. Only builds with
+ * TRAFFIC_MONITOR_PROFILE time stages, so other builds write no trace.
+ * @param trace_path_ std::string   path of the trace, or empty to keep no trace
+ */
+void AppConfig::set_trace_path(const std::string &trace_path_) {
+  trace_path = trace_path_;
+}
+
 const int &AppConfig::get_calibration_region_area() const {
   return calibration_region_area;
 }
 
+const bool &AppConfig::get_pipelined() const {
+  return pipelined;
+}
+
+/**
+ * Selects between running every stage on the calling thread or splitting capture, background subtraction, tracking and
+ * encoding across their own threads
+ * @param pipelined_ bool   true to run the stages concurrently
+ */
+void AppConfig::set_pipelined(const bool pipelined_) {
+  pipelined = pipelined_;
+}
+
+const size_t &AppConfig::get_queue_capacity() const {
+  return queue_capacity;
+}
+
+/**
+ * Sets how many frames may wait between two pipeline stages before the upstream stage blocks
+ * @param capacity_ size_t  number of frames per queue
+ */
+void AppConfig::set_queue_capacity(const size_t capacity_) {
+  queue_capacity = capacity_;
+}
+
+/**
+ * Number of heap allocations made while processing the most recent frame, summed across every pipeline stage. Always
+ * zero when allocation counting is compiled out.
+ */
+const unsigned long long &AppConfig::get_frame_allocations() const {
+  return frame_allocations;
+}
+
+const TrackStore &AppConfig::get_track_store() const {
+  return track_store;
+}
+
+/**
+ * Sets the store used to hold the tracked blobs, along with its history and memory limits
+ * @param track_store_ TrackStore   the store to use for the next run
+ */
+void AppConfig::set_track_store(const TrackStore &track_store_) {
+  track_store = track_store_;
+}
+
+/**
+ * Depth statistics of the queues between each pipeline stage, as recorded by the most recent call to run()
+ */
+const std::vector<QueueStats> &AppConfig::get_queue_stats() const {
+  return queue_stats;
+}
+
+const BlobFilter &AppConfig::get_blob_filter() const {
+  return blob_filter;
+}
+
+/**
+ * Sets the thresholds a foreground region must pass to be tracked as a vehicle. They are rescaled from the filter's
+ * reference size to the working frame size when run() starts.
+ * @param filter_ BlobFilter    area, size and fill thresholds. See BlobExtractor.hpp.
+ */
+void AppConfig::set_blob_filter(const BlobFilter &filter_) {
+  blob_filter = filter_;
+}
+
+const RegionOfInterest &AppConfig::get_region_of_interest() const {
+  return region_of_interest;
+}
+
+/**
+ * Restricts detection to the road, so that sky, trees and parked cars are never modelled. Applied when run() starts.
+ * @param region_ RegionOfInterest  polygons around the road in native frame coordinates. See RegionOfInterest.hpp.
+ */
+void AppConfig::set_region_of_interest(const RegionOfInterest &region_) {
+  region_of_interest = region_;
+}
+
+const double &AppConfig::get_working_scale() const {
+  return working_scale;
+}
+
+/**
+ * Runs background subtraction and blob extraction on a downscaled copy of each frame, so that high resolution cameras
+ * do not pay high resolution cost for detection. Blobs are mapped back to native resolution for tracking, speeds and
+ * overlays. Applied when run() starts.
+ * @param working_scale_ double     size of the working frame relative to the captured frame, within (0, 1]. For
+ * example 0.5 detects 1080p input at 540p.
+ */
+void AppConfig::set_working_scale(const double working_scale_) {
+  working_scale = std::min(1.0, std::max(0.05, working_scale_));
+}
+
+const bool &AppConfig::get_luminance_only() const {
+  return luminance_only;
+}
+
+/**
+ * Runs background subtraction and morphology on the luminance of each frame alone, moving a third of the data through
+ * the most expensive stage. Cameras which can deliver grayscale or YUYV are captured without conversion and the frame
+ * is only converted to BGR for the overlays and the recording, off the detection thread; other sources are converted to
+ * luminance once. Applied when run() starts.
+ * @param luminance_only_ bool  whether to detect on luminance only
+ */
+void AppConfig::set_luminance_only(const bool luminance_only_) {
+  luminance_only = luminance_only_;
+}
+
+const bool &AppConfig::get_motion_gating() const {
+  return motion_gating;
+}
+
+/**
+ * Idles background subtraction, blob extraction and tracking while nothing moves on the road. Every frame is still
+ * recorded. See MotionGate.hpp for how motion is detected.
+ * @param motion_gating_ bool   whether to gate detection on motion
+ */
+void AppConfig::set_motion_gating(const bool motion_gating_) {
+  motion_gating = motion_gating_;
+}
+
+/**
+ * The motion gate, whose state and duty cycle describe how much of the stream was fully processed
+ */
+const MotionGate &AppConfig::get_motion_gate() const {
+  return motion_gate;
+}
+
+/**
+ * Configures the motion gate. Its region of interest is replaced by the application's when run() starts.
+ * @param motion_gate_ MotionGate   thresholds, hold time, pre-roll and idle update interval
+ */
+void AppConfig::set_motion_gate(const MotionGate &motion_gate_) {
+  motion_gate = motion_gate_;
+}
+
+const bool &AppConfig::get_adaptive_quality() const {
+  return adaptive_quality;
+}
+
+/**
+ * Degrades processing in steps while the pipeline cannot keep up with the camera, and restores it once there is
+ * headroom again: first the preview is dropped, then detection runs at half the working scale, then the background
+ * model learns from every other frame, and finally only every other frame is detected. Every change is logged.
+ * @param adaptive_quality_ bool    whether to adapt the quality to the load
+ */
+void AppConfig::set_adaptive_quality(const bool adaptive_quality_) {
+  adaptive_quality = adaptive_quality_;
+}
+
+const QualityController &AppConfig::get_quality_controller() const {
+  return quality_controller;
+}
+
+/**
+ * Configures when processing is degraded and restored. See set_adaptive_quality().
+ * @param quality_controller_ QualityController     loads, frame counts and the lowest level allowed. The frame
+ * interval is taken from the FPS when run() starts.
+ */
+void AppConfig::set_quality_controller(const QualityController &quality_controller_) {
+  quality_controller = quality_controller_;
+}
+
+/**
+ * The log every timed vehicle is written to. Exposed so its path, format and flush policy can be configured before
+ * run(), which opens and closes it.
+ */
+SpeedEventLog &AppConfig::get_speed_event_log() {
+  return speed_event_log;
+}
+
+/**
+ * The pool which encodes the image of every timed vehicle. Exposed so its directory, JPEG quality, size limit and
+ * workers can be configured before run(), which opens and closes it.
+ */
+SnapshotWriter &AppConfig::get_snapshot_writer() {
+  return snapshot_writer;
+}
+
+const bool &AppConfig::get_continuous_recording() const {
+  return continuous_recording;
+}
+
+/**
+ * Sets whether every frame is written to output.h264. Turn it off along with set_clip_recording() to keep only the
+ * frames around each vehicle.
+ * @param continuous_recording_ bool    whether to record the whole stream
+ */
+void AppConfig::set_continuous_recording(const bool continuous_recording_) {
+  continuous_recording = continuous_recording_;
+}
+
+const bool &AppConfig::get_clip_recording() const {
+  return clip_recording;
+}
+
+/**
+ * Sets whether a clip is recorded of each timed vehicle. See ClipRecorder.
+ * @param clip_recording_ bool  whether to record clips
+ */
+void AppConfig::set_clip_recording(const bool clip_recording_) {
+  clip_recording = clip_recording_;
+}
+
+/**
+ * The recorder which cuts a clip of each timed vehicle. Exposed so its directory, pre- and post-roll, minimum speed
+ * and buffer can be configured before run().
+ */
+ClipRecorder &AppConfig::get_clip_recorder() {
+  return clip_recorder;
+}
+
+const bool &AppConfig::get_headless() const {
+  return headless;
+}
+
+/**
+ * Headless mode skips every overlay and HighGUI call so the application can run on units without a display. Frames are
+ * still recorded, without annotations. See set_preview_interval() for an optional low-rate preview.
+ * @param headless_ bool    true to run without a display
+ */
+void AppConfig::set_headless(const bool headless_) {
+  headless = headless_;
+}
+
+const unsigned int &AppConfig::get_preview_interval() const {
+  return preview_interval;
+}
+
+/**
+ * Sets how often an annotated preview is shown while running headless
+ * @param interval_ unsigned int    show every Nth frame. 0 only shows a preview when one is requested.
+ */
+void AppConfig::set_preview_interval(const unsigned int interval_) {
+  preview_interval = interval_;
+}
+
+/**
+ * Shows an annotated preview of the next captured frame while running headless. Sending SIGUSR1 to the process has the
+ * same effect.
+ */
+void AppConfig::request_preview() {
+  preview_requested = true;
+}
+
+/**
+ * Stops capturing new frames. Frames already in the pipeline are still processed and written before run() returns.
+ * SIGINT and SIGTERM have the same effect.
+ */
+void AppConfig::request_stop() {
+  stop_requested = true;
+}
+
+bool AppConfig::should_stop() const {
+  return stop_requested || shutdown_signal_received;
+}
+
 /**
  * Start the application with all necessary configurations defined within main.cpp
  */
 void AppConfig::run() {
-  cv::Mat img_frame_1;
-  cv::VideoCapture capVideo;
-  cv::VideoWriter out_video("output.h264", CV_FOURCC('H', '2', '6', '4'), 30, cv::Size(640, 480));
-  if (live_capture) {
-    capVideo.open(0);
+  // Each run reports on its own frames
+  profile_reset();
+  profile_set_tracing(!trace_path.empty());
+  if (!trace_path.empty() && !profiling_enabled()) {
+    std::cerr << "Tracing needs a build with TRAFFIC_MONITOR_PROFILE, no trace will be written" << std::endl;
+  }
+
+  cv::Ptr<FrameSource> source = frame_source ? frame_source : FrameSource::create(get_SOURCE_VIDEO_PATH());
+  source->set_fps(get_FPS());
+  source->set_requested_size(cv::Size(get_FRAME_WIDTH(), get_FRAME_HEIGHT()));
+  source->set_raw_requested(luminance_only);
+  cv::Ptr<PrefetchingFrameSource> prefetcher;
+  if (prefetch_frames > 0) {
+    prefetcher = cv::makePtr<PrefetchingFrameSource>(source, prefetch_frames);
+    capture_source = prefetcher;
   } else {
-    capVideo.open(get_SOURCE_VIDEO_PATH());
+    capture_source = source;
   }
-  unsigned int frame_count = 0;
 
-  std::vector<Blob> blobs;
-  if (!capVideo.isOpened()) {
-    std::cerr <<"Error opening the camera"<<std::endl;
+  if (!capture_source->open()) {
+    std::cerr << "Error opening the frame source" << std::endl;
+    capture_source = cv::Ptr<FrameSource>();
     return;
   }
 
-  capVideo.set(CV_CAP_PROP_FPS, get_FPS());
-  capVideo.set(CV_CAP_PROP_FRAME_WIDTH, get_FRAME_WIDTH());
-  capVideo.set(CV_CAP_PROP_FRAME_HEIGHT, get_FRAME_HEIGHT());
-
   tracker.set_car_count(0);
   tracker.set_fps(get_FPS());
 
-  // Make sure the webcam was able to be opened
-  if (!capVideo.isOpened()) {
-    printf("Error opening video.");
-    return;
-  }
-
-  char chCheckForEscKey = 0;
-  bool blnFirstFrame = true;
-
   /*
    * These values must be measured in the real world and inputted for the region of interest. This is relied upon to
    * calculate the true distance an object travels in order to enhance the accuracy at which the speed is calculated.
@@ -195,17 +553,17 @@ void AppConfig::run() {
 
   // Determine the ratio of pixels : meters to allow for accurate speed measurements.
   const double pixel_calibration_height = get_FRAME_WIDTH() / (get_calibration_region_area() * aspect_ratio);
-  double pixels_to_meters = pixel_calibration_height / real_height;
+  pixels_to_meters = pixel_calibration_height / real_height;
 
   // Define the coordinates which will be used as the starting "line" for the calibration region
-  std::vector<cv::Point> start_points;
-  start_points.emplace_back(cv::Point(211, 436));
-  start_points.emplace_back(cv::Point(442, 286));
+  calibration_start_points.clear();
+  calibration_start_points.emplace_back(cv::Point(211, 436));
+  calibration_start_points.emplace_back(cv::Point(442, 286));
 
   // Define the coordinates which will be used as the ending "line" for the calibration region
-  std::vector<cv::Point> end_points;
-  end_points.emplace_back(cv::Point(304, 247));
-  end_points.emplace_back(cv::Point(309, 294));
+  calibration_end_points.clear();
+  calibration_end_points.emplace_back(cv::Point(304, 247));
+  calibration_end_points.emplace_back(cv::Point(309, 294));
 
   //  These points correspond to the bird's eye view start points
 //  start_points.emplace_back(cv::Point2f(9, 660));
@@ -214,96 +572,571 @@ void AppConfig::run() {
 //  end_points.emplace_back(cv::Point2f(1213, 527));
 //  end_points.emplace_back(cv::Point2f(29, 502));
 
-  capVideo.read(img_frame_1);
+  // The calibration rectangle drawn over each frame never changes, so it is built once rather than per frame
+  std::vector<cv::Point2f> calib_rect;
+  calib_rect.emplace_back(cv::Point2f(304, 247));
+  calib_rect.emplace_back(cv::Point2f(437, 237));
+  calib_rect.emplace_back(cv::Point2f(442, 286));
+  calib_rect.emplace_back(cv::Point2f(309, 294));
+  transformer.set_calibration_rect(calib_rect);
+
+  track_store.clear();
+  first_frame = true;
+  stop_requested = false;
+  queue_stats.clear();
+
+  // Allow a clean shutdown from the service manager (or Ctrl-C) and previews on demand
+  shutdown_signal_received = false;
+  preview_signal_received = false;
+  void (*previous_sigint)(int) = std::signal(SIGINT, handle_shutdown_signal);
+  void (*previous_sigterm)(int) = std::signal(SIGTERM, handle_shutdown_signal);
+#ifdef SIGUSR1
+  void (*previous_sigusr1)(int) = std::signal(SIGUSR1, handle_preview_signal);
+#endif
+
+  // Size every per-frame buffer up front. Each stage holds at most one packet and each queue at most queue_capacity.
+  frame_size = capture_source->get_frame_size();
+  if (frame_size.area() <= 0) {
+    frame_size = cv::Size(get_FRAME_WIDTH(), get_FRAME_HEIGHT());
+  }
+  working_size = cv::Size(std::max(1, cvRound(frame_size.width * working_scale)),
+                          std::max(1, cvRound(frame_size.height * working_scale)));
+  // The motion gate holds back up to pre_roll_frames packets of its own
+  const size_t pre_roll_size = motion_gating ? motion_gate.get_pre_roll_frames() : 0;
+  const size_t pool_size = (pipelined ? 3 * queue_capacity + 4 : 1) + pre_roll_size;
+  FramePool pool(pool_size, frame_size, CV_8UC3, MAX_BLOBS_PER_FRAME, working_size);
+  frame_allocations = 0;
+
+  capture_raw = capture_source->is_raw();
+
+  motion_gate.reset();
+  motion_gate.set_region_of_interest(region_of_interest);
+  idle_frames = 0;
+
+  // Each run learns the background afresh
+  bgs.set_region_of_interest(region_of_interest);
+  apply_working_scale(working_scale);
+
+  quality_controller.reset();
+  if (get_FPS() > 0) {
+    quality_controller.set_frame_interval(1.0 / get_FPS());
+  }
+  quality_level = static_cast<int>(QualityLevel::FULL);
+  applied_quality_level = QualityLevel::FULL;
+  bgs.set_update_interval(1);
+
+  cv::VideoWriter out_video;
+  if (continuous_recording) {
+    out_video.open("output.h264", CV_FOURCC('H', '2', '6', '4'), 30, frame_size);
+  }
+
+  if (speed_event_log.open()) {
+    tracker.set_speed_event_log(&speed_event_log);
+  } else {
+    std::cerr << "Error opening the speed log " << speed_event_log.get_path() << std::endl;
+  }
+  snapshot_writer.open();
+  tracker.set_snapshot_writer(&snapshot_writer);
+  if (clip_recording) {
+    clip_recorder.set_fps(get_FPS());
+    clip_recorder.open();
+    tracker.set_clip_recorder(&clip_recorder);
+  }
+
+  if (pipelined) {
+    run_pipelined(out_video, pool);
+  } else {
+    run_sequential(out_video, pool);
+  }
+  if (prefetcher) {
+    queue_stats.push_back(prefetcher->get_stats("decode->capture"));
+  }
+  if (capture_source->get_dropped_frames() > 0) {
+    std::cout << "Frame source: " << capture_source->get_dropped_frames() << " frames dropped by the driver"
+              << std::endl;
+  }
+
+  // Every vehicle timed before shutdown is written before run() returns
+  tracker.set_clip_recorder(nullptr);
+  if (clip_recorder.is_open()) {
+    clip_recorder.close();
+    std::cout << "Clips: " << clip_recorder.get_written() << " written, " << clip_recorder.get_dropped()
+              << " dropped, " << clip_recorder.get_failed() << " failed" << std::endl;
+  }
+  tracker.set_snapshot_writer(nullptr);
+  snapshot_writer.close();
+  std::cout << "Snapshots: " << snapshot_writer.get_written() << " written, " << snapshot_writer.get_dropped()
+            << " dropped, " << snapshot_writer.get_failed() << " failed" << std::endl;
+  tracker.set_speed_event_log(nullptr);
+  if (speed_event_log.is_open()) {
+    speed_event_log.close();
+    std::cout << "Speed log: " << speed_event_log.get_written() << " vehicles written in "
+              << speed_event_log.get_flushes() << " batches, " << speed_event_log.get_dropped() << " dropped"
+              << std::endl;
+  }
+
+  std::signal(SIGINT, previous_sigint);
+  std::signal(SIGTERM, previous_sigterm);
+#ifdef SIGUSR1
+  std::signal(SIGUSR1, previous_sigusr1);
+#endif
 
-  while (capVideo.isOpened() && chCheckForEscKey != 27) {
-    if (img_frame_1.empty()) {
-      printf("WTF");
+  for (const QueueStats &stats : queue_stats) {
+    std::cout << "Queue " << stats.name << ": max depth " << stats.max_depth << "/" << stats.capacity
+              << ", mean depth " << stats.mean_depth << std::endl;
+  }
+  if (allocation_counting_enabled()) {
+    std::cout << "Heap allocations in the final frame: " << frame_allocations << std::endl;
+  }
+  for (const StageSummary &stage : profile_summaries()) {
+    std::cout << "Stage " << stage.name << ": " << stage.count << " runs, p50 " << stage.p50 * 1000.0 << " ms, p95 "
+              << stage.p95 * 1000.0 << " ms, p99 " << stage.p99 * 1000.0 << " ms, max " << stage.max * 1000.0
+              << " ms, total " << stage.total << " s" << std::endl;
+  }
+  profile_set_tracing(false);
+  if (profiling_enabled() && !trace_path.empty()) {
+    if (profile_write_trace(trace_path)) {
+      std::cout << "Trace written to " << trace_path << std::endl;
+    } else {
+      std::cerr << "Error writing the trace " << trace_path << std::endl;
     }
-    std::vector<Blob> currentFrameBlobs;
-    cv::Mat img_frame_1_copy = img_frame_1.clone();
-    cv::Mat img_warped;
-    cv::Mat img_warped_copy;
-    cv::Mat img_thresh;
-
-    bgs.subtract(img_frame_1_copy, img_thresh);
-    tracker.set_frame1(img_frame_1_copy);
-
-    // Initialize a transformation class pointer and create the calibration rectangle
-    Transform transformer(img_frame_1_copy);
-    std::vector<cv::Point2f> calib_rect;
-
-    calib_rect.emplace_back(cv::Point2f(304, 247));
-    calib_rect.emplace_back(cv::Point2f(437, 237));
-    calib_rect.emplace_back(cv::Point2f(442, 286));
-    calib_rect.emplace_back(cv::Point2f(309, 294));
-    transformer.set_calibration_rect(calib_rect);
-
-    // Find contours (blobs) within the frame and their associated convex hull
-    std::vector<std::vector<cv::Point>> contours;
-    std::vector<cv::Vec4i> hierarchy;
-    cv::findContours(img_thresh, contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, cv::Point(0, 0));
-    std::vector<std::vector<cv::Point>> convexHulls(contours.size());
-
-    /* Copyright: Chris Dahms
-     * For each convex hull which has been detected, determine whether or not the sizes are valid for that of a vehicle
-     */
-    for (unsigned int i = 0; i < contours.size(); i++) {
-      cv::convexHull(contours.at(i), convexHulls.at(i));
+  }
+  if (motion_gating) {
+    std::cout << "Motion gate: " << MotionGate::state_name(motion_gate.get_state()) << ", active for "
+              << motion_gate.get_active_frames() << "/" << motion_gate.get_frames() << " frames (duty cycle "
+              << motion_gate.get_duty_cycle() * 100.0 << "%), opened " << motion_gate.get_activations() << " times"
+              << std::endl;
+  }
+  if (adaptive_quality) {
+    std::cout << "Quality: " << QualityController::level_name(quality_controller.get_level()) << " at exit, degraded "
+              << quality_controller.get_degradations() << " times, recovered " << quality_controller.get_recoveries()
+              << " times" << std::endl;
+  }
+
+  // Close input/output streams
+  capture_source->close();
+  capture_source = cv::Ptr<FrameSource>();
+  out_video.release();
+}
+
+/**
+ * Runs every stage for one frame before reading the next
+ * @param out_video cv::VideoWriter     stream the annotated frames are written to
+ * @param pool FramePool    supplies the buffers for each frame
+ */
+void AppConfig::run_sequential(cv::VideoWriter &out_video, FramePool &pool) {
+  PROFILE_THREAD("main");
+  BoundedQueue<FramePacket *> pre_roll(std::max(1u, motion_gate.get_pre_roll_frames()));
+  auto finish = [this, &out_video, &pool](FramePacket *ready) {
+    track_blobs(*ready);
+    output_frame(*ready, out_video);
+    frame_allocations = ready->allocations;
+    pool.release(ready);
+  };
+
+  while (!should_stop()) {
+    FramePacket *packet = pool.acquire();
+    if (packet == nullptr) {
+      break;
+    }
+    if (!capture_frame(*packet)) {
+      pool.release(packet);
+      break;
     }
+    gate_detection(packet, pre_roll, finish);
+  }
+  flush_pre_roll(pre_roll, false, finish);
+}
+
+/**
+ * Runs capture, background subtraction, tracking and encoding concurrently. Each stage owns one thread and frames are
+ * handed between them through bounded FIFO queues, so frames leave the pipeline in the order they were captured and the
+ * tracker sees exactly the same frame_count sequence as the sequential loop. Encoding runs on the calling thread as
+ * HighGUI must be driven from a single thread.
+ * @param out_video cv::VideoWriter     stream the annotated frames are written to
+ * @param pool FramePool    supplies the buffers for each frame. Packets are returned once they have been written.
+ */
+void AppConfig::run_pipelined(cv::VideoWriter &out_video, FramePool &pool) {
+  BoundedQueue<FramePacket *> captured(queue_capacity);
+  BoundedQueue<FramePacket *> detected(queue_capacity);
+  BoundedQueue<FramePacket *> tracked(queue_capacity);
 
-    for (std::vector<cv::Point> &convexHull : convexHulls) {
-      Blob possibleBlob(convexHull);
-      // These area() ranges are chosen based on trial/error
-      if (possibleBlob.currentBoundingRect.area() > 1000 &&
-          possibleBlob.currentBoundingRect.area() < 25000 &&
-          possibleBlob.currentBoundingRect.width > 50 &&
-          possibleBlob.currentBoundingRect.height > 50 &&
-          (cv::contourArea(possibleBlob.currentContour) / (double) possibleBlob.currentBoundingRect.area()) > 0.50) {
-        currentFrameBlobs.push_back(possibleBlob);
+  std::thread capture_thread([this, &pool, &captured]() {
+    PROFILE_THREAD("capture");
+    while (!should_stop()) {
+      FramePacket *packet = pool.acquire();
+      if (packet == nullptr) {
+        break;
+      }
+      if (!capture_frame(*packet) || !captured.push(packet)) {
+        pool.release(packet);
+        break;
       }
     }
+    captured.close();
+  });
 
-    /* Copyright: Chris Dahms
-     * If this is the first frame of the video, then push all blobs to the back of the blob vector, otherwise determine
-     * if they have been seen before
-     */
-    if (blnFirstFrame) {
-      for (Blob &currentFrameBlob : currentFrameBlobs) {
-        blobs.push_back(currentFrameBlob);
-      }
-      blnFirstFrame = false;
+  std::thread detect_thread([this, &captured, &detected]() {
+    PROFILE_THREAD("detect");
+    BoundedQueue<FramePacket *> pre_roll(std::max(1u, motion_gate.get_pre_roll_frames()));
+    auto forward = [&detected](FramePacket *ready) {
+      detected.push(ready);
+    };
+
+    FramePacket *packet = nullptr;
+    while (captured.pop(packet)) {
+      gate_detection(packet, pre_roll, forward);
+    }
+    flush_pre_roll(pre_roll, false, forward);
+    detected.close();
+  });
+
+  std::thread track_thread([this, &detected, &tracked]() {
+    PROFILE_THREAD("track");
+    FramePacket *packet = nullptr;
+    while (detected.pop(packet)) {
+      track_blobs(*packet);
+      tracked.push(packet);
+    }
+    tracked.close();
+  });
+
+  PROFILE_THREAD("output");
+  FramePacket *packet = nullptr;
+  while (tracked.pop(packet)) {
+    output_frame(*packet, out_video);
+    frame_allocations = packet->allocations;
+    pool.release(packet);
+  }
+
+  capture_thread.join();
+  detect_thread.join();
+  track_thread.join();
+
+  queue_stats.push_back(captured.get_stats("capture->subtract"));
+  queue_stats.push_back(detected.get_stats("subtract->track"));
+  queue_stats.push_back(tracked.get_stats("track->encode"));
+}
+
+/**
+ * Capture stage: reads the next frame from the frame source into the packet, along with its index and timestamp
+ * @param packet FramePacket    receives the frame and its index within the stream
+ * @return false once the end of the stream has been reached
+ */
+bool AppConfig::capture_frame(FramePacket &packet) {
+  packet.allocations = 0;
+  ScopedAllocationCounter count_allocations(packet.allocations);
+  PROFILE_SCOPE("capture");
+
+  // The packet's buffer is handed to the source to decode a later frame into, and receives the buffer of this one
+  cv::Mat &captured = capture_raw ? packet.raw : packet.frame;
+  SourceFrame next;
+  std::swap(next.image, captured);
+  const bool read = capture_source->read(next);
+  std::swap(captured, next.image);
+  if (!read || captured.empty()) {
+    return false;
+  }
+  packet.frame_count = next.index;
+  packet.timestamp = next.timestamp;
+  packet.lease = std::move(next.lease);
+  packet.blobs.clear();
+  packet.detected = true;
+
+  // Decide up front whether this frame is previewed so that, when headless, the tracking stage only annotates the frames
+  // which are shown. The quality controller drops the preview first, apart from previews requested on demand.
+  const bool preview_shed = static_cast<QualityLevel>(quality_level.load()) >= QualityLevel::NO_PREVIEW;
+  packet.show_preview = !headless && !preview_shed;
+  if (headless) {
+    bool interval_reached = !preview_shed && preview_interval > 0 && packet.frame_count % preview_interval == 0;
+    // Each request is read and cleared in a single step, so one which arrives meanwhile is never lost
+    const bool requested = preview_requested.exchange(false);
+    const bool signalled = preview_signal_received.exchange(false);
+    const bool on_demand = requested || signalled;
+    packet.show_preview = interval_reached || on_demand;
+  }
+  return true;
+}
+
+/**
+ * Background subtraction stage: isolates the foreground of the frame and extracts the blobs which are sized like a
+ * vehicle
+ * @param packet FramePacket    the captured frame. Receives the foreground mask and the detected blobs.
+ */
+void AppConfig::detect_blobs(FramePacket &packet) {
+  ScopedAllocationCounter count_allocations(packet.allocations);
+  PROFILE_SCOPE("detect");
+  const auto started = std::chrono::steady_clock::now();
+
+  // At the lowest quality only every other frame is detected. The tracker predicts its tracks through the others.
+  if (applied_quality_level >= QualityLevel::SKIP_FRAMES && packet.frame_count % 2 == 1) {
+    packet.detected = false;
+    packet.detect_seconds = seconds_since(started);
+    return;
+  }
+
+  subtract_background(packet);
+
+  // The mask is zero outside the region of interest, so only its bounding box is searched. Blobs are mapped back to
+  // native resolution.
+  const int native_width = (capture_raw ? packet.raw : packet.frame).cols;
+  const cv::Rect &processed_rect = bgs.get_processed_rect();
+  if (processed_rect.area() > 0) {
+    PROFILE_SCOPE("extract");
+    blob_extractor.extract(packet.foreground(processed_rect), packet.blobs, processed_rect.tl(),
+                           native_width / (double) working_size.width);
+  }
+  packet.detect_seconds = seconds_since(started);
+}
+
+/**
+ * Updates the background model with the packet's frame, converted to luminance and downscaled to the working size as
+ * configured, and leaves the foreground mask in the packet
+ * @param packet FramePacket    the captured frame
+ */
+void AppConfig::subtract_background(FramePacket &packet) {
+  PROFILE_SCOPE("subtract");
+  cv::Mat detection_frame = capture_raw ? packet.raw : packet.frame;
+  if (luminance_only) {
+    extract_luminance(detection_frame, packet.luminance);
+    detection_frame = packet.luminance;
+  }
+  if (detection_frame.size() != working_size) {
+    cv::resize(detection_frame, packet.working_frame, working_size, 0, 0, cv::INTER_AREA);
+    detection_frame = packet.working_frame;
+  }
+  bgs.subtract(detection_frame, packet.foreground);
+}
+
+/**
+ * Stands in for detection on a frame the motion gate found empty. No blobs are detected, but every
+ * idle_update_interval frames the background model is still updated so that it follows the lighting.
+ * @param packet FramePacket    the captured frame
+ */
+void AppConfig::skip_detection(FramePacket &packet) {
+  ScopedAllocationCounter count_allocations(packet.allocations);
+  PROFILE_SCOPE("skip_detection");
+  const auto started = std::chrono::steady_clock::now();
+
+  const unsigned int interval = motion_gate.get_idle_update_interval();
+  if (interval > 0 && idle_frames++ % interval == 0) {
+    subtract_background(packet);
+  }
+  packet.detect_seconds = seconds_since(started);
+}
+
+/**
+ * Sets the size of the frames detection runs on. Thresholds and the region of interest are configured in native pixels,
+ * so they are scaled to match. The background subtractor keeps a model for each size it has run at.
+ * @param scale double  size of the working frame relative to the captured frame
+ * @return true if the model kept for this size was resumed, false if the background has to be learnt at this size
+ */
+bool AppConfig::apply_working_scale(const double scale) {
+  working_size = cv::Size(std::max(1, cvRound(frame_size.width * scale)),
+                          std::max(1, cvRound(frame_size.height * scale)));
+  blob_extractor.set_filter(blob_filter.scaled_to(working_size));
+  return bgs.set_working_size(working_size,
+                              region_of_interest.scaled(working_size.width / (double) frame_size.width));
+}
+
+/**
+ * Brings the detection stage in line with the level most recently published by the quality controller. Runs on the
+ * detection stage before each frame, so the working size and background model never change under a frame in progress.
+ */
+void AppConfig::apply_quality_level() {
+  const QualityLevel level = static_cast<QualityLevel>(quality_level.load());
+  if (level == applied_quality_level) {
+    return;
+  }
+
+  const bool reduced = level >= QualityLevel::REDUCED_RESOLUTION;
+  if (reduced != (applied_quality_level >= QualityLevel::REDUCED_RESOLUTION)
+      && !apply_working_scale(reduced ? working_scale / 2.0 : working_scale)) {
+    std::cout << "Quality: learning the background at " << working_size.width << "x" << working_size.height
+              << " for " << QualityController::level_name(level) << std::endl;
+  }
+  bgs.set_update_interval(level >= QualityLevel::SPARSE_BACKGROUND ? 2 : 1);
+  applied_quality_level = level;
+}
+
+/**
+ * Feeds the time a frame took to the quality controller and publishes any change of level. Capture is not counted, as
+ * reading from a camera waits for the next frame. When pipelined the stages overlap, so the slowest stage sets the pace;
+ * otherwise the stages add up.
+ * @param packet FramePacket    the frame which has just been written
+ * @param output_seconds double     time the encoding stage spent on it
+ */
+void AppConfig::record_processing_time(const FramePacket &packet, const double output_seconds) {
+  const double seconds = pipelined ? std::max(packet.detect_seconds, std::max(packet.track_seconds, output_seconds))
+                                   : packet.detect_seconds + packet.track_seconds + output_seconds;
+  const QualityLevel previous = quality_controller.get_level();
+  if (!quality_controller.record(seconds)) {
+    return;
+  }
+
+  const QualityLevel level = quality_controller.get_level();
+  quality_level = static_cast<int>(level);
+  std::cout << "Quality: " << (level > previous ? "degraded" : "recovered") << " to "
+            << QualityController::level_name(level) << " at frame " << packet.frame_count << " (processing "
+            << quality_controller.get_average_seconds() * 1000.0 << " ms against a "
+            << quality_controller.get_frame_interval() * 1000.0 << " ms frame interval)" << std::endl;
+}
+
+/**
+ * Detection stage behind the motion gate. While the gate is idle the newest frames are held back as pre-roll and the
+ * oldest leaves without detection. When motion opens the gate the held frames are detected first, in capture order, so
+ * the entry of the vehicle which opened it is not missed.
+ * @param packet FramePacket    the captured frame
+ * @param pre_roll BoundedQueue     frames held back while idle, oldest first
+ * @param emit      called with each packet which leaves the stage, in capture order
+ */
+template<typename Emit>
+void AppConfig::gate_detection(FramePacket *packet, BoundedQueue<FramePacket *> &pre_roll, Emit emit) {
+  apply_quality_level();
+
+  if (!motion_gating) {
+    detect_blobs(*packet);
+    emit(packet);
+    return;
+  }
+
+  if (motion_gate.update(capture_raw ? packet->raw : packet->frame)) {
+    flush_pre_roll(pre_roll, true, emit);
+    detect_blobs(*packet);
+    emit(packet);
+    return;
+  }
+
+  FramePacket *oldest = packet;
+  if (motion_gate.get_pre_roll_frames() > 0) {
+    if (pre_roll.size() < pre_roll.get_capacity()) {
+      pre_roll.push(packet);
+      return;
+    }
+    pre_roll.try_pop(oldest);
+    pre_roll.push(packet);
+  }
+  skip_detection(*oldest);
+  emit(oldest);
+}
+
+/**
+ * Releases every frame held back by the motion gate, oldest first
+ * @param pre_roll BoundedQueue     frames held back while idle
+ * @param detect bool   whether to detect blobs on them, or pass them on as idle frames
+ * @param emit      called with each packet, in capture order
+ */
+template<typename Emit>
+void AppConfig::flush_pre_roll(BoundedQueue<FramePacket *> &pre_roll, bool detect, Emit emit) {
+  FramePacket *held = nullptr;
+  while (pre_roll.try_pop(held)) {
+    if (detect) {
+      detect_blobs(*held);
     } else {
-      tracker.match_current_frame_to_existing_blobs(blobs, currentFrameBlobs);
+      skip_detection(*held);
     }
+    emit(held);
+  }
+}
 
-    tracker.blob_crossed_line(blobs, start_points.at(0).x);
-    tracker.track_car_speed(blobs, start_points, end_points, pixels_to_meters, frame_count);
-    tracker.draw_blob_info_on_image(blobs, img_frame_1_copy);
-    tracker.draw_car_count_on_image(tracker.get_car_count(), img_frame_1_copy);
-    transformer.draw_calibration_rectangle(img_frame_1_copy);
+/**
+ * Tracking stage: matches the detected blobs to the existing tracks, counts vehicles and measures their speed. Frames
+ * must arrive in capture order as the speed calculations rely on frame_count.
+ * @param packet FramePacket    the frame and its detected blobs. The tracking overlays are drawn onto the frame.
+ */
+void AppConfig::track_blobs(FramePacket &packet) {
+  ScopedAllocationCounter count_allocations(packet.allocations);
+  PROFILE_SCOPE("track");
+  const auto started = std::chrono::steady_clock::now();
 
-    cv::imshow("Car Tracker", img_frame_1_copy);
+  // Frames captured without conversion are only converted to BGR here, for the overlays and the recording
+  if (capture_raw) {
+    convert_to_bgr(packet.raw, packet.frame);
+  }
 
-    // Prepare for next iteration
-    currentFrameBlobs.clear();
-    capVideo.read(img_frame_1);
+  tracker.set_frame1(packet.frame);
 
-    // If escape is pressed, close the program
-    chCheckForEscKey = cv::waitKey(1);
+  /* Copyright: Chris Dahms
+   * If this is the first frame of the video, then push all blobs to the back of the blob vector, otherwise determine
+   * if they have been seen before
+   */
+  std::vector<Blob> &blobs = track_store.get_blobs();
+  if (!packet.detected) {
+    // Nothing was measured, so the tracks are only predicted. Their positions are those of the last detected frame,
+    // which have already been checked for crossings and timed.
+    tracker.predict_undetected_frame(blobs);
+  } else if (first_frame) {
+    for (Blob &currentFrameBlob : packet.blobs) {
+      blobs.push_back(currentFrameBlob);
+    }
+    first_frame = false;
+  } else {
+    tracker.match_current_frame_to_existing_blobs(blobs, packet.blobs);
+  }
 
-    // Write the modified frame to disk to view later
-    out_video.write(img_frame_1_copy);
+  if (packet.detected) {
+    tracker.blob_crossed_line(blobs, calibration_start_points.at(0).x);
+    tracker.track_car_speed(blobs, calibration_start_points, calibration_end_points, pixels_to_meters,
+                            packet.frame_count, packet.timestamp);
+  }
 
-    // If running a pre-existing video, make sure the while loop terminates once the video is over
-    if (!live_capture && capVideo.get(CV_CAP_PROP_POS_FRAMES) == capVideo.get(CV_CAP_PROP_FRAME_COUNT)) {
-      break;
+  // Blobs which are no longer tracked have been counted and timed, so retire them before the next frame
+  track_store.compact();
+
+  // With a window the overlays are part of the recording, so every frame is annotated whether or not it is shown and
+  // the recording does not change with load. Headless previews are annotated on a copy so the recording stays free of
+  // overlays, and only when shown.
+  if (headless && !packet.show_preview) {
+    packet.track_seconds = seconds_since(started);
+    return;
+  }
+
+  PROFILE_SCOPE("draw");
+  cv::Mat &annotated = headless ? packet.preview : packet.frame;
+  if (headless) {
+    packet.frame.copyTo(packet.preview);
+  }
+
+  tracker.draw_blob_info_on_image(blobs, annotated);
+  tracker.draw_car_count_on_image(tracker.get_car_count(), annotated);
+  transformer.draw_calibration_rectangle(annotated);
+  packet.track_seconds = seconds_since(started);
+}
+
+/**
+ * Encoding stage: displays the annotated frame, unless running headless, and writes the frame to disk
+ * @param packet FramePacket    the annotated frame
+ * @param out_video cv::VideoWriter     stream to write the frame to
+ */
+void AppConfig::output_frame(FramePacket &packet, cv::VideoWriter &out_video) {
+  ScopedAllocationCounter count_allocations(packet.allocations);
+  PROFILE_SCOPE("output");
+  const auto started = std::chrono::steady_clock::now();
+
+  // While the quality controller sheds the preview the window's events are still handled, so that it keeps responding
+  if (packet.show_preview || !headless) {
+    PROFILE_SCOPE("imshow");
+    if (packet.show_preview) {
+      cv::imshow("Car Tracker", headless ? packet.preview : packet.frame);
     }
 
-    frame_count++;
+    // If escape is pressed, close the program
+    if (cv::waitKey(1) == 27) {
+      stop_requested = true;
+    }
   }
 
-  // Close input/output streams
-  capVideo.release();
-  out_video.release();
+  // Write the modified frame to disk to view later, and keep it for the clips of vehicles still to be timed
+  if (out_video.isOpened()) {
+    PROFILE_SCOPE("write");
+    out_video.write(packet.frame);
+  }
+  if (clip_recording) {
+    PROFILE_SCOPE("clip");
+    clip_recorder.push(packet.frame, packet.frame_count, packet.timestamp);
+  }
+
+  if (adaptive_quality) {
+    record_processing_time(packet, seconds_since(started));
+  }
 }
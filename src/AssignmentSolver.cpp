@@ -0,0 +1,196 @@
+/**
+ * AssignmentSolver.cpp
+ *
+ * Solves the gated linear assignment problem between the blobs of the current frame and the existing tracks. Only the
+ * pairs which pass the distance gate are given as edges, which keeps the cost matrix sparse. The edges are split into
+ * connected components and each component is solved exactly with the Hungarian algorithm, so a frame full of vehicles
+ * that are far apart costs little more than the greedy matcher. Every row may also be left unassigned at a fixed cost,
+ * which is how a blob ends up starting a new track.
+ */
+
+#include <cstddef>
+#include <limits>
+
+#include "AssignmentSolver.hpp"
+
+/**
+ * Default constructor for AssignmentSolver. Leaving a row unassigned costs 1, the cost of a pair at the edge of the gate
+ * when costs are expressed as a fraction of the gate.
+ */
+AssignmentSolver::AssignmentSolver()
+    : unassigned_cost(1.0) {}
+
+/**
+ * Constructor for AssignmentSolver
+ * @param unassigned_cost_ double   cost of leaving a row without a column. Edges costing more than this are never used.
+ */
+AssignmentSolver::AssignmentSolver(double unassigned_cost_)
+    : unassigned_cost(unassigned_cost_) {}
+
+const double &AssignmentSolver::get_unassigned_cost() const {
+  return unassigned_cost;
+}
+
+void AssignmentSolver::set_unassigned_cost(const double unassigned_cost_) {
+  unassigned_cost = unassigned_cost_;
+}
+
+/**
+ * Finds the assignment of rows to columns with the least total cost, where each column is used at most once
+ * @param rows int  number of rows
+ * @param cols int  number of columns
+ * @param edges std::vector<AssignmentEdge>     the permitted pairs and their costs. Rows and columns without an edge
+ * are left unassigned.
+ * @param row_to_col std::vector<int>   receives the column assigned to each row, or -1 if the row is unassigned
+ */
+void AssignmentSolver::solve(int rows, int cols, const std::vector<AssignmentEdge> &edges, std::vector<int> &row_to_col) {
+  row_to_col.assign(rows, -1);
+  if (rows == 0 || cols == 0 || edges.empty()) {
+    return;
+  }
+
+  // Union-find over the rows [0, rows) and columns [rows, rows + cols) to separate independent groups of blobs
+  const int nodes = rows + cols;
+  parent.resize(nodes);
+  for (int i = 0; i < nodes; i++) {
+    parent[i] = i;
+  }
+  for (const AssignmentEdge &edge : edges) {
+    int a = find_root(edge.row);
+    int b = find_root(rows + edge.col);
+    if (a != b) {
+      parent[a] = b;
+    }
+  }
+
+  component_of_node.assign(nodes, -1);
+  int components = 0;
+  for (const AssignmentEdge &edge : edges) {
+    int root = find_root(edge.row);
+    if (component_of_node[root] < 0) {
+      component_of_node[root] = components++;
+    }
+  }
+  if ((int) rows_by_component.size() < components) {
+    rows_by_component.resize(components);
+    cols_by_component.resize(components);
+    edges_by_component.resize(components);
+  }
+  for (int c = 0; c < components; c++) {
+    rows_by_component[c].clear();
+    cols_by_component[c].clear();
+    edges_by_component[c].clear();
+  }
+
+  // Number each row and column within its component
+  local_index.assign(nodes, -1);
+  for (int e = 0; e < (int) edges.size(); e++) {
+    const AssignmentEdge &edge = edges[e];
+    int component = component_of_node[find_root(edge.row)];
+    if (local_index[edge.row] < 0) {
+      local_index[edge.row] = (int) rows_by_component[component].size();
+      rows_by_component[component].push_back(edge.row);
+    }
+    if (local_index[rows + edge.col] < 0) {
+      local_index[rows + edge.col] = (int) cols_by_component[component].size();
+      cols_by_component[component].push_back(edge.col);
+    }
+    edges_by_component[component].push_back(e);
+  }
+
+  for (int c = 0; c < components; c++) {
+    solve_component(rows_by_component[c], cols_by_component[c], edges_by_component[c], edges, row_to_col);
+  }
+}
+
+int AssignmentSolver::find_root(int node) {
+  while (parent[node] != node) {
+    parent[node] = parent[parent[node]];
+    node = parent[node];
+  }
+  return node;
+}
+
+/**
+ * Solves a single component with the Hungarian algorithm. The cost matrix has one row per blob and one column per track
+ * plus one "unassigned" column per blob, so every row can always be assigned.
+ */
+void AssignmentSolver::solve_component(const std::vector<int> &component_rows,
+                                       const std::vector<int> &component_cols,
+                                       const std::vector<int> &component_edges,
+                                       const std::vector<AssignmentEdge> &edges,
+                                       std::vector<int> &row_to_col) {
+  const int n = (int) component_rows.size();
+  const int real_cols = (int) component_cols.size();
+  const int m = real_cols + n;
+  const int rows = (int) row_to_col.size();
+  const double forbidden = unassigned_cost * 1e6 + 1e6;
+  const double infinity = std::numeric_limits<double>::infinity();
+
+  // Dense cost matrix for the component, stored row-major and 1-indexed as the algorithm expects
+  cost.assign((size_t) (n + 1) * (m + 1), forbidden);
+  for (int i = 1; i <= n; i++) {
+    for (int j = real_cols + 1; j <= m; j++) {
+      cost[(size_t) i * (m + 1) + j] = unassigned_cost;
+    }
+  }
+  for (int e : component_edges) {
+    const AssignmentEdge &edge = edges[e];
+    int i = local_index[edge.row] + 1;
+    int j = local_index[rows + edge.col] + 1;
+    double &entry = cost[(size_t) i * (m + 1) + j];
+    if (edge.cost < entry) {
+      entry = edge.cost;
+    }
+  }
+
+  u.assign(n + 1, 0.0);
+  v.assign(m + 1, 0.0);
+  p.assign(m + 1, 0);
+  way.assign(m + 1, 0);
+  for (int i = 1; i <= n; i++) {
+    p[0] = i;
+    int j0 = 0;
+    minv.assign(m + 1, infinity);
+    used.assign(m + 1, 0);
+    do {
+      used[j0] = 1;
+      int i0 = p[j0];
+      int j1 = 0;
+      double delta = infinity;
+      for (int j = 1; j <= m; j++) {
+        if (!used[j]) {
+          double current = cost[(size_t) i0 * (m + 1) + j] - u[i0] - v[j];
+          if (current < minv[j]) {
+            minv[j] = current;
+            way[j] = j0;
+          }
+          if (minv[j] < delta) {
+            delta = minv[j];
+            j1 = j;
+          }
+        }
+      }
+      for (int j = 0; j <= m; j++) {
+        if (used[j]) {
+          u[p[j]] += delta;
+          v[j] -= delta;
+        } else {
+          minv[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (p[j0] != 0);
+    do {
+      int j1 = way[j0];
+      p[j0] = p[j1];
+      j0 = j1;
+    } while (j0 != 0);
+  }
+
+  for (int j = 1; j <= real_cols; j++) {
+    if (p[j] != 0 && cost[(size_t) p[j] * (m + 1) + j] < forbidden) {
+      row_to_col[component_rows[p[j] - 1]] = component_cols[j - 1];
+    }
+  }
+}
@@ -0,0 +1,147 @@
+/**
+ * BackgroundModel.cpp
+ *
+ * The background model engines behind BackgroundSubtractor. Each engine turns a captured frame into a raw foreground
+ * mask; thresholding and morphology are applied afterwards by BackgroundSubtractor regardless of the engine.
+ */
+
+#include <cassert>
+#include <cstdlib>
+
+#include "BackgroundModel.hpp"
+#include "Luminance.hpp"
+
+BackgroundModel::~BackgroundModel() = default;
+
+void BackgroundModel::apply(const cv::Mat &frame, cv::Mat &foreground) {
+  apply(frame, foreground, true);
+}
+
+/**
+ * Creates an engine with its default configuration
+ * @param engine BackgroundEngine   which engine to create
+ */
+cv::Ptr<BackgroundModel> BackgroundModel::create(BackgroundEngine engine) {
+  if (engine == BackgroundEngine::RUNNING_AVERAGE) {
+    return cv::makePtr<RunningAverageBackgroundModel>();
+  }
+  return cv::makePtr<Mog2BackgroundModel>();
+}
+
+/**
+ * Printable name of an engine, for logs, benchmarks and the command line
+ */
+const char *BackgroundModel::engine_name(BackgroundEngine engine) {
+  switch (engine) {
+    case BackgroundEngine::RUNNING_AVERAGE:
+      return "running-average";
+    default:
+      return "mog2";
+  }
+}
+
+/**
+ * Default constructor for Mog2BackgroundModel. Shadows are detected and then discarded by giving them the value 0.
+ */
+Mog2BackgroundModel::Mog2BackgroundModel() {
+  mog_subtractor = cv::createBackgroundSubtractorMOG2();
+  mog_subtractor->setDetectShadows(true);
+  mog_subtractor->setHistory(100);
+  mog_subtractor->setBackgroundRatio(0.4);
+  mog_subtractor->setVarThreshold(8);
+  mog_subtractor->setShadowThreshold(0.5);
+  mog_subtractor->setNMixtures(3);
+  mog_subtractor->setShadowValue(0);
+}
+
+/**
+ * Runs MOG2 with its automatic learning rate, or a learning rate of 0 when the model is not updated
+ */
+void Mog2BackgroundModel::apply(const cv::Mat &frame, cv::Mat &foreground, bool update_model) {
+  mog_subtractor->apply(frame, foreground, update_model ? -1.0 : 0.0);
+}
+
+BackgroundEngine Mog2BackgroundModel::get_engine() const {
+  return BackgroundEngine::MOG2;
+}
+
+/**
+ * Default constructor for RunningAverageBackgroundModel. Learns at a rate of 1/32 per frame and marks pixels more than
+ * 25 grey levels from the average as foreground.
+ */
+RunningAverageBackgroundModel::RunningAverageBackgroundModel()
+    : learning_shift(5),
+      difference_threshold(25) {}
+
+/**
+ * Constructor for RunningAverageBackgroundModel
+ * @param learning_shift_ int   the average moves 1 / 2^learning_shift of the way towards each new frame. Larger values
+ * learn more slowly, so slow vehicles are absorbed into the background later.
+ * @param difference_threshold_ int     how many grey levels a pixel must differ from the average to be foreground
+ */
+RunningAverageBackgroundModel::RunningAverageBackgroundModel(int learning_shift_, int difference_threshold_)
+    : learning_shift(learning_shift_),
+      difference_threshold(difference_threshold_) {}
+
+const int &RunningAverageBackgroundModel::get_learning_shift() const {
+  return learning_shift;
+}
+
+void RunningAverageBackgroundModel::set_learning_shift(const int learning_shift_) {
+  learning_shift = learning_shift_;
+}
+
+const int &RunningAverageBackgroundModel::get_difference_threshold() const {
+  return difference_threshold;
+}
+
+void RunningAverageBackgroundModel::set_difference_threshold(const int difference_threshold_) {
+  difference_threshold = difference_threshold_;
+}
+
+/**
+ * Compares the luminance of the frame against the running average and then moves the average towards the frame, unless
+ * the model is not being updated. The first frame seeds the average and is reported as all background.
+ */
+void RunningAverageBackgroundModel::apply(const cv::Mat &frame, cv::Mat &foreground, bool update_model) {
+  assert(frame.depth() == CV_8U);
+
+  const cv::Mat *luminance = &frame;
+  if (frame.channels() != 1) {
+    extract_luminance(frame, gray);
+    luminance = &gray;
+  }
+
+  foreground.create(frame.size(), CV_8UC1);
+  if (background.size() != frame.size()) {
+    luminance->convertTo(background, CV_16UC1, 256.0);
+  }
+
+  const int threshold = difference_threshold;
+  const int shift = learning_shift;
+  if (!update_model) {
+    for (int row = 0; row < frame.rows; row++) {
+      const unsigned char *pixels = luminance->ptr<unsigned char>(row);
+      const unsigned short *average = background.ptr<unsigned short>(row);
+      unsigned char *mask = foreground.ptr<unsigned char>(row);
+      for (int x = 0; x < frame.cols; x++) {
+        mask[x] = std::abs(((int) pixels[x] << 8) - (int) average[x]) > (threshold << 8) ? 255 : 0;
+      }
+    }
+    return;
+  }
+  for (int row = 0; row < frame.rows; row++) {
+    const unsigned char *pixels = luminance->ptr<unsigned char>(row);
+    unsigned short *average = background.ptr<unsigned short>(row);
+    unsigned char *mask = foreground.ptr<unsigned char>(row);
+    for (int x = 0; x < frame.cols; x++) {
+      const int difference = ((int) pixels[x] << 8) - (int) average[x];
+      mask[x] = std::abs(difference) > (threshold << 8) ? 255 : 0;
+      average[x] = (unsigned short) ((int) average[x] + (difference >> shift));
+    }
+  }
+}
+
+BackgroundEngine RunningAverageBackgroundModel::get_engine() const {
+  return BackgroundEngine::RUNNING_AVERAGE;
+}
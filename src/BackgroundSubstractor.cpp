@@ -5,10 +5,31 @@
  * of isolating cars from the highway they are travelling on.
  */
 
+#include <algorithm>
+
 #include <opencv2/opencv.hpp>
 
 #include "BackgroundSubtractor.hpp"
 
+namespace {
+
+/**
+ * Clears every pixel of a mask outside a rectangle
+ */
+void clear_outside(cv::Mat &mask, const cv::Rect &rect) {
+  if (rect.area() == 0) {
+    mask.setTo(cv::Scalar(0));
+    return;
+  }
+  mask.rowRange(0, rect.y).setTo(cv::Scalar(0));
+  mask.rowRange(rect.y + rect.height, mask.rows).setTo(cv::Scalar(0));
+  cv::Mat band = mask.rowRange(rect.y, rect.y + rect.height);
+  band.colRange(0, rect.x).setTo(cv::Scalar(0));
+  band.colRange(rect.x + rect.width, mask.cols).setTo(cv::Scalar(0));
+}
+
+}
+
 /**
  * Constructor for BackgroundSubtractor
  * @param alpha     See: https://en.wikipedia.org/wiki/Alpha_compositing for more information
@@ -16,8 +37,16 @@
  * @param enable_threshold      bool indicating whether or not to incorporate thresholding on the frames
  * @param first_occurrence      bool indicating whether or not this is the first time BackgroundSubtraction has been
  * performed
+ * @param engine    BackgroundEngine indicating which background model to run. Defaults to MOG2.
+ * @param stripes   number of horizontal stripes the frame is split into, each subtracted on its own thread. Defaults
+ * to 1, a single model over the whole frame.
+ * @param update_interval   the models learn from every Nth frame. Defaults to 1, every frame.
  */
 BackgroundSubtractor::BackgroundSubtractor() :
+  engine(BackgroundEngine::MOG2),
+  stripes(1),
+  update_interval(1),
+  frames_subtracted(0),
   alpha(0.05),
   threshold(160),
   enable_threshold(true),
@@ -29,7 +58,11 @@ BackgroundSubtractor::BackgroundSubtractor() :
 BackgroundSubtractor::~BackgroundSubtractor() = default;
 
 BackgroundSubtractor::BackgroundSubtractor(cv::Mat &frame) :
-  foreground_frame(frame) {};
+  foreground_frame(frame),
+  engine(BackgroundEngine::MOG2),
+  stripes(1),
+  update_interval(1),
+  frames_subtracted(0) {};
 
 void BackgroundSubtractor::set_foreground_frame(const cv::Mat &foreground_frame_) {
   BackgroundSubtractor::foreground_frame = foreground_frame_;
@@ -39,41 +72,216 @@ const cv::Mat &BackgroundSubtractor::get_foreground_frame() const {
   return foreground_frame;
 }
 
+const BackgroundEngine &BackgroundSubtractor::get_engine() const {
+  return engine;
+}
+
+/**
+ * Chooses the background model to run. Takes effect from the next subtract() if no frame has been processed yet,
+ * otherwise the model is replaced and has to learn the background again.
+ * @param engine_ BackgroundEngine  the engine suited to this deployment. See BackgroundModel.hpp.
+ */
+void BackgroundSubtractor::set_engine(const BackgroundEngine engine_) {
+  engine = engine_;
+  reset_models();
+}
+
+const int &BackgroundSubtractor::get_stripes() const {
+  return stripes;
+}
+
+/**
+ * Splits every frame into horizontal stripes which are subtracted in parallel, each by its own background model. The
+ * models are recreated, so a change after the first frame means the background has to be learnt again.
+ * @param stripes_ int  number of stripes, usually the number of cores which can be spared for subtraction. 1 runs a
+ * single model over the whole frame on the calling thread.
+ */
+void BackgroundSubtractor::set_stripes(const int stripes_) {
+  assert(stripes_ >= 1);
+  stripes = stripes_;
+  reset_models();
+}
+
+const RegionOfInterest &BackgroundSubtractor::get_region_of_interest() const {
+  return region;
+}
+
+/**
+ * Restricts subtraction to the road. Only the bounding box of the region is modelled, and pixels of the box outside the
+ * polygons are cleared before and after the morphology, so they never form or join a blob. The output mask keeps the
+ * size of the frame and is zero outside the region. The models are recreated, and any kept by set_working_size()
+ * discarded, so a change after the first frame means the background has to be learnt again.
+ * @param region_ RegionOfInterest   polygons in frame coordinates. An empty region processes the whole frame.
+ */
+void BackgroundSubtractor::set_region_of_interest(const RegionOfInterest &region_) {
+  region = region_;
+  reset_models();
+}
+
+/**
+ * Moves subtraction to frames of another size, such as a downscaled working frame. The models learnt at the previous
+ * size are kept aside and those kept for the new size, if any, resume where they left off, so moving back and forth
+ * between sizes learns the background once for each. Setting the size already in use starts fresh models.
+ * @param size cv::Size     size of the frames subtract() will be given from now on
+ * @param region_ RegionOfInterest   the region of interest in the coordinates of frames of that size
+ * @return true if models kept for the size were resumed, false if the background has to be learnt at this size
+ */
+bool BackgroundSubtractor::set_working_size(const cv::Size &size, const RegionOfInterest &region_) {
+  region = region_;
+  if (size != working_size && !first_occurrence && working_size.area() > 0) {
+    KeptModels previous;
+    previous.size = working_size;
+    previous.model = model;
+    previous.stripe_models = stripe_models;
+    kept_models.push_back(previous);
+  }
+  working_size = size;
+  stripe_models.clear();
+  model = first_occurrence ? cv::Ptr<BackgroundModel>() : BackgroundModel::create(engine);
+
+  for (size_t i = 0; i < kept_models.size(); i++) {
+    if (kept_models[i].size == size) {
+      model = kept_models[i].model;
+      stripe_models = kept_models[i].stripe_models;
+      kept_models.erase(kept_models.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * The rectangle of the last frame which was processed: the bounding box of the region of interest, or the whole frame.
+ * Everything outside it in the foreground mask is zero.
+ */
+const cv::Rect &BackgroundSubtractor::get_processed_rect() const {
+  return region.get_bounding_rect();
+}
+
+const unsigned int &BackgroundSubtractor::get_update_interval() const {
+  return update_interval;
+}
+
+/**
+ * Lets the models learn from only every Nth frame. Every frame is still subtracted. Used to shed load when the
+ * pipeline falls behind.
+ * @param update_interval_ unsigned int     learn from every Nth frame, at least 1
+ */
+void BackgroundSubtractor::set_update_interval(const unsigned int update_interval_) {
+  update_interval = std::max(1u, update_interval_);
+}
+
+/**
+ * Discards the models after a change to their configuration, along with any kept for other working sizes. They are
+ * recreated by the next subtract().
+ */
+void BackgroundSubtractor::reset_models() {
+  if (!first_occurrence) {
+    model = BackgroundModel::create(engine);
+  }
+  stripe_models.clear();
+  kept_models.clear();
+}
+
 /**
  * Removes the foreground objects in a frame. Necessary to remove any environmental noise such as trees slightly moing
  * or shadows being casted.
  * @param input_frame cv::Mat   the original frame to remove the background from
- * @param output_frame cv::Mat  a container for the foreground objects
+ * @param output_frame cv::Mat  a container for the foreground objects. Reused without reallocation when it already has
+ * the size of input_frame and type CV_8UC1.
  */
 void BackgroundSubtractor::subtract(cv::Mat &input_frame, cv::Mat &output_frame) {
   assert(!input_frame.empty());
 
   if (first_occurrence) {
-    mog_subtractor = cv::createBackgroundSubtractorMOG2();
-    mog_subtractor->setDetectShadows(true);
-    mog_subtractor->setHistory(100);
-    mog_subtractor->setBackgroundRatio(0.4);
-    mog_subtractor->setVarThreshold(8);
-    mog_subtractor->setShadowThreshold(0.5);
-    mog_subtractor->setNMixtures(3);
-    mog_subtractor->setShadowValue(0);
+    model = BackgroundModel::create(engine);
+
+    post_processor.set_threshold(threshold);
+    post_processor.set_enable_threshold(enable_threshold);
+    post_processor.set_enable_open_close(enable_open_close);
     first_occurrence = false;
   }
 
-  mog_subtractor->apply(input_frame, foreground_frame);
+  // Only the bounding box of the region of interest is processed, in place within the full size output
+  region.prepare(input_frame.size());
+  const cv::Rect &rect = region.get_bounding_rect();
+  output_frame.create(input_frame.size(), CV_8UC1);
+  if (rect.size() != input_frame.size()) {
+    clear_outside(output_frame, rect);
+  }
+  if (rect.area() == 0) {
+    foreground_frame = output_frame;
+    return;
+  }
+  const cv::Mat input = input_frame(rect);
+  cv::Mat output = output_frame(rect);
+  const bool masked = !region.is_rectangular();
+  const bool update_model = frames_subtracted++ % update_interval == 0;
+
+  if (stripes > 1 && input.rows >= stripes) {
+    subtract_striped(input, output, update_model);
+  } else {
+    // The model writes straight into the caller's buffer and every post-processing step runs in place on it
+    model->apply(input, output, update_model);
+    if (masked) {
+      cv::bitwise_and(output, region.get_mask(), output);
+    }
 
-  // Threshold the foreground image to remove noise
-  if (enable_threshold) {
-    cv::threshold(foreground_frame, foreground_frame, threshold, 255, cv::THRESH_BINARY);
+    // Threshold the foreground image to remove noise, then erode and close it, in a single fused pass
+    post_processor.apply(output, output);
+    if (masked) {
+      cv::bitwise_and(output, region.get_mask(), output);
+    }
   }
 
-  if (enable_open_close) {
-    cv::Mat structuring_element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3), cv::Point(-1, -1));
-    cv::morphologyEx(foreground_frame, foreground_frame, cv::MORPH_ERODE, structuring_element);
-    structuring_element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(6, 6), cv::Point(-1, -1));
-    cv::morphologyEx(foreground_frame, foreground_frame, cv::MORPH_CLOSE, structuring_element);
+  // Share, rather than copy, the processed foreground with get_foreground_frame()
+  foreground_frame = output_frame;
+}
+
+/**
+ * Subtracts each horizontal stripe of the frame with its own model on OpenCV's thread pool. Both engines model every
+ * pixel independently, so the stripe models need no overlap and the stitched raw mask is what a single model would
+ * produce. The morphology does look across stripe boundaries, so it runs once the whole raw mask is stitched, again one
+ * band per thread, with each band reading a halo of rows from its neighbours. This leaves no seams at the boundaries.
+ * @param input cv::Mat     the processed rectangle of the original frame
+ * @param output cv::Mat    the same rectangle of the foreground mask, already allocated
+ * @param update_model bool     whether the models learn from this frame
+ */
+void BackgroundSubtractor::subtract_striped(const cv::Mat &input, cv::Mat &output, bool update_model) {
+  if ((int) stripe_models.size() != stripes) {
+    stripe_models.clear();
+    for (int stripe = 0; stripe < stripes; stripe++) {
+      stripe_models.push_back(BackgroundModel::create(engine));
+    }
+    stripe_scratch.resize(stripes);
   }
 
-  // Copy the contents of the processed foreground frame to the output image array
-  foreground_frame.copyTo(output_frame);
+  const int rows = input.rows;
+  const bool masked = !region.is_rectangular();
+  raw_foreground.create(input.size(), CV_8UC1);
+
+  // Each model writes straight into its rows of the stitched mask
+  cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range &range) {
+    for (int stripe = range.start; stripe < range.end; stripe++) {
+      const int row_begin = rows * stripe / stripes;
+      const int row_end = rows * (stripe + 1) / stripes;
+      cv::Mat stripe_foreground = raw_foreground.rowRange(row_begin, row_end);
+      stripe_models[stripe]->apply(input.rowRange(row_begin, row_end), stripe_foreground, update_model);
+      if (masked) {
+        cv::bitwise_and(stripe_foreground, region.get_mask().rowRange(row_begin, row_end), stripe_foreground);
+      }
+    }
+  }, stripes);
+
+  cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range &range) {
+    for (int stripe = range.start; stripe < range.end; stripe++) {
+      const int row_begin = rows * stripe / stripes;
+      const int row_end = rows * (stripe + 1) / stripes;
+      post_processor.apply_rows(raw_foreground, output, row_begin, row_end, stripe_scratch[stripe]);
+      if (masked) {
+        cv::Mat band = output.rowRange(row_begin, row_end);
+        cv::bitwise_and(band, region.get_mask().rowRange(row_begin, row_end), band);
+      }
+    }
+  }, stripes);
 }
@@ -17,19 +17,25 @@ Blob::Blob(std::vector<cv::Point> _contour) {
   currentCenter.x = (currentBoundingRect.x + currentBoundingRect.x + currentBoundingRect.width) / 2;
   currentCenter.y = (currentBoundingRect.y + currentBoundingRect.y + currentBoundingRect.height) / 2;
   centerPositions.push_back(currentCenter);
+  origin_position = currentCenter;
   blnStillBeingTracked = true;
   dblCurrentDiagonalSize = sqrt(pow(currentBoundingRect.width, 2) + pow(currentBoundingRect.height, 2));
   blnCurrentMatchFoundOrNewBlob = true;
   start_frame = 0;
   end_frame = 0;
+  start_time = 0.0;
+  end_time = 0.0;
   speed = 0.0;
+  speed_error = 0.0;
+  speed_residual = 0.0;
   tracking_speed = false;
   intNumOfConsecutiveFramesWithoutAMatch = 0;
   id = 0;
   moving_left = false;
+  motion_slot = -1;
 }
 
-// This should be refactored to something like a Kalman Filter
+// Tracker predicts every tracked blob at once through its MotionModel; this remains for predicting a lone blob
 void Blob::predict_next_position(void) {
 
   int numPositions = (int) centerPositions.size();
@@ -102,5 +108,5 @@ void Blob::predict_next_position(void) {
 
   // Want this to be the front value otherwise incorrect predictions can be made due to noise on the blob detection.
   // Enables the correct direction to be predicted for each frame.
-  moving_left = predictedNextPosition.x - centerPositions.front().x <= 0;
+  moving_left = predictedNextPosition.x - origin_position.x <= 0;
 }
@@ -0,0 +1,285 @@
+/**
+ * BlobExtractor.cpp
+ *
+ * Turns a foreground mask into the blobs which are sized like a vehicle. A single connected component labelling pass
+ * gives the bounding box of every foreground region, so regions which are too small or too large (most of them noise)
+ * are rejected from their statistics alone. Only the survivors have their convex hull computed and a Blob constructed.
+ *
+ * The labelling works on runs of foreground pixels rather than on single pixels, and the hull is built from the ends of
+ * each region's rows, which are the only pixels that can lie on it. Everything is kept in buffers reused between
+ * frames, where OpenCV's labelling, contour tracing and hulls allocate on every call.
+ */
+
+#include "BlobExtractor.hpp"
+#include "Profiler.hpp"
+
+/**
+ * The same thresholds for frames of another size. Widths scale with the frame width, heights with the frame height and
+ * areas with both, so a vehicle which passes at one resolution passes at every other.
+ * @param frame_size cv::Size   size of the frames the filter will be applied to
+ */
+BlobFilter BlobFilter::scaled_to(const cv::Size &frame_size) const {
+  BlobFilter scaled = *this;
+  if (reference_size.area() <= 0 || frame_size == reference_size) {
+    return scaled;
+  }
+  const double scale_x = frame_size.width / (double) reference_size.width;
+  const double scale_y = frame_size.height / (double) reference_size.height;
+  scaled.min_area = cvRound(min_area * scale_x * scale_y);
+  scaled.max_area = cvRound(max_area * scale_x * scale_y);
+  scaled.min_width = cvRound(min_width * scale_x);
+  scaled.min_height = cvRound(min_height * scale_y);
+  scaled.reference_size = frame_size;
+  return scaled;
+}
+
+/**
+ * Default constructor for BlobExtractor. Uses the default BlobFilter thresholds.
+ */
+BlobExtractor::BlobExtractor()
+    : component_count(0),
+      hull_count(0) {}
+
+/**
+ * Constructor for BlobExtractor
+ * @param filter_ BlobFilter    thresholds a region must pass to become a blob
+ */
+BlobExtractor::BlobExtractor(const BlobFilter &filter_)
+    : filter(filter_),
+      component_count(0),
+      hull_count(0) {}
+
+const BlobFilter &BlobExtractor::get_filter() const {
+  return filter;
+}
+
+void BlobExtractor::set_filter(const BlobFilter &filter_) {
+  filter = filter_;
+}
+
+/**
+ * Number of foreground regions found by the last call to extract()
+ */
+const int &BlobExtractor::get_component_count() const {
+  return component_count;
+}
+
+/**
+ * Number of regions which passed the size filter, and so had a convex hull computed, in the last call to extract()
+ */
+const int &BlobExtractor::get_hull_count() const {
+  return hull_count;
+}
+
+/**
+ * Finds the blobs within a foreground mask which pass the filter
+ * @param foreground cv::Mat    8 bit single channel mask where non-zero pixels are foreground
+ * @param blobs std::vector<Blob>   the blobs which pass the filter are appended to this vector
+ */
+void BlobExtractor::extract(const cv::Mat &foreground, std::vector<Blob> &blobs) {
+  extract(foreground, blobs, cv::Point(0, 0), 1.0);
+}
+
+/**
+ * Finds the blobs within part of a foreground mask which pass the filter
+ * @param foreground cv::Mat    8 bit single channel mask of a rectangle of the frame, such as the bounding box of the
+ * region of interest, where non-zero pixels are foreground
+ * @param blobs std::vector<Blob>   the blobs which pass the filter are appended to this vector, in frame coordinates
+ * @param offset cv::Point  position of the rectangle's top left corner within the mask of the whole frame
+ * @param frame_scale double    size of the frame relative to the mask, when detection runs on a downscaled copy of
+ * the frame. The blobs are mapped back to the frame, so they can be tracked, timed and drawn at native resolution.
+ */
+void BlobExtractor::extract(const cv::Mat &foreground, std::vector<Blob> &blobs, const cv::Point &offset,
+                            double frame_scale) {
+  component_count = 0;
+  hull_count = 0;
+  // An empty road leaves nothing to label
+  if (cv::countNonZero(foreground) == 0) {
+    return;
+  }
+
+  {
+    PROFILE_SCOPE("extract.label");
+    label_runs(foreground);
+  }
+  component_count = (int) regions.size();
+
+  for (int region = 0; region < component_count; region++) {
+    const ForegroundRegion &bounds = regions[region];
+    const cv::Rect bounding_rect(bounds.left, bounds.top, bounds.right - bounds.left + 1, bounds.bottom - bounds.top + 1);
+    if (!passes_size_filter(bounding_rect.width, bounding_rect.height)) {
+      continue;
+    }
+
+    {
+      PROFILE_SCOPE("extract.hull");
+      compute_hull(region, offset);
+    }
+    hull_count++;
+
+    if (cv::contourArea(hull) / (double) bounding_rect.area() <= filter.min_fill) {
+      continue;
+    }
+    if (frame_scale != 1.0) {
+      // Map the centre of each mask pixel to the centre of the frame pixels it covers
+      for (cv::Point &point : hull) {
+        point.x = cvRound((point.x + 0.5) * frame_scale - 0.5);
+        point.y = cvRound((point.y + 0.5) * frame_scale - 0.5);
+      }
+    }
+    blobs.push_back(Blob(hull));
+  }
+}
+
+/**
+ * Splits the mask into runs of foreground pixels and joins each run to the runs of the row above which touch it,
+ * diagonals included, as 8-connected labelling does. The regions are numbered in the order their first pixel appears
+ * scanning down the mask, each run's parent is left as the number of its region, and the regions' bounding boxes are
+ * gathered on the way.
+ * @param foreground cv::Mat    8 bit single channel mask where non-zero pixels are foreground
+ */
+void BlobExtractor::label_runs(const cv::Mat &foreground) {
+  runs.clear();
+  regions.clear();
+
+  int above_begin = 0;
+  int above_end = 0;
+  for (int row = 0; row < foreground.rows; row++) {
+    const uchar *pixels = foreground.ptr<uchar>(row);
+    const int row_begin = (int) runs.size();
+    int above = above_begin;
+    int col = 0;
+    while (col < foreground.cols) {
+      while (col < foreground.cols && pixels[col] == 0) {
+        col++;
+      }
+      if (col == foreground.cols) {
+        break;
+      }
+      ForegroundRun run;
+      run.row = row;
+      run.begin = col;
+      while (col < foreground.cols && pixels[col] != 0) {
+        col++;
+      }
+      run.end = col;
+      const int current = (int) runs.size();
+      run.parent = current;
+      runs.push_back(run);
+
+      // Runs above which end before this one begins cannot touch it, nor any run further along this row
+      while (above < above_end && runs[above].end < run.begin) {
+        above++;
+      }
+      for (int touching = above; touching < above_end && runs[touching].begin <= run.end; touching++) {
+        // The region keeps its earliest run as its root, so regions stay in the order they were first seen
+        const int root = find_root(touching);
+        const int own_root = find_root(current);
+        runs[std::max(root, own_root)].parent = std::min(root, own_root);
+      }
+    }
+    above_begin = row_begin;
+    above_end = (int) runs.size();
+  }
+
+  for (int i = 0; i < (int) runs.size(); i++) {
+    ForegroundRun &run = runs[i];
+    if (run.parent == i) {
+      ForegroundRegion region;
+      region.left = run.begin;
+      region.top = run.row;
+      region.right = run.end - 1;
+      region.bottom = run.row;
+      region.first_run = i;
+      run.parent = (int) regions.size();
+      regions.push_back(region);
+      continue;
+    }
+    // A joined run's parent is an earlier run of its region, which has already been given the region's number
+    run.parent = runs[run.parent].parent;
+    ForegroundRegion &region = regions[run.parent];
+    region.left = std::min(region.left, run.begin);
+    region.right = std::max(region.right, run.end - 1);
+    region.bottom = run.row;
+  }
+}
+
+/**
+ * The earliest run of the region a run belongs to, while labelling. Halves the path on the way up so later lookups
+ * are shorter.
+ * @param run int   index of the run
+ */
+int BlobExtractor::find_root(int run) {
+  while (runs[run].parent != run) {
+    runs[run].parent = runs[runs[run].parent].parent;
+    run = runs[run].parent;
+  }
+  return run;
+}
+
+/**
+ * Computes the convex hull of a labelled region into hull. Only the first and last pixel of each of the region's rows
+ * can be on the hull, and taken row by row they are already in the order the monotone chain algorithm needs.
+ * @param region int    index of the region
+ * @param offset cv::Point  added to every point of the hull
+ */
+void BlobExtractor::compute_hull(int region, const cv::Point &offset) {
+  hull_points.clear();
+  const int bottom = regions[region].bottom;
+  for (int i = regions[region].first_run; i < (int) runs.size() && runs[i].row <= bottom; i++) {
+    const ForegroundRun &run = runs[i];
+    if (run.parent != region) {
+      continue;
+    }
+    const cv::Point first(run.begin + offset.x, run.row + offset.y);
+    const cv::Point last(run.end - 1 + offset.x, run.row + offset.y);
+    if (!hull_points.empty() && hull_points.back().y == first.y) {
+      // Another run of a row already started, which can only extend the row to the right
+      if (hull_points.size() >= 2 && hull_points[hull_points.size() - 2].y == first.y) {
+        hull_points.back() = last;
+      } else {
+        hull_points.push_back(last);
+      }
+    } else {
+      hull_points.push_back(first);
+      if (last != first) {
+        hull_points.push_back(last);
+      }
+    }
+  }
+
+  // Andrew's monotone chain, with rows in place of columns. Points in line with their neighbours are dropped.
+  hull.clear();
+  auto turn = [](const cv::Point &a, const cv::Point &b, const cv::Point &c) {
+    return (long long) (b.x - a.x) * (c.y - a.y) - (long long) (b.y - a.y) * (c.x - a.x);
+  };
+  for (const cv::Point &point : hull_points) {
+    while (hull.size() >= 2 && turn(hull[hull.size() - 2], hull.back(), point) <= 0) {
+      hull.pop_back();
+    }
+    hull.push_back(point);
+  }
+  const size_t lower_size = hull.size() + 1;
+  for (int i = (int) hull_points.size() - 2; i >= 0; i--) {
+    while (hull.size() >= lower_size && turn(hull[hull.size() - 2], hull.back(), hull_points[i]) <= 0) {
+      hull.pop_back();
+    }
+    hull.push_back(hull_points[i]);
+  }
+  if (hull.size() > 1) {
+    hull.pop_back();
+  }
+}
+
+/**
+ * Whether a region with the given bounding box is sized like a vehicle. These ranges are chosen based on trial/error.
+ * @param width int     width of the region's bounding box in pixels
+ * @param height int    height of the region's bounding box in pixels
+ */
+bool BlobExtractor::passes_size_filter(int width, int height) const {
+  const int area = width * height;
+  return area > filter.min_area &&
+      area < filter.max_area &&
+      width > filter.min_width &&
+      height > filter.min_height;
+}
@@ -0,0 +1,297 @@
+/**
+ * ClipRecorder.cpp
+ *
+ * Records a short clip around each timed vehicle instead of the whole stream. Every frame passes through a
+ * FrameRingBuffer. Once a vehicle has been timed and post_roll seconds more have been captured, the frames from
+ * pre_roll seconds before it entered the calibration region onwards are taken from the buffer and encoded into a clip
+ * of their own on a background thread. On a quiet road almost nothing is written.
+ *
+ * The encoding stage only copies each frame into a recycled buffer. The frames are compressed into the ring buffer on a
+ * thread of its own, so the per-frame JPEG encode neither delays the pipeline nor counts towards the processing time
+ * the quality controller measures.
+ */
+
+#include "ClipRecorder.hpp"
+
+/**
+ * Default constructor for ClipRecorder. Writes H.264 clips of every vehicle into data/clips/, from 3 seconds before it
+ * entered the calibration region until 2 seconds after it left.
+ */
+ClipRecorder::ClipRecorder()
+    : directory("data/clips/"),
+      pre_roll(3.0),
+      post_roll(2.0),
+      min_speed(0.0),
+      fps(30.0),
+      fourcc(CV_FOURCC('H', '2', '6', '4')),
+      extension(".h264"),
+      written(0),
+      dropped(0),
+      failed(0) {}
+
+ClipRecorder::~ClipRecorder() {
+  close();
+}
+
+const std::string &ClipRecorder::get_directory() const {
+  return directory;
+}
+
+/**
+ * Sets where clips are written. Each is named after its vehicle, e.g. 12.h264.
+ * @param directory_ std::string    path of an existing directory, including the trailing separator
+ */
+void ClipRecorder::set_directory(const std::string &directory_) {
+  directory = directory_;
+}
+
+const double &ClipRecorder::get_pre_roll() const {
+  return pre_roll;
+}
+
+/**
+ * Sets how long before a vehicle entered the calibration region its clip starts. The buffer's duration must cover the
+ * pre-roll, the time spent crossing the region and the post-roll.
+ * @param pre_roll_ double  seconds
+ */
+void ClipRecorder::set_pre_roll(const double pre_roll_) {
+  pre_roll = pre_roll_;
+}
+
+const double &ClipRecorder::get_post_roll() const {
+  return post_roll;
+}
+
+/**
+ * Sets how long after a vehicle left the calibration region its clip ends
+ * @param post_roll_ double     seconds
+ */
+void ClipRecorder::set_post_roll(const double post_roll_) {
+  post_roll = post_roll_;
+}
+
+const double &ClipRecorder::get_min_speed() const {
+  return min_speed;
+}
+
+/**
+ * Only records vehicles timed at or above a speed, e.g. the speed limit
+ * @param min_speed_ double     kilometers per hour. 0 records every vehicle.
+ */
+void ClipRecorder::set_min_speed(const double min_speed_) {
+  min_speed = min_speed_;
+}
+
+const double &ClipRecorder::get_fps() const {
+  return fps;
+}
+
+/**
+ * Sets the frame rate the clips are played back at
+ * @param fps_ double   frames per second
+ */
+void ClipRecorder::set_fps(const double fps_) {
+  fps = fps_;
+}
+
+const int &ClipRecorder::get_fourcc() const {
+  return fourcc;
+}
+
+/**
+ * Sets the codec clips are encoded with
+ * @param fourcc_ int   codec code, as made by CV_FOURCC
+ * @param extension_ std::string    file extension matching the codec, including the dot
+ */
+void ClipRecorder::set_fourcc(const int fourcc_, const std::string &extension_) {
+  fourcc = fourcc_;
+  extension = extension_;
+}
+
+/**
+ * The buffer the clips are cut from. Exposed so its duration, memory limit and compression can be configured while the
+ * recorder is closed.
+ */
+FrameRingBuffer &ClipRecorder::get_buffer() {
+  return buffer;
+}
+
+/**
+ * Empties the buffer and starts the buffering and clip writer threads
+ */
+void ClipRecorder::open() {
+  close();
+
+  written = 0;
+  dropped = 0;
+  failed = 0;
+  buffer.clear();
+  queue.reset(new BoundedQueue<ClipJob>(4));
+  writer = std::thread(&ClipRecorder::write_loop, this);
+  incoming.reset(new BoundedQueue<BufferedFrame>(4));
+  buffering = std::thread(&ClipRecorder::buffer_loop, this);
+}
+
+/**
+ * Asks for a clip of a vehicle which has just been timed. Safe to call from any thread while the recorder is open.
+ * @param event SpeedEvent  the vehicle, with the frames it entered and left the calibration region in
+ * @return false if the recorder is not open or the vehicle was slower than the minimum speed
+ */
+bool ClipRecorder::request(const SpeedEvent &event) {
+  if (!queue || event.speed < min_speed) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(pending_mutex);
+  pending.push_back(event);
+  return true;
+}
+
+/**
+ * Hands a copy of the next frame of the stream to the buffering thread. The copy goes into a buffer the thread has
+ * finished with, so no memory is allocated once as many frames as the hand-off holds have passed. Waits only when the
+ * buffering thread has fallen that many frames behind, rather than leave a gap in the clips.
+ * @param frame cv::Mat     the frame as it is recorded. May be changed as soon as this returns.
+ * @param frame_count unsigned int  index of the frame within the stream
+ * @param timestamp double  capture time of the frame in seconds
+ */
+void ClipRecorder::push(const cv::Mat &frame, unsigned int frame_count, double timestamp) {
+  if (!incoming) {
+    return;
+  }
+  staged.frame_count = frame_count;
+  staged.timestamp = timestamp;
+  frame.copyTo(staged.raw);
+  incoming->push_swap(staged);
+}
+
+/**
+ * Buffers every frame already pushed, cuts the clips of any vehicles still waiting from what has been buffered, writes
+ * every clip and stops both threads
+ */
+void ClipRecorder::close() {
+  if (!queue) {
+    return;
+  }
+  incoming->close();
+  buffering.join();
+  incoming.reset();
+  staged = BufferedFrame();
+
+  dispatch(true);
+  queue->close();
+  writer.join();
+  queue.reset();
+  buffer.clear();
+}
+
+bool ClipRecorder::is_open() const {
+  return queue != nullptr;
+}
+
+/**
+ * Number of clips written since the recorder was opened
+ */
+unsigned long long ClipRecorder::get_written() const {
+  return written;
+}
+
+/**
+ * Number of clips dropped since the recorder was opened because the writer had fallen behind
+ */
+unsigned long long ClipRecorder::get_dropped() const {
+  return dropped;
+}
+
+/**
+ * Number of clips which could not be cut or written since the recorder was opened, e.g. because their frames had
+ * already left the buffer
+ */
+unsigned long long ClipRecorder::get_failed() const {
+  return failed;
+}
+
+/**
+ * Cuts the clips whose post-roll has been captured and queues them for the writer without waiting
+ * @param flush bool    cut every waiting clip from whatever has been buffered
+ */
+void ClipRecorder::dispatch(bool flush) {
+  std::lock_guard<std::mutex> lock(pending_mutex);
+  if (pending.empty() || buffer.empty()) {
+    return;
+  }
+
+  auto waiting = pending.begin();
+  for (const SpeedEvent &event : pending) {
+    double end_time;
+    if (!buffer.find(event.end_frame, end_time)) {
+      if (!flush && buffer.newest().frame_count < event.end_frame) {
+        // Requested ahead of the frame reaching this stage
+        *waiting++ = event;
+      } else {
+        failed++;
+      }
+      continue;
+    }
+    if (!flush && buffer.newest().timestamp < end_time + post_roll) {
+      *waiting++ = event;
+      continue;
+    }
+
+    double start_time;
+    if (!buffer.find(event.start_frame, start_time)) {
+      start_time = buffer.oldest().timestamp;
+    }
+    job.vehicle_id = event.vehicle_id;
+    buffer.collect(start_time - pre_roll, end_time + post_roll, job.frames);
+    if (!queue->try_push(job)) {
+      dropped++;
+    }
+  }
+  pending.erase(waiting, pending.end());
+}
+
+/**
+ * Body of the buffering thread. Compresses each frame into the ring buffer and hands any clip whose post-roll it
+ * completes to the writer, until the hand-off is closed and drained. The popped frame's buffer goes back to the
+ * encoding stage with the next pop.
+ */
+void ClipRecorder::buffer_loop() {
+  BufferedFrame frame;
+  while (incoming->pop(frame)) {
+    buffer.push(frame.raw, frame.frame_count, frame.timestamp);
+    dispatch(false);
+  }
+}
+
+/**
+ * Body of the clip writer thread. Decodes the frames of each clip and encodes them into its file, until the queue is
+ * closed and drained.
+ */
+void ClipRecorder::write_loop() {
+  ClipJob clip;
+  cv::Mat frame;
+  while (queue->pop(clip)) {
+    cv::VideoWriter clip_video;
+    for (const BufferedFrame &buffered : clip.frames) {
+      if (!buffered.decode(frame)) {
+        continue;
+      }
+      if (!clip_video.isOpened()) {
+        clip_video.open(directory + std::to_string(clip.vehicle_id) + extension, fourcc, fps, frame.size());
+        if (!clip_video.isOpened()) {
+          break;
+        }
+      }
+      clip_video.write(frame);
+    }
+
+    if (clip_video.isOpened()) {
+      clip_video.release();
+      written++;
+    } else {
+      failed++;
+    }
+    // Release the shared frames now rather than when the next clip arrives
+    clip.frames.clear();
+  }
+}
@@ -0,0 +1,306 @@
+/**
+ * FrameCache.cpp
+ *
+ * A frame cache holds the decoded frames of a video, uncompressed, in a single file. Decoding a video costs more than
+ * much of the processing being measured and varies from run to run, so benchmarks replay a cache instead: the video is
+ * decoded once by build_frame_cache, and MappedFrameSource then maps the file and hands out its frames as views of the
+ * mapping. Once the cache is in the page cache every replay reads identical frames at memory speed.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FrameCache.hpp"
+#include "Luminance.hpp"
+
+namespace {
+const char MAGIC[8] = {'T', 'M', 'F', 'R', 'A', 'M', 'E', 'S'};
+const uint32_t VERSION = 1;
+// Records are aligned to 16 KiB, a multiple of the page size on x86 and on 4 KiB and 16 KiB page ARM kernels
+const uint64_t ALIGNMENT = 16384;
+
+uint64_t align(uint64_t size) {
+  return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+int channels_of(RawPixelFormat format) {
+  switch (format) {
+    case RawPixelFormat::GRAY:
+      return 1;
+    case RawPixelFormat::YUYV:
+      return 2;
+    default:
+      return 3;
+  }
+}
+}
+
+const uint64_t FrameCacheWriter::PIXEL_OFFSET;
+
+FrameCacheWriter::FrameCacheWriter()
+    : fd(-1),
+      header() {}
+
+FrameCacheWriter::~FrameCacheWriter() {
+  close();
+}
+
+/**
+ * Creates the cache file, replacing any existing file, and writes a header for an empty cache
+ * @param path std::string  path of the cache, by convention ending in .frames
+ * @param frame_size cv::Size   size of every frame
+ * @param format RawPixelFormat     pixel layout of every frame
+ * @param fps double    nominal frame rate of the stream
+ * @return false if the file could not be created
+ */
+bool FrameCacheWriter::open(const std::string &path, const cv::Size &frame_size, RawPixelFormat format, double fps) {
+  close();
+  if (frame_size.area() <= 0) {
+    return false;
+  }
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  header = FrameCacheHeader();
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.width = (uint32_t) frame_size.width;
+  header.height = (uint32_t) frame_size.height;
+  header.format = static_cast<uint32_t>(format);
+  header.frame_count = 0;
+  header.frame_bytes = (uint64_t) frame_size.area() * channels_of(format);
+  header.frame_stride = align(PIXEL_OFFSET + header.frame_bytes);
+  header.data_offset = align(sizeof(FrameCacheHeader));
+  header.fps = fps;
+
+  record.assign(header.frame_stride, '\0');
+  std::string preamble(header.data_offset, '\0');
+  std::memcpy(&preamble[0], &header, sizeof(header));
+  if (!write_fully(preamble.data(), preamble.size())) {
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Appends a frame
+ * @param frame cv::Mat     the frame, of the size and pixel layout the cache was opened with
+ * @param timestamp double  when the frame was captured, in seconds
+ * @return false if the frame does not match the cache or could not be written
+ */
+bool FrameCacheWriter::write(const cv::Mat &frame, double timestamp) {
+  if (fd < 0 || frame.cols != (int) header.width || frame.rows != (int) header.height ||
+      frame.type() != CV_MAKETYPE(CV_8U, channels_of(static_cast<RawPixelFormat>(header.format)))) {
+    return false;
+  }
+  std::memcpy(&record[0], &timestamp, sizeof(timestamp));
+  const size_t row_bytes = frame.cols * frame.elemSize();
+  for (int row = 0; row < frame.rows; row++) {
+    std::memcpy(&record[PIXEL_OFFSET + row * row_bytes], frame.ptr(row), row_bytes);
+  }
+  if (!write_fully(record.data(), record.size())) {
+    return false;
+  }
+  header.frame_count++;
+  return true;
+}
+
+/**
+ * Records the number of frames in the header and closes the file
+ * @return false if the header could not be written
+ */
+bool FrameCacheWriter::close() {
+  if (fd < 0) {
+    return true;
+  }
+  const bool written = ::pwrite(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header);
+  ::close(fd);
+  fd = -1;
+  return written;
+}
+
+bool FrameCacheWriter::is_open() const {
+  return fd >= 0;
+}
+
+/**
+ * Number of frames written since the cache was opened
+ */
+const uint32_t &FrameCacheWriter::get_frame_count() const {
+  return header.frame_count;
+}
+
+bool FrameCacheWriter::write_fully(const void *data, size_t size) {
+  const char *cursor = static_cast<const char *>(data);
+  while (size > 0) {
+    const ssize_t count = ::write(fd, cursor, size);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    cursor += count;
+    size -= (size_t) count;
+  }
+  return true;
+}
+
+/**
+ * The mapped cache. Shared with every frame handed out, so that the file stays mapped while frames are in use.
+ */
+struct MappedFrameSource::Mapping {
+  unsigned char *start = nullptr;
+  size_t length = 0;
+  // Whether records start on page boundaries, so that the pages of a frame can be released on their own
+  bool page_aligned = false;
+
+  ~Mapping() {
+    if (start != nullptr) {
+      ::munmap(start, length);
+    }
+  }
+};
+
+/**
+ * Constructor for MappedFrameSource
+ * @param path_ std::string     path of a cache written by FrameCacheWriter
+ */
+MappedFrameSource::MappedFrameSource(const std::string &path_)
+    : path(path_),
+      header(),
+      next_frame(0) {}
+
+MappedFrameSource::~MappedFrameSource() {
+  close();
+}
+
+const std::string &MappedFrameSource::get_path() const {
+  return path;
+}
+
+/**
+ * Maps the cache and checks its header. The frame rate of the cache replaces the configured one.
+ * @return false if the file cannot be mapped or is not a complete frame cache
+ */
+bool MappedFrameSource::open() {
+  close();
+  restart_stream();
+  next_frame = 0;
+
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (::fstat(fd, &status) < 0 || (size_t) status.st_size < sizeof(FrameCacheHeader)) {
+    ::close(fd);
+    return false;
+  }
+
+  // Privately mapped, so that overlays drawn onto a BGR frame only change the process's copy of its pages
+  std::shared_ptr<Mapping> mapped = std::make_shared<Mapping>();
+  mapped->length = (size_t) status.st_size;
+  void *start = ::mmap(nullptr, mapped->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (start == MAP_FAILED) {
+    return false;
+  }
+  mapped->start = static_cast<unsigned char *>(start);
+
+  std::memcpy(&header, mapped->start, sizeof(header));
+  const uint64_t frame_bytes = (uint64_t) header.width * header.height *
+      channels_of(static_cast<RawPixelFormat>(header.format));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+      header.format > static_cast<uint32_t>(RawPixelFormat::BGR) || header.frame_bytes != frame_bytes ||
+      header.frame_stride < FrameCacheWriter::PIXEL_OFFSET + frame_bytes ||
+      header.data_offset + (uint64_t) header.frame_count * header.frame_stride > mapped->length) {
+    header = FrameCacheHeader();
+    return false;
+  }
+
+  const long page_size = ::sysconf(_SC_PAGESIZE);
+  mapped->page_aligned = page_size > 0 && header.data_offset % page_size == 0 && header.frame_stride % page_size == 0;
+  ::madvise(mapped->start, mapped->length, MADV_SEQUENTIAL);
+
+  if (header.fps > 0.0) {
+    fps = header.fps;
+  }
+  mapping = mapped;
+  return true;
+}
+
+/**
+ * Hands out the next frame as a view of the mapping, leased until every copy of the frame has been dropped. When the
+ * lease is dropped, any pages of the frame which were drawn on are discarded. Grayscale and YUYV frames are converted to
+ * BGR unless raw frames were requested.
+ */
+bool MappedFrameSource::read(SourceFrame &frame) {
+  if (!mapping || next_frame >= header.frame_count) {
+    return false;
+  }
+  unsigned char *record = mapping->start + header.data_offset + (uint64_t) next_frame * header.frame_stride;
+  double timestamp;
+  std::memcpy(&timestamp, record, sizeof(timestamp));
+
+  // The frame's previous image may be a view of the mapping. Views do not own their data, and are never written to.
+  frame.lease.reset();
+  if (frame.image.data != nullptr && frame.image.u == nullptr) {
+    frame.image = cv::Mat();
+  }
+
+  const RawPixelFormat format = static_cast<RawPixelFormat>(header.format);
+  cv::Mat view((int) header.height, (int) header.width, CV_MAKETYPE(CV_8U, channels_of(format)),
+               record + FrameCacheWriter::PIXEL_OFFSET);
+  if (format == RawPixelFormat::BGR || is_raw()) {
+    std::shared_ptr<Mapping> owner = mapping;
+    const size_t stride = (size_t) header.frame_stride;
+    frame.image = view;
+    frame.lease = std::shared_ptr<void>(record, [owner, stride](void *start) {
+      if (owner->page_aligned) {
+        ::madvise(start, stride, MADV_DONTNEED);
+      }
+    });
+  } else {
+    convert_to_bgr(view, frame.image);
+  }
+
+  next_frame++;
+  stamp(frame, timestamp);
+  return true;
+}
+
+void MappedFrameSource::close() {
+  mapping.reset();
+}
+
+bool MappedFrameSource::is_open() const {
+  return mapping != nullptr;
+}
+
+cv::Size MappedFrameSource::get_frame_size() const {
+  return cv::Size((int) header.width, (int) header.height);
+}
+
+bool MappedFrameSource::is_raw() const {
+  return raw_requested && static_cast<RawPixelFormat>(header.format) != RawPixelFormat::BGR;
+}
+
+/**
+ * Number of frames in the cache. Only valid once it has been opened.
+ */
+unsigned int MappedFrameSource::get_frame_count() const {
+  return header.frame_count;
+}
+
+RawPixelFormat MappedFrameSource::get_format() const {
+  return static_cast<RawPixelFormat>(header.format);
+}
@@ -0,0 +1,78 @@
+/**
+ * FramePool.cpp
+ *
+ * Preallocates every buffer a frame needs on its way through the pipeline so the steady state loop does not allocate.
+ */
+
+#include "FramePool.hpp"
+
+/**
+ * Constructor for FramePool
+ * @param size_ number of packets to allocate. Must cover every packet which can be in flight at once, i.e. the capacity
+ * of every queue between the stages plus one packet held by each stage.
+ * @param frame_size cv::Size   dimensions of the captured frames
+ * @param frame_type int    OpenCV type of the captured frames, e.g. CV_8UC3
+ * @param max_blobs size_t  number of blobs to reserve space for within each packet
+ */
+FramePool::FramePool(size_t size_, cv::Size frame_size, int frame_type, size_t max_blobs)
+    : FramePool(size_, frame_size, frame_type, max_blobs, frame_size) {}
+
+/**
+ * Constructor for FramePool when detection runs on a downscaled copy of each frame
+ * @param size_ number of packets to allocate
+ * @param frame_size cv::Size   dimensions of the captured frames
+ * @param frame_type int    OpenCV type of the captured frames, e.g. CV_8UC3
+ * @param max_blobs size_t  number of blobs to reserve space for within each packet
+ * @param working_size cv::Size     dimensions of the frames detection runs on. The foreground masks have this size.
+ */
+FramePool::FramePool(size_t size_, cv::Size frame_size, int frame_type, size_t max_blobs, cv::Size working_size)
+    : packets(size_),
+      free_packets(size_) {
+  for (FramePacket &packet : packets) {
+    packet.frame.create(frame_size, frame_type);
+    if (working_size != frame_size) {
+      packet.working_frame.create(working_size, frame_type);
+    }
+    packet.foreground.create(working_size, CV_8UC1);
+    packet.blobs.reserve(max_blobs);
+    free_packets.push(&packet);
+  }
+}
+
+/**
+ * Takes a packet from the pool, waiting for one to be released if they are all in use
+ * @return the packet, or nullptr if the pool has been closed
+ */
+FramePacket *FramePool::acquire() {
+  FramePacket *packet = nullptr;
+  if (!free_packets.pop(packet)) {
+    return nullptr;
+  }
+  return packet;
+}
+
+/**
+ * Returns a packet to the pool once every stage is done with it. The packet's buffers are kept for the next frame, and
+ * any buffer leased from the frame source is handed back.
+ * @param packet FramePacket    a packet previously returned by acquire()
+ */
+void FramePool::release(FramePacket *packet) {
+  packet->blobs.clear();
+  packet->lease.reset();
+  free_packets.push(packet);
+}
+
+/**
+ * Wakes any thread waiting in acquire(). Packets which are still free can continue to be acquired.
+ */
+void FramePool::close() {
+  free_packets.close();
+}
+
+size_t FramePool::get_size() const {
+  return packets.size();
+}
+
+size_t FramePool::get_available() const {
+  return free_packets.size();
+}
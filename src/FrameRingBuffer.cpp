@@ -0,0 +1,167 @@
+/**
+ * FrameRingBuffer.cpp
+ *
+ * Keeps the last few seconds of frames in memory so that a clip of a vehicle can be cut after it has been timed,
+ * including the frames before it entered the calibration region. Frames are JPEG compressed as they arrive unless the
+ * quality is set to 0. The oldest frames are dropped once the buffer spans more than its duration or holds more than
+ * its memory limit.
+ */
+
+#include <algorithm>
+
+#include "FrameRingBuffer.hpp"
+
+/**
+ * Memory taken by the pixels of a buffered frame
+ */
+size_t BufferedFrame::bytes() const {
+  return jpeg ? jpeg->size() : raw.total() * raw.elemSize();
+}
+
+/**
+ * Recovers the pixels of a buffered frame
+ * @param frame cv::Mat     receives the frame. Shares the buffered pixels when they are held raw.
+ * @return false if the frame could not be decoded
+ */
+bool BufferedFrame::decode(cv::Mat &frame) const {
+  if (jpeg) {
+    frame = cv::imdecode(*jpeg, cv::IMREAD_COLOR);
+  } else {
+    frame = raw;
+  }
+  return !frame.empty();
+}
+
+/**
+ * Default constructor for FrameRingBuffer. Holds 10 seconds of frames at JPEG quality 80, within 64 MB.
+ */
+FrameRingBuffer::FrameRingBuffer()
+    : duration(10.0),
+      memory_limit(64 * 1024 * 1024),
+      jpeg_quality(80),
+      bytes(0) {}
+
+const double &FrameRingBuffer::get_duration() const {
+  return duration;
+}
+
+/**
+ * Sets how far back the buffer reaches
+ * @param duration_ double  seconds between the oldest and newest buffered frames
+ */
+void FrameRingBuffer::set_duration(const double duration_) {
+  duration = duration_;
+}
+
+const size_t &FrameRingBuffer::get_memory_limit() const {
+  return memory_limit;
+}
+
+/**
+ * Sets the most memory the buffered frames may take. The buffer is cut short of its duration to stay within it.
+ * @param memory_limit_ size_t  bytes
+ */
+void FrameRingBuffer::set_memory_limit(const size_t memory_limit_) {
+  memory_limit = memory_limit_;
+}
+
+const int &FrameRingBuffer::get_jpeg_quality() const {
+  return jpeg_quality;
+}
+
+/**
+ * Sets how frames are held. Compressing costs an encode per frame on the thread which pushes them, but fits around ten
+ * times as many frames into the memory limit.
+ * @param jpeg_quality_ int     JPEG quality within [1, 100], or 0 to hold frames raw
+ */
+void FrameRingBuffer::set_jpeg_quality(const int jpeg_quality_) {
+  jpeg_quality = std::min(100, std::max(0, jpeg_quality_));
+}
+
+/**
+ * Adds the newest frame and drops the oldest frames which no longer fit
+ * @param frame cv::Mat     the frame, which is copied or compressed
+ * @param frame_count unsigned int  index of the frame within the stream
+ * @param timestamp double  capture time of the frame in seconds
+ */
+void FrameRingBuffer::push(const cv::Mat &frame, unsigned int frame_count, double timestamp) {
+  BufferedFrame buffered;
+  buffered.frame_count = frame_count;
+  buffered.timestamp = timestamp;
+  if (jpeg_quality > 0) {
+    std::shared_ptr<std::vector<unsigned char>> encoded = std::make_shared<std::vector<unsigned char>>();
+    cv::imencode(".jpg", frame, *encoded, {cv::IMWRITE_JPEG_QUALITY, jpeg_quality});
+    buffered.jpeg = encoded;
+  } else {
+    buffered.raw = frame.clone();
+  }
+  bytes += buffered.bytes();
+  frames.push_back(buffered);
+
+  // The newest frame is always kept
+  while (frames.size() > 1 && (timestamp - frames.front().timestamp > duration || bytes > memory_limit)) {
+    bytes -= frames.front().bytes();
+    frames.pop_front();
+  }
+}
+
+/**
+ * Looks up when a buffered frame was captured
+ * @param frame_count unsigned int  index of the frame within the stream
+ * @param timestamp double  receives its capture time
+ * @return false if the frame is not buffered
+ */
+bool FrameRingBuffer::find(unsigned int frame_count, double &timestamp) const {
+  auto found = std::lower_bound(frames.begin(), frames.end(), frame_count,
+                                [](const BufferedFrame &buffered, unsigned int count) {
+                                  return buffered.frame_count < count;
+                                });
+  if (found == frames.end() || found->frame_count != frame_count) {
+    return false;
+  }
+  timestamp = found->timestamp;
+  return true;
+}
+
+/**
+ * Shares every buffered frame captured within a time range
+ * @param from double   earliest capture time, in seconds
+ * @param to double     latest capture time, in seconds
+ * @param collected std::vector<BufferedFrame>  receives the frames, oldest first
+ */
+void FrameRingBuffer::collect(double from, double to, std::vector<BufferedFrame> &collected) const {
+  collected.clear();
+  for (const BufferedFrame &buffered : frames) {
+    if (buffered.timestamp >= from && buffered.timestamp <= to) {
+      collected.push_back(buffered);
+    }
+  }
+}
+
+void FrameRingBuffer::clear() {
+  frames.clear();
+  bytes = 0;
+}
+
+bool FrameRingBuffer::empty() const {
+  return frames.empty();
+}
+
+size_t FrameRingBuffer::size() const {
+  return frames.size();
+}
+
+/**
+ * Memory taken by the buffered frames
+ */
+const size_t &FrameRingBuffer::get_bytes() const {
+  return bytes;
+}
+
+const BufferedFrame &FrameRingBuffer::oldest() const {
+  return frames.front();
+}
+
+const BufferedFrame &FrameRingBuffer::newest() const {
+  return frames.back();
+}
@@ -0,0 +1,536 @@
+/**
+ * FrameSource.cpp
+ *
+ * Where frames come from. Each source numbers its frames and gives them increasing timestamps, so the pipeline no longer
+ * cares whether it watches a camera, replays a recording, or runs through a directory of images or a dump of raw
+ * frames. PrefetchingFrameSource wraps any of them with a thread which decodes ahead into a bounded queue, so that
+ * decoding overlaps processing instead of stalling the capture stage on every frame.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "FrameCache.hpp"
+#include "FrameSource.hpp"
+#include "Luminance.hpp"
+#include "Profiler.hpp"
+#include "V4l2FrameSource.hpp"
+
+/**
+ * Default constructor for FrameSource. Expects 30 frames per second of 640x480 in BGR.
+ */
+FrameSource::FrameSource()
+    : fps(30.0),
+      requested_size(640, 480),
+      raw_requested(false),
+      frames_read(0),
+      last_timestamp(-1.0) {}
+
+FrameSource::~FrameSource() = default;
+
+const double &FrameSource::get_fps() const {
+  return fps;
+}
+
+/**
+ * Sets the frame rate asked of a camera, and used to time the frames of sources which carry no timestamps
+ * @param fps_ double   frames per second, above 0
+ */
+void FrameSource::set_fps(const double fps_) {
+  if (fps_ > 0.0) {
+    fps = fps_;
+  }
+}
+
+const cv::Size &FrameSource::get_requested_size() const {
+  return requested_size;
+}
+
+/**
+ * Sets the frame size asked of a camera. Other sources deliver frames at the size they were recorded at.
+ * @param requested_size_ cv::Size  takes effect the next time the source is opened
+ */
+void FrameSource::set_requested_size(const cv::Size &requested_size_) {
+  requested_size = requested_size_;
+}
+
+const bool &FrameSource::get_raw_requested() const {
+  return raw_requested;
+}
+
+/**
+ * Sets whether frames may be delivered in the camera's own grayscale or YUYV layout, saving the conversion to BGR. See
+ * is_raw() for whether they are.
+ * @param raw_requested_ bool   takes effect the next time the source is opened
+ */
+void FrameSource::set_raw_requested(const bool raw_requested_) {
+  raw_requested = raw_requested_;
+}
+
+bool FrameSource::is_raw() const {
+  return false;
+}
+
+bool FrameSource::is_live() const {
+  return false;
+}
+
+unsigned long long FrameSource::get_dropped_frames() const {
+  return 0;
+}
+
+/**
+ * Creates the source for a path given on the command line. An empty path opens the first camera through OpenCV, and
+ * /dev/videoN captures from camera N by V4L2 streaming I/O. A path ending in .frames is replayed as a frame cache, and
+ * one containing a printf style number, e.g. frames/%06d.png, is read as an image sequence. Anything else is read as a
+ * video file.
+ * @param path std::string  where to read frames from
+ */
+cv::Ptr<FrameSource> FrameSource::create(const std::string &path) {
+  const std::string device_prefix = "/dev/video";
+  if (path.empty()) {
+    return cv::makePtr<CameraFrameSource>(0);
+  }
+  if (path.compare(0, device_prefix.size(), device_prefix) == 0 && path.size() > device_prefix.size()) {
+    return cv::makePtr<V4l2FrameSource>(path);
+  }
+  const std::string cache_suffix = ".frames";
+  if (path.size() > cache_suffix.size() &&
+      path.compare(path.size() - cache_suffix.size(), cache_suffix.size(), cache_suffix) == 0) {
+    return cv::makePtr<MappedFrameSource>(path);
+  }
+  if (path.find('%') != std::string::npos) {
+    return cv::makePtr<ImageSequenceFrameSource>(path);
+  }
+  return cv::makePtr<VideoFileFrameSource>(path);
+}
+
+/**
+ * Looks up a raw pixel format by the name used on the command line: gray, yuyv or bgr
+ * @param name std::string  the name
+ * @param format RawPixelFormat     receives the format
+ * @return false if the name is not recognised
+ */
+bool FrameSource::parse_raw_format(const std::string &name, RawPixelFormat &format) {
+  if (name == "gray") {
+    format = RawPixelFormat::GRAY;
+  } else if (name == "yuyv") {
+    format = RawPixelFormat::YUYV;
+  } else if (name == "bgr") {
+    format = RawPixelFormat::BGR;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Numbers the frames from 0 again. Called by open().
+ */
+void FrameSource::restart_stream() {
+  frames_read = 0;
+  last_timestamp = -1.0;
+}
+
+/**
+ * Gives a frame which has just been read its index and timestamp. Where the source gives no timestamp, or one which does
+ * not advance, the previous timestamp is advanced by the time since the previous read for a live source, or by the
+ * nominal frame interval otherwise.
+ * @param frame SourceFrame     the frame
+ * @param reported_timestamp double     the timestamp the source gave, in seconds, or a negative value if it gave none
+ */
+void FrameSource::stamp(SourceFrame &frame, double reported_timestamp) {
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double timestamp = reported_timestamp;
+  if (last_timestamp < 0.0) {
+    timestamp = std::max(0.0, timestamp);
+  } else if (timestamp <= last_timestamp) {
+    const double elapsed = is_live() ? std::chrono::duration<double>(now - last_read_time).count() : 1.0 / fps;
+    timestamp = last_timestamp + elapsed;
+  }
+  last_timestamp = timestamp;
+  last_read_time = now;
+  frame.index = frames_read++;
+  frame.timestamp = timestamp;
+}
+
+/**
+ * Decodes the next frame into the buffer of the frame, which is reused when its size and type already match. Files
+ * report the presentation time of the frame, and cameras the time the driver captured it.
+ */
+bool VideoCaptureFrameSource::read(SourceFrame &frame) {
+  if (!capture.isOpened() || !capture.read(frame.image) || frame.image.empty()) {
+    return false;
+  }
+  stamp(frame, capture.get(CV_CAP_PROP_POS_MSEC) / 1000.0);
+  return true;
+}
+
+void VideoCaptureFrameSource::close() {
+  capture.release();
+}
+
+bool VideoCaptureFrameSource::is_open() const {
+  return capture.isOpened();
+}
+
+cv::Size VideoCaptureFrameSource::get_frame_size() const {
+  return frame_size;
+}
+
+/**
+ * Default constructor for CameraFrameSource. Opens the first camera.
+ */
+CameraFrameSource::CameraFrameSource()
+    : device(0),
+      raw(false) {}
+
+/**
+ * Constructor for CameraFrameSource
+ * @param device_ int   index of the camera, N for /dev/videoN
+ */
+CameraFrameSource::CameraFrameSource(int device_)
+    : device(device_),
+      raw(false) {}
+
+const int &CameraFrameSource::get_device() const {
+  return device;
+}
+
+void CameraFrameSource::set_device(const int device_) {
+  device = device_;
+}
+
+/**
+ * Opens the camera through V4L2 where OpenCV supports it, and asks it for the requested frame rate and size. The size
+ * reported is the one the camera settled on, which may differ from the size requested.
+ */
+bool CameraFrameSource::open() {
+  close();
+  restart_stream();
+  raw = false;
+  if (!capture.open(device + cv::CAP_V4L2) && !capture.open(device)) {
+    return false;
+  }
+
+  capture.set(CV_CAP_PROP_FPS, fps);
+  capture.set(CV_CAP_PROP_FRAME_WIDTH, requested_size.width);
+  capture.set(CV_CAP_PROP_FRAME_HEIGHT, requested_size.height);
+
+  frame_size = cv::Size((int) capture.get(CV_CAP_PROP_FRAME_WIDTH), (int) capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+  if (frame_size.area() <= 0) {
+    frame_size = requested_size;
+  }
+  raw = raw_requested && negotiate_raw_capture();
+  return true;
+}
+
+bool CameraFrameSource::is_raw() const {
+  return raw;
+}
+
+bool CameraFrameSource::is_live() const {
+  return true;
+}
+
+/**
+ * Asks the camera for frames in its own layout rather than converted to BGR, and checks that what arrives is grayscale
+ * or YUYV of the expected size. Otherwise, e.g. for a camera which only delivers MJPEG, conversion is turned back on.
+ * One frame is consumed by the check.
+ * @return whether frames can be captured without conversion
+ */
+bool CameraFrameSource::negotiate_raw_capture() {
+  if (!capture.set(CV_CAP_PROP_CONVERT_RGB, 0)) {
+    return false;
+  }
+  cv::Mat probe;
+  const bool usable = capture.read(probe) && probe.size() == frame_size &&
+      (probe.type() == CV_8UC1 || probe.type() == CV_8UC2);
+  if (!usable) {
+    capture.set(CV_CAP_PROP_CONVERT_RGB, 1);
+  }
+  return usable;
+}
+
+/**
+ * Constructor for VideoFileFrameSource
+ * @param path_ std::string     path of the video file
+ */
+VideoFileFrameSource::VideoFileFrameSource(const std::string &path_)
+    : path(path_) {}
+
+const std::string &VideoFileFrameSource::get_path() const {
+  return path;
+}
+
+/**
+ * Opens the file. The frame rate recorded in the file, where there is one, replaces the configured one.
+ */
+bool VideoFileFrameSource::open() {
+  close();
+  restart_stream();
+  if (!capture.open(path)) {
+    return false;
+  }
+  frame_size = cv::Size((int) capture.get(CV_CAP_PROP_FRAME_WIDTH), (int) capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+  set_fps(capture.get(CV_CAP_PROP_FPS));
+  return true;
+}
+
+/**
+ * Constructor for ImageSequenceFrameSource
+ * @param pattern_ std::string  printf style path of the images, e.g. frames/%06d.png. Numbering starts at 0 or 1 and
+ * the sequence ends at the first missing number.
+ */
+ImageSequenceFrameSource::ImageSequenceFrameSource(const std::string &pattern_)
+    : pattern(pattern_),
+      first_number(0),
+      next_number(0),
+      opened(false) {}
+
+const std::string &ImageSequenceFrameSource::get_pattern() const {
+  return pattern;
+}
+
+/**
+ * Finds the first image of the sequence and decodes it to learn the frame size
+ * @return false if neither image 0 nor image 1 can be read
+ */
+bool ImageSequenceFrameSource::open() {
+  close();
+  restart_stream();
+  for (first_number = 0; first_number <= 1; first_number++) {
+    first_image = cv::imread(image_path(first_number), cv::IMREAD_COLOR);
+    if (!first_image.empty()) {
+      break;
+    }
+  }
+  if (first_image.empty()) {
+    return false;
+  }
+  frame_size = first_image.size();
+  next_number = first_number;
+  opened = true;
+  return true;
+}
+
+/**
+ * Decodes the next image. Images carry no timestamps, so frames are spaced at the nominal frame rate.
+ */
+bool ImageSequenceFrameSource::read(SourceFrame &frame) {
+  if (!opened) {
+    return false;
+  }
+  if (!first_image.empty()) {
+    std::swap(frame.image, first_image);
+    first_image.release();
+  } else {
+    frame.image = cv::imread(image_path(next_number), cv::IMREAD_COLOR);
+  }
+  if (frame.image.empty()) {
+    return false;
+  }
+  next_number++;
+  stamp(frame, -1.0);
+  return true;
+}
+
+void ImageSequenceFrameSource::close() {
+  opened = false;
+  first_image.release();
+}
+
+bool ImageSequenceFrameSource::is_open() const {
+  return opened;
+}
+
+cv::Size ImageSequenceFrameSource::get_frame_size() const {
+  return frame_size;
+}
+
+std::string ImageSequenceFrameSource::image_path(int number) const {
+  std::vector<char> path(pattern.size() + 32);
+  std::snprintf(path.data(), path.size(), pattern.c_str(), number);
+  return std::string(path.data());
+}
+
+/**
+ * Constructor for RawFileFrameSource
+ * @param path_ std::string     path of a file of frames packed back to back without any header, e.g. as written by
+ * v4l2-ctl --stream-to
+ * @param frame_size_ cv::Size  size of each frame
+ * @param format_ RawPixelFormat    pixel layout of each frame
+ */
+RawFileFrameSource::RawFileFrameSource(const std::string &path_, const cv::Size &frame_size_, RawPixelFormat format_)
+    : path(path_),
+      frame_size(frame_size_),
+      format(format_),
+      file(nullptr) {}
+
+RawFileFrameSource::~RawFileFrameSource() {
+  close();
+}
+
+const std::string &RawFileFrameSource::get_path() const {
+  return path;
+}
+
+const RawPixelFormat &RawFileFrameSource::get_format() const {
+  return format;
+}
+
+bool RawFileFrameSource::open() {
+  close();
+  restart_stream();
+  if (frame_size.area() <= 0) {
+    return false;
+  }
+  file = std::fopen(path.c_str(), "rb");
+  return file != nullptr;
+}
+
+/**
+ * Reads the next frame straight into the buffer of the frame. Grayscale and YUYV frames are converted to BGR unless raw
+ * frames were requested. Raw files carry no timestamps, so frames are spaced at the nominal frame rate.
+ */
+bool RawFileFrameSource::read(SourceFrame &frame) {
+  if (file == nullptr) {
+    return false;
+  }
+  static const int TYPES[] = {CV_8UC1, CV_8UC2, CV_8UC3};
+  const bool convert = !is_raw() && format != RawPixelFormat::BGR;
+  cv::Mat &target = convert ? converted : frame.image;
+  target.create(frame_size, TYPES[static_cast<int>(format)]);
+
+  const size_t frame_bytes = target.total() * target.elemSize();
+  if (std::fread(target.data, 1, frame_bytes, file) != frame_bytes) {
+    return false;
+  }
+  if (convert) {
+    convert_to_bgr(converted, frame.image);
+  }
+  stamp(frame, -1.0);
+  return true;
+}
+
+void RawFileFrameSource::close() {
+  if (file != nullptr) {
+    std::fclose(file);
+    file = nullptr;
+  }
+}
+
+bool RawFileFrameSource::is_open() const {
+  return file != nullptr;
+}
+
+cv::Size RawFileFrameSource::get_frame_size() const {
+  return frame_size;
+}
+
+bool RawFileFrameSource::is_raw() const {
+  return raw_requested && format != RawPixelFormat::BGR;
+}
+
+/**
+ * Constructor for PrefetchingFrameSource
+ * @param source_ FrameSource   the source to decode ahead of the pipeline. Configure it before wrapping it.
+ * @param depth_ size_t     how many decoded frames may wait to be read
+ */
+PrefetchingFrameSource::PrefetchingFrameSource(const cv::Ptr<FrameSource> &source_, size_t depth_)
+    : source(source_),
+      depth(std::max((size_t) 1, depth_)) {}
+
+PrefetchingFrameSource::~PrefetchingFrameSource() {
+  close();
+}
+
+const cv::Ptr<FrameSource> &PrefetchingFrameSource::get_source() const {
+  return source;
+}
+
+const size_t &PrefetchingFrameSource::get_depth() const {
+  return depth;
+}
+
+/**
+ * Opens the wrapped source and starts decoding ahead of the reader
+ */
+bool PrefetchingFrameSource::open() {
+  close();
+  if (!source->open()) {
+    return false;
+  }
+  queue.reset(new BoundedQueue<SourceFrame>(depth));
+  decoder = std::thread(&PrefetchingFrameSource::decode_loop, this);
+  return true;
+}
+
+/**
+ * Hands out the next decoded frame, waiting for the decoder if it has fallen behind. The buffer the frame held before is
+ * handed back to the decoder, so that in steady state no frame is allocated.
+ */
+bool PrefetchingFrameSource::read(SourceFrame &frame) {
+  return queue && queue->pop(frame);
+}
+
+/**
+ * Stops the decoder, discarding any frames it decoded ahead, and closes the wrapped source
+ */
+void PrefetchingFrameSource::close() {
+  if (!queue) {
+    return;
+  }
+  queue->close();
+  decoder.join();
+  queue.reset();
+  source->close();
+}
+
+bool PrefetchingFrameSource::is_open() const {
+  return queue != nullptr;
+}
+
+cv::Size PrefetchingFrameSource::get_frame_size() const {
+  return source->get_frame_size();
+}
+
+bool PrefetchingFrameSource::is_raw() const {
+  return source->is_raw();
+}
+
+bool PrefetchingFrameSource::is_live() const {
+  return source->is_live();
+}
+
+unsigned long long PrefetchingFrameSource::get_dropped_frames() const {
+  return source->get_dropped_frames();
+}
+
+/**
+ * Summarises how far ahead of the reader the decoder ran
+ * @param name std::string    label to use when reporting the statistics
+ */
+QueueStats PrefetchingFrameSource::get_stats(const std::string &name) const {
+  return queue ? queue->get_stats(name) : QueueStats{name, depth, 0, 0.0};
+}
+
+/**
+ * Body of the decoder thread. Decodes each frame into a buffer recycled from the queue until the source runs out or the
+ * queue is closed.
+ */
+void PrefetchingFrameSource::decode_loop() {
+  PROFILE_THREAD("decode");
+  auto decode = [this](SourceFrame &next) {
+    PROFILE_SCOPE("decode");
+    return source->read(next);
+  };
+
+  SourceFrame frame;
+  while (decode(frame)) {
+    if (!queue->push_swap(frame)) {
+      break;
+    }
+  }
+  queue->close();
+}
@@ -0,0 +1,63 @@
+/**
+ * Luminance.cpp
+ *
+ * Vehicle detection only needs the brightness of each pixel, so detection can run on a single 8 bit channel instead of
+ * three. These helpers take the frame layouts a capture source can deliver: grayscale (8UC1), packed YUYV as delivered
+ * by V4L2 cameras with RGB conversion disabled (8UC2), and BGR or BGRA (8UC3, 8UC4).
+ */
+
+#include <cassert>
+
+#include "Luminance.hpp"
+
+/**
+ * Extracts the luminance of a frame, doing as little work as its layout allows
+ * @param frame cv::Mat     grayscale, YUYV, BGR or BGRA frame
+ * @param luminance cv::Mat     receives an 8 bit single channel image of the same size. A grayscale frame is shared
+ * rather than copied; otherwise the buffer is reused when it already has the right size and type.
+ */
+void extract_luminance(const cv::Mat &frame, cv::Mat &luminance) {
+  assert(frame.depth() == CV_8U);
+
+  switch (frame.channels()) {
+    case 1:
+      luminance = frame;
+      break;
+    case 2:
+      // YUYV interleaves a luma byte with every chroma byte, so the luma plane is the first channel
+      cv::extractChannel(frame, luminance, 0);
+      break;
+    case 3:
+      cv::cvtColor(frame, luminance, cv::COLOR_BGR2GRAY);
+      break;
+    default:
+      cv::cvtColor(frame, luminance, cv::COLOR_BGRA2GRAY);
+      break;
+  }
+}
+
+/**
+ * Converts a captured frame to BGR for overlays, snapshots and the recorded video
+ * @param frame cv::Mat     grayscale, YUYV, BGR or BGRA frame
+ * @param bgr cv::Mat   receives the 8 bit three channel frame. Reused when it already has the right size and type.
+ */
+void convert_to_bgr(const cv::Mat &frame, cv::Mat &bgr) {
+  assert(frame.depth() == CV_8U);
+
+  switch (frame.channels()) {
+    case 1:
+      cv::cvtColor(frame, bgr, cv::COLOR_GRAY2BGR);
+      break;
+    case 2:
+      cv::cvtColor(frame, bgr, cv::COLOR_YUV2BGR_YUYV);
+      break;
+    case 3:
+      if (bgr.data != frame.data) {
+        frame.copyTo(bgr);
+      }
+      break;
+    default:
+      cv::cvtColor(frame, bgr, cv::COLOR_BGRA2BGR);
+      break;
+  }
+}
@@ -0,0 +1,638 @@
+/**
+ * MaskPostProcessor.cpp
+ *
+ * Cleans up the raw foreground mask produced by the background model. The result is identical to running
+ *
+ *   cv::threshold(mask, mask, threshold, 255, cv::THRESH_BINARY);
+ *   cv::morphologyEx(mask, mask, cv::MORPH_ERODE, 3x3 rectangle);
+ *   cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, 6x6 rectangle);
+ *
+ * but the four passes (threshold, erode, dilate, erode) are fused into a single sweep down the frame. Every rectangular
+ * erosion or dilation is separable into a horizontal and a vertical min/max, so each stage keeps only the handful of
+ * horizontally filtered rows its vertical window needs in a small ring. A frame row is read, pushed through every stage
+ * and the output row five rows above it is written, so the working set is about 17 rows rather than several full
+ * frames and the output may be the input buffer.
+ *
+ * The row operations have SSE2, AVX2 and NEON implementations as well as a scalar fallback. The fastest one the CPU
+ * supports is chosen at runtime. Matching OpenCV, pixels beyond the edge of the frame are ignored by every window.
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRAFFIC_MONITOR_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+// The AVX2 kernels are compiled with a target attribute and only run after checking the CPU at runtime
+#define TRAFFIC_MONITOR_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TRAFFIC_MONITOR_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#include "MaskPostProcessor.hpp"
+
+namespace {
+
+typedef unsigned char uchar;
+
+// Row offsets of the structuring elements. A 6x6 rectangle with the default anchor covers offsets -3 to +2.
+const int CLOSE_BEFORE = 3;
+const int CLOSE_AFTER = 2;
+
+/**
+ * The row operations the fused kernel is built from, implemented once per instruction set
+ */
+struct RowKernels {
+  // out[x] = in[x] > threshold ? 255 : 0, for a threshold within [0, 254]
+  void (*threshold)(const uchar *in, uchar *out, int width, uchar threshold);
+  // out[x] = min(in[x - 1 .. x + 1])
+  void (*horizontal_min3)(const uchar *in, uchar *out, int width);
+  // out[x] = min(in[x - 3 .. x + 2])
+  void (*horizontal_min6)(const uchar *in, uchar *out, int width);
+  // out[x] = max(in[x - 3 .. x + 2])
+  void (*horizontal_max6)(const uchar *in, uchar *out, int width);
+  // out[x] = min(rows[0][x] .. rows[count - 1][x])
+  void (*vertical_min)(const uchar *const *rows, int count, uchar *out, int width);
+  // out[x] = max(rows[0][x] .. rows[count - 1][x])
+  void (*vertical_max)(const uchar *const *rows, int count, uchar *out, int width);
+};
+
+/*
+ * Scalar implementations. The vector implementations fall back to these for the pixels near the ends of each row.
+ */
+
+void threshold_scalar(const uchar *in, uchar *out, int begin, int end, uchar threshold) {
+  for (int x = begin; x < end; x++) {
+    out[x] = in[x] > threshold ? 255 : 0;
+  }
+}
+
+template<bool IS_MAX>
+void horizontal_scalar(const uchar *in, uchar *out, int width, int before, int after, int begin, int end) {
+  for (int x = begin; x < end; x++) {
+    const int first = std::max(0, x - before);
+    const int last = std::min(width - 1, x + after);
+    uchar value = in[first];
+    for (int i = first + 1; i <= last; i++) {
+      value = IS_MAX ? std::max(value, in[i]) : std::min(value, in[i]);
+    }
+    out[x] = value;
+  }
+}
+
+template<bool IS_MAX>
+void vertical_scalar(const uchar *const *rows, int count, uchar *out, int begin, int end) {
+  for (int x = begin; x < end; x++) {
+    uchar value = rows[0][x];
+    for (int i = 1; i < count; i++) {
+      value = IS_MAX ? std::max(value, rows[i][x]) : std::min(value, rows[i][x]);
+    }
+    out[x] = value;
+  }
+}
+
+// Vertical windows hold between 1 and 6 rows. A fixed row count lets the compiler unroll the inner loop.
+#define VERTICAL_DISPATCH(kernel, IS_MAX, rows, count, out, width) \
+  switch (count) { \
+    case 1: kernel<IS_MAX, 1>(rows, out, width); break; \
+    case 2: kernel<IS_MAX, 2>(rows, out, width); break; \
+    case 3: kernel<IS_MAX, 3>(rows, out, width); break; \
+    case 4: kernel<IS_MAX, 4>(rows, out, width); break; \
+    case 5: kernel<IS_MAX, 5>(rows, out, width); break; \
+    default: kernel<IS_MAX, 6>(rows, out, width); break; \
+  }
+
+void threshold_row_scalar(const uchar *in, uchar *out, int width, uchar threshold) {
+  threshold_scalar(in, out, 0, width, threshold);
+}
+
+// Away from the ends of the row the window never needs clamping, which the compiler can vectorise
+template<bool IS_MAX, int BEFORE, int AFTER>
+void horizontal_fixed_scalar(const uchar *in, uchar *out, int width) {
+  const int end = std::max(BEFORE, width - AFTER);
+  for (int x = BEFORE; x < end; x++) {
+    uchar value = in[x - BEFORE];
+    for (int i = 1 - BEFORE; i <= AFTER; i++) {
+      value = IS_MAX ? std::max(value, in[x + i]) : std::min(value, in[x + i]);
+    }
+    out[x] = value;
+  }
+  horizontal_scalar<IS_MAX>(in, out, width, BEFORE, AFTER, 0, std::min(BEFORE, width));
+  horizontal_scalar<IS_MAX>(in, out, width, BEFORE, AFTER, end, width);
+}
+
+void horizontal_min3_scalar(const uchar *in, uchar *out, int width) {
+  horizontal_fixed_scalar<false, 1, 1>(in, out, width);
+}
+
+void horizontal_min6_scalar(const uchar *in, uchar *out, int width) {
+  horizontal_fixed_scalar<false, CLOSE_BEFORE, CLOSE_AFTER>(in, out, width);
+}
+
+void horizontal_max6_scalar(const uchar *in, uchar *out, int width) {
+  horizontal_fixed_scalar<true, CLOSE_BEFORE, CLOSE_AFTER>(in, out, width);
+}
+
+template<bool IS_MAX, int COUNT>
+void vertical_fixed_scalar(const uchar *const *rows, uchar *out, int width) {
+  vertical_scalar<IS_MAX>(rows, COUNT, out, 0, width);
+}
+
+void vertical_min_scalar(const uchar *const *rows, int count, uchar *out, int width) {
+  VERTICAL_DISPATCH(vertical_fixed_scalar, false, rows, count, out, width);
+}
+
+void vertical_max_scalar(const uchar *const *rows, int count, uchar *out, int width) {
+  VERTICAL_DISPATCH(vertical_fixed_scalar, true, rows, count, out, width);
+}
+
+const RowKernels SCALAR_KERNELS = {
+    threshold_row_scalar,
+    horizontal_min3_scalar,
+    horizontal_min6_scalar,
+    horizontal_max6_scalar,
+    vertical_min_scalar,
+    vertical_max_scalar
+};
+
+#ifdef TRAFFIC_MONITOR_HAVE_SSE2
+
+inline __m128i min_sse2(__m128i a, __m128i b) {
+  return _mm_min_epu8(a, b);
+}
+
+inline __m128i max_sse2(__m128i a, __m128i b) {
+  return _mm_max_epu8(a, b);
+}
+
+inline __m128i load_sse2(const uchar *p) {
+  return _mm_loadu_si128((const __m128i *) p);
+}
+
+void threshold_row_sse2(const uchar *in, uchar *out, int width, uchar threshold) {
+  // in > threshold is equivalent to max(in, threshold + 1) == in for unsigned bytes
+  const __m128i limit = _mm_set1_epi8((char) (threshold + 1));
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m128i value = load_sse2(in + x);
+    _mm_storeu_si128((__m128i *) (out + x), _mm_cmpeq_epi8(_mm_max_epu8(value, limit), value));
+  }
+  threshold_scalar(in, out, x, width, threshold);
+}
+
+void horizontal_min3_sse2(const uchar *in, uchar *out, int width) {
+  int x = 1;
+  for (; x + 16 + 1 <= width; x += 16) {
+    const __m128i value = min_sse2(min_sse2(load_sse2(in + x - 1), load_sse2(in + x)), load_sse2(in + x + 1));
+    _mm_storeu_si128((__m128i *) (out + x), value);
+  }
+  horizontal_scalar<false>(in, out, width, 1, 1, 0, std::min(1, width));
+  horizontal_scalar<false>(in, out, width, 1, 1, std::max(x, 1), width);
+}
+
+template<bool IS_MAX>
+void horizontal6_sse2(const uchar *in, uchar *out, int width) {
+  int x = CLOSE_BEFORE;
+  for (; x + 16 + CLOSE_AFTER <= width; x += 16) {
+    __m128i value = load_sse2(in + x - 3);
+    for (int i = -2; i <= CLOSE_AFTER; i++) {
+      value = IS_MAX ? max_sse2(value, load_sse2(in + x + i)) : min_sse2(value, load_sse2(in + x + i));
+    }
+    _mm_storeu_si128((__m128i *) (out + x), value);
+  }
+  horizontal_scalar<IS_MAX>(in, out, width, CLOSE_BEFORE, CLOSE_AFTER, 0, std::min(CLOSE_BEFORE, width));
+  horizontal_scalar<IS_MAX>(in, out, width, CLOSE_BEFORE, CLOSE_AFTER, std::max(x, CLOSE_BEFORE), width);
+}
+
+template<bool IS_MAX, int COUNT>
+void vertical_fixed_sse2(const uchar *const *rows, uchar *out, int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i value = load_sse2(rows[0] + x);
+    for (int i = 1; i < COUNT; i++) {
+      value = IS_MAX ? max_sse2(value, load_sse2(rows[i] + x)) : min_sse2(value, load_sse2(rows[i] + x));
+    }
+    _mm_storeu_si128((__m128i *) (out + x), value);
+  }
+  vertical_scalar<IS_MAX>(rows, COUNT, out, x, width);
+}
+
+template<bool IS_MAX>
+void vertical_sse2(const uchar *const *rows, int count, uchar *out, int width) {
+  VERTICAL_DISPATCH(vertical_fixed_sse2, IS_MAX, rows, count, out, width);
+}
+
+const RowKernels SSE2_KERNELS = {
+    threshold_row_sse2,
+    horizontal_min3_sse2,
+    horizontal6_sse2<false>,
+    horizontal6_sse2<true>,
+    vertical_sse2<false>,
+    vertical_sse2<true>
+};
+
+#endif
+
+#ifdef TRAFFIC_MONITOR_HAVE_AVX2
+
+__attribute__((target("avx2"))) inline __m256i min_avx2(__m256i a, __m256i b) {
+  return _mm256_min_epu8(a, b);
+}
+
+__attribute__((target("avx2"))) inline __m256i max_avx2(__m256i a, __m256i b) {
+  return _mm256_max_epu8(a, b);
+}
+
+__attribute__((target("avx2"))) inline __m256i load_avx2(const uchar *p) {
+  return _mm256_loadu_si256((const __m256i *) p);
+}
+
+__attribute__((target("avx2"))) void threshold_row_avx2(const uchar *in, uchar *out, int width, uchar threshold) {
+  const __m256i limit = _mm256_set1_epi8((char) (threshold + 1));
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i value = load_avx2(in + x);
+    _mm256_storeu_si256((__m256i *) (out + x), _mm256_cmpeq_epi8(_mm256_max_epu8(value, limit), value));
+  }
+  threshold_scalar(in, out, x, width, threshold);
+}
+
+__attribute__((target("avx2"))) void horizontal_min3_avx2(const uchar *in, uchar *out, int width) {
+  int x = 1;
+  for (; x + 32 + 1 <= width; x += 32) {
+    const __m256i value = min_avx2(min_avx2(load_avx2(in + x - 1), load_avx2(in + x)), load_avx2(in + x + 1));
+    _mm256_storeu_si256((__m256i *) (out + x), value);
+  }
+  horizontal_scalar<false>(in, out, width, 1, 1, 0, std::min(1, width));
+  horizontal_scalar<false>(in, out, width, 1, 1, std::max(x, 1), width);
+}
+
+template<bool IS_MAX>
+__attribute__((target("avx2"))) void horizontal6_avx2(const uchar *in, uchar *out, int width) {
+  int x = CLOSE_BEFORE;
+  for (; x + 32 + CLOSE_AFTER <= width; x += 32) {
+    __m256i value = load_avx2(in + x - 3);
+    for (int i = -2; i <= CLOSE_AFTER; i++) {
+      value = IS_MAX ? max_avx2(value, load_avx2(in + x + i)) : min_avx2(value, load_avx2(in + x + i));
+    }
+    _mm256_storeu_si256((__m256i *) (out + x), value);
+  }
+  horizontal_scalar<IS_MAX>(in, out, width, CLOSE_BEFORE, CLOSE_AFTER, 0, std::min(CLOSE_BEFORE, width));
+  horizontal_scalar<IS_MAX>(in, out, width, CLOSE_BEFORE, CLOSE_AFTER, std::max(x, CLOSE_BEFORE), width);
+}
+
+template<bool IS_MAX, int COUNT>
+__attribute__((target("avx2"))) void vertical_fixed_avx2(const uchar *const *rows, uchar *out, int width) {
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i value = load_avx2(rows[0] + x);
+    for (int i = 1; i < COUNT; i++) {
+      value = IS_MAX ? max_avx2(value, load_avx2(rows[i] + x)) : min_avx2(value, load_avx2(rows[i] + x));
+    }
+    _mm256_storeu_si256((__m256i *) (out + x), value);
+  }
+  vertical_scalar<IS_MAX>(rows, COUNT, out, x, width);
+}
+
+template<bool IS_MAX>
+__attribute__((target("avx2"))) void vertical_avx2(const uchar *const *rows, int count, uchar *out, int width) {
+  VERTICAL_DISPATCH(vertical_fixed_avx2, IS_MAX, rows, count, out, width);
+}
+
+const RowKernels AVX2_KERNELS = {
+    threshold_row_avx2,
+    horizontal_min3_avx2,
+    horizontal6_avx2<false>,
+    horizontal6_avx2<true>,
+    vertical_avx2<false>,
+    vertical_avx2<true>
+};
+
+#endif
+
+#ifdef TRAFFIC_MONITOR_HAVE_NEON
+
+void threshold_row_neon(const uchar *in, uchar *out, int width, uchar threshold) {
+  const uint8x16_t limit = vdupq_n_u8(threshold);
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    vst1q_u8(out + x, vcgtq_u8(vld1q_u8(in + x), limit));
+  }
+  threshold_scalar(in, out, x, width, threshold);
+}
+
+void horizontal_min3_neon(const uchar *in, uchar *out, int width) {
+  int x = 1;
+  for (; x + 16 + 1 <= width; x += 16) {
+    vst1q_u8(out + x, vminq_u8(vminq_u8(vld1q_u8(in + x - 1), vld1q_u8(in + x)), vld1q_u8(in + x + 1)));
+  }
+  horizontal_scalar<false>(in, out, width, 1, 1, 0, std::min(1, width));
+  horizontal_scalar<false>(in, out, width, 1, 1, std::max(x, 1), width);
+}
+
+template<bool IS_MAX>
+void horizontal6_neon(const uchar *in, uchar *out, int width) {
+  int x = CLOSE_BEFORE;
+  for (; x + 16 + CLOSE_AFTER <= width; x += 16) {
+    uint8x16_t value = vld1q_u8(in + x - 3);
+    for (int i = -2; i <= CLOSE_AFTER; i++) {
+      value = IS_MAX ? vmaxq_u8(value, vld1q_u8(in + x + i)) : vminq_u8(value, vld1q_u8(in + x + i));
+    }
+    vst1q_u8(out + x, value);
+  }
+  horizontal_scalar<IS_MAX>(in, out, width, CLOSE_BEFORE, CLOSE_AFTER, 0, std::min(CLOSE_BEFORE, width));
+  horizontal_scalar<IS_MAX>(in, out, width, CLOSE_BEFORE, CLOSE_AFTER, std::max(x, CLOSE_BEFORE), width);
+}
+
+template<bool IS_MAX, int COUNT>
+void vertical_fixed_neon(const uchar *const *rows, uchar *out, int width) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t value = vld1q_u8(rows[0] + x);
+    for (int i = 1; i < COUNT; i++) {
+      value = IS_MAX ? vmaxq_u8(value, vld1q_u8(rows[i] + x)) : vminq_u8(value, vld1q_u8(rows[i] + x));
+    }
+    vst1q_u8(out + x, value);
+  }
+  vertical_scalar<IS_MAX>(rows, COUNT, out, x, width);
+}
+
+template<bool IS_MAX>
+void vertical_neon(const uchar *const *rows, int count, uchar *out, int width) {
+  VERTICAL_DISPATCH(vertical_fixed_neon, IS_MAX, rows, count, out, width);
+}
+
+const RowKernels NEON_KERNELS = {
+    threshold_row_neon,
+    horizontal_min3_neon,
+    horizontal6_neon<false>,
+    horizontal6_neon<true>,
+    vertical_neon<false>,
+    vertical_neon<true>
+};
+
+#endif
+
+const RowKernels &kernels_for(SimdPath simd_path) {
+  switch (simd_path) {
+#ifdef TRAFFIC_MONITOR_HAVE_SSE2
+    case SimdPath::SSE2:
+      return SSE2_KERNELS;
+#endif
+#ifdef TRAFFIC_MONITOR_HAVE_AVX2
+    case SimdPath::AVX2:
+      return AVX2_KERNELS;
+#endif
+#ifdef TRAFFIC_MONITOR_HAVE_NEON
+    case SimdPath::NEON:
+      return NEON_KERNELS;
+#endif
+    default:
+      return SCALAR_KERNELS;
+  }
+}
+
+/**
+ * Collects the rows first..last of a ring of horizontally filtered rows, indexed by frame row
+ */
+int gather_rows(uchar *ring, int ring_size, int width, int first, int last, const uchar **window) {
+  int count = 0;
+  for (int row = first; row <= last; row++) {
+    window[count++] = ring + (row % ring_size) * width;
+  }
+  return count;
+}
+
+/**
+ * Thresholds the input, erodes it with a 3x3 rectangle and closes it with a 6x6 rectangle in a single sweep, writing
+ * the output rows row_begin..row_end - 1. Output row r depends on input rows r - 7..r + 5, so the sweep starts that
+ * many rows above the band and reads that many rows below it. Over the whole frame, row r of the input is read at step
+ * r and row r - 5 of the output is written in the same step, so the output may alias the input.
+ */
+void threshold_erode_close(const cv::Mat &input, cv::Mat &output, int row_begin, int row_end,
+                           const RowKernels &kernels, bool enable_threshold, uchar threshold, uchar *scratch) {
+  const int rows = input.rows;
+  const int width = input.cols;
+  uchar *eroded_rows = scratch;                 // 3 rows after the 3 wide horizontal min
+  uchar *dilated_rows = eroded_rows + 3 * width;  // 6 rows after the 3x3 erode and the 6 wide horizontal max
+  uchar *closed_rows = dilated_rows + 6 * width;  // 6 rows after the 6x6 dilate and the 6 wide horizontal min
+  uchar *thresholded = closed_rows + 6 * width;
+  uchar *vertical = thresholded + width;
+  const uchar *window[6];
+
+  // Rows of each intermediate result which the band needs
+  const int input_begin = std::max(0, row_begin - 1 - 2 * CLOSE_BEFORE);
+  const int input_end = std::min(rows, row_end + 1 + 2 * CLOSE_AFTER);
+  const int erode_begin = std::max(0, row_begin - 2 * CLOSE_BEFORE);
+  const int erode_end = std::min(rows, row_end + 2 * CLOSE_AFTER);
+  const int dilate_begin = std::max(0, row_begin - CLOSE_BEFORE);
+  const int dilate_end = std::min(rows, row_end + CLOSE_AFTER);
+
+  for (int step = input_begin; step < row_end + 5; step++) {
+    if (step < input_end) {
+      const uchar *source = input.ptr<uchar>(step);
+      if (enable_threshold) {
+        kernels.threshold(source, thresholded, width, threshold);
+        source = thresholded;
+      }
+      kernels.horizontal_min3(source, eroded_rows + (step % 3) * width, width);
+    }
+
+    // Rows lag the input so that every row a vertical window needs has already been filtered horizontally
+    const int erode_row = step - 1;
+    if (erode_row >= erode_begin && erode_row < erode_end) {
+      const int count = gather_rows(eroded_rows, 3, width, std::max(0, erode_row - 1),
+                                    std::min(rows - 1, erode_row + 1), window);
+      kernels.vertical_min(window, count, vertical, width);
+      kernels.horizontal_max6(vertical, dilated_rows + (erode_row % 6) * width, width);
+    }
+
+    const int dilate_row = erode_row - CLOSE_AFTER;
+    if (dilate_row >= dilate_begin && dilate_row < dilate_end) {
+      const int count = gather_rows(dilated_rows, 6, width, std::max(0, dilate_row - CLOSE_BEFORE),
+                                    std::min(rows - 1, dilate_row + CLOSE_AFTER), window);
+      kernels.vertical_max(window, count, vertical, width);
+      kernels.horizontal_min6(vertical, closed_rows + (dilate_row % 6) * width, width);
+    }
+
+    const int output_row = dilate_row - CLOSE_AFTER;
+    if (output_row >= row_begin && output_row < row_end) {
+      const int count = gather_rows(closed_rows, 6, width, std::max(0, output_row - CLOSE_BEFORE),
+                                    std::min(rows - 1, output_row + CLOSE_AFTER), window);
+      kernels.vertical_min(window, count, output.ptr<uchar>(output_row), width);
+    }
+  }
+}
+
+}
+
+/**
+ * Default constructor for MaskPostProcessor. Thresholds at 160, erodes and closes, using the fastest supported kernel.
+ */
+MaskPostProcessor::MaskPostProcessor()
+    : threshold(160),
+      enable_threshold(true),
+      enable_open_close(true),
+      simd_path(best_simd_path()) {}
+
+/**
+ * Constructor for MaskPostProcessor
+ * @param threshold_ int    pixels at or below this value become background (0), the rest foreground (255)
+ * @param enable_threshold_ bool    whether to threshold the mask
+ * @param enable_open_close_ bool   whether to erode the mask with a 3x3 rectangle and close it with a 6x6 rectangle
+ */
+MaskPostProcessor::MaskPostProcessor(int threshold_, bool enable_threshold_, bool enable_open_close_)
+    : threshold(threshold_),
+      enable_threshold(enable_threshold_),
+      enable_open_close(enable_open_close_),
+      simd_path(best_simd_path()) {}
+
+const int &MaskPostProcessor::get_threshold() const {
+  return threshold;
+}
+
+void MaskPostProcessor::set_threshold(const int threshold_) {
+  threshold = threshold_;
+}
+
+const bool &MaskPostProcessor::get_enable_threshold() const {
+  return enable_threshold;
+}
+
+void MaskPostProcessor::set_enable_threshold(const bool enable_threshold_) {
+  enable_threshold = enable_threshold_;
+}
+
+const bool &MaskPostProcessor::get_enable_open_close() const {
+  return enable_open_close;
+}
+
+void MaskPostProcessor::set_enable_open_close(const bool enable_open_close_) {
+  enable_open_close = enable_open_close_;
+}
+
+const SimdPath &MaskPostProcessor::get_simd_path() const {
+  return simd_path;
+}
+
+/**
+ * Forces a particular kernel implementation, e.g. to compare them. Unsupported paths fall back to SCALAR.
+ * @param simd_path_ SimdPath   the instruction set to use
+ */
+void MaskPostProcessor::set_simd_path(const SimdPath simd_path_) {
+  simd_path = is_supported(simd_path_) ? simd_path_ : SimdPath::SCALAR;
+}
+
+/**
+ * Post-processes a raw foreground mask
+ * @param input cv::Mat     8 bit single channel mask from the background model
+ * @param output cv::Mat    receives the cleaned mask. Reused without reallocation when it already has the size of input
+ * and type CV_8UC1, and may be the same buffer as input.
+ */
+void MaskPostProcessor::apply(const cv::Mat &input, cv::Mat &output) {
+  assert(input.type() == CV_8UC1);
+  output.create(input.size(), CV_8UC1);
+  apply_rows(input, output, 0, input.rows, scratch);
+}
+
+/**
+ * Post-processes a horizontal band of a mask, so that bands of one frame can be processed on separate threads. Each
+ * band reads the rows around it from the input, so the bands join up without seams and together give exactly the
+ * output of apply().
+ * @param input cv::Mat     8 bit single channel mask of the whole frame
+ * @param output cv::Mat    8 bit single channel mask of the same size, already allocated. Only the rows of the band
+ * are written. It may only alias the input when the band is the whole frame.
+ * @param row_begin int     first row of the band
+ * @param row_end int       one past the last row of the band
+ * @param band_scratch std::vector<unsigned char>   row buffers owned by the calling thread, resized as needed
+ */
+void MaskPostProcessor::apply_rows(const cv::Mat &input, cv::Mat &output, int row_begin, int row_end,
+                                   std::vector<unsigned char> &band_scratch) const {
+  assert(input.type() == CV_8UC1 && output.type() == CV_8UC1 && output.size() == input.size());
+  assert(row_begin >= 0 && row_begin <= row_end && row_end <= input.rows);
+  assert(output.data != input.data || (row_begin == 0 && row_end == input.rows));
+
+  // cv::threshold() floors the threshold, so anything outside [0, 254] makes the whole mask one colour
+  const bool threshold_everything = enable_threshold && (threshold < 0 || threshold >= 255);
+  if (threshold_everything) {
+    output.rowRange(row_begin, row_end).setTo(cv::Scalar(threshold < 0 ? 255 : 0));
+    return;
+  }
+
+  const RowKernels &kernels = kernels_for(simd_path);
+  if (enable_open_close) {
+    band_scratch.resize((size_t) input.cols * 17);
+    threshold_erode_close(input, output, row_begin, row_end, kernels, enable_threshold, (uchar) threshold,
+                          band_scratch.data());
+  } else if (enable_threshold) {
+    for (int row = row_begin; row < row_end; row++) {
+      kernels.threshold(input.ptr<uchar>(row), output.ptr<uchar>(row), input.cols, (uchar) threshold);
+    }
+  } else if (output.data != input.data) {
+    cv::Mat band = output.rowRange(row_begin, row_end);
+    input.rowRange(row_begin, row_end).copyTo(band);
+  }
+}
+
+/**
+ * Whether the kernel for an instruction set was compiled in and the CPU can run it
+ * @param simd_path SimdPath    the instruction set to check
+ */
+bool MaskPostProcessor::is_supported(SimdPath simd_path) {
+  switch (simd_path) {
+    case SimdPath::SCALAR:
+      return true;
+#ifdef TRAFFIC_MONITOR_HAVE_SSE2
+    case SimdPath::SSE2:
+      return true;
+#endif
+#ifdef TRAFFIC_MONITOR_HAVE_AVX2
+    case SimdPath::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+#ifdef TRAFFIC_MONITOR_HAVE_NEON
+    case SimdPath::NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+/**
+ * The fastest instruction set supported by this CPU
+ */
+SimdPath MaskPostProcessor::best_simd_path() {
+  if (is_supported(SimdPath::AVX2)) {
+    return SimdPath::AVX2;
+  }
+  if (is_supported(SimdPath::NEON)) {
+    return SimdPath::NEON;
+  }
+  if (is_supported(SimdPath::SSE2)) {
+    return SimdPath::SSE2;
+  }
+  return SimdPath::SCALAR;
+}
+
+/**
+ * Printable name of an instruction set, for logs and benchmarks
+ */
+const char *MaskPostProcessor::simd_path_name(SimdPath simd_path) {
+  switch (simd_path) {
+    case SimdPath::SSE2:
+      return "sse2";
+    case SimdPath::AVX2:
+      return "avx2";
+    case SimdPath::NEON:
+      return "neon";
+    default:
+      return "scalar";
+  }
+}
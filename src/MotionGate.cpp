@@ -0,0 +1,253 @@
+/**
+ * MotionGate.cpp
+ *
+ * A cheap test for whether anything is moving on the road, run on every frame so that background subtraction, blob
+ * extraction and tracking only run while it is. The frame is sampled on a sparse grid, sample_width pixels across,
+ * which reads a tiny fraction of the frame, and the luminance of the samples is compared against a quickly adapting
+ * running average of them. Gradual lighting changes are absorbed by the average while a vehicle entering the region
+ * changes many samples at once.
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#include "MotionGate.hpp"
+
+namespace {
+// The sample average moves 1/16 of the way towards each frame, absorbing lighting changes within a second or two
+const int SAMPLE_LEARNING_SHIFT = 4;
+}
+
+/**
+ * Default constructor for MotionGate. Samples 80 pixels across and opens when 0.2% of the samples change by more than
+ * 25 grey levels. Stays open for 30 quiet frames, and asks for 8 frames of pre-roll and a background update every 15th
+ * frame while idle.
+ */
+MotionGate::MotionGate()
+    : sample_width(80),
+      difference_threshold(25),
+      min_changed_fraction(0.002),
+      hold_frames(30),
+      pre_roll_frames(8),
+      idle_update_interval(15),
+      state(GateState::IDLE),
+      quiet_frames(0),
+      changed_fraction(0.0),
+      frames(0),
+      active_frames(0),
+      activations(0),
+      sample_model(SAMPLE_LEARNING_SHIFT, 25),
+      watched_pixels(0) {}
+
+const int &MotionGate::get_sample_width() const {
+  return sample_width;
+}
+
+/**
+ * Sets how many pixels across the frame is sampled. More samples catch smaller or more distant vehicles at a higher
+ * cost.
+ * @param sample_width_ int     number of samples per row
+ */
+void MotionGate::set_sample_width(const int sample_width_) {
+  assert(sample_width_ > 0);
+  sample_width = sample_width_;
+}
+
+const int &MotionGate::get_difference_threshold() const {
+  return difference_threshold;
+}
+
+/**
+ * Sets how many grey levels a sample must differ from its average to count as changed
+ * @param difference_threshold_ int     grey levels
+ */
+void MotionGate::set_difference_threshold(const int difference_threshold_) {
+  difference_threshold = difference_threshold_;
+  sample_model.set_difference_threshold(difference_threshold_);
+}
+
+const double &MotionGate::get_min_changed_fraction() const {
+  return min_changed_fraction;
+}
+
+/**
+ * Sets the fraction of the watched samples which must change for a frame to show motion
+ * @param min_changed_fraction_ double  within [0, 1]
+ */
+void MotionGate::set_min_changed_fraction(const double min_changed_fraction_) {
+  min_changed_fraction = min_changed_fraction_;
+}
+
+const unsigned int &MotionGate::get_hold_frames() const {
+  return hold_frames;
+}
+
+/**
+ * Sets how many frames in a row must show no motion before the gate closes again
+ * @param hold_frames_ unsigned int     number of frames
+ */
+void MotionGate::set_hold_frames(const unsigned int hold_frames_) {
+  hold_frames = hold_frames_;
+}
+
+const unsigned int &MotionGate::get_pre_roll_frames() const {
+  return pre_roll_frames;
+}
+
+/**
+ * Sets how many frames before the one which opened the gate are still fully processed. A vehicle is already some way
+ * into the frame by the time it changes enough samples, so these frames catch its entry.
+ * @param pre_roll_frames_ unsigned int     number of frames held back while idle
+ */
+void MotionGate::set_pre_roll_frames(const unsigned int pre_roll_frames_) {
+  pre_roll_frames = pre_roll_frames_;
+}
+
+const unsigned int &MotionGate::get_idle_update_interval() const {
+  return idle_update_interval;
+}
+
+/**
+ * Sets how often the background model is still updated while the gate is idle, so that it follows the lighting and is
+ * ready when the gate opens
+ * @param idle_update_interval_ unsigned int    update on every Nth idle frame. 0 never updates while idle.
+ */
+void MotionGate::set_idle_update_interval(const unsigned int idle_update_interval_) {
+  idle_update_interval = idle_update_interval_;
+}
+
+/**
+ * Only watches the road. Samples outside the region never open the gate.
+ * @param region_ RegionOfInterest  polygons in frame coordinates. An empty region watches the whole frame.
+ */
+void MotionGate::set_region_of_interest(const RegionOfInterest &region_) {
+  region = region_;
+  watched_size = cv::Size();
+}
+
+/**
+ * Samples a frame and updates the state of the gate
+ * @param frame cv::Mat     the captured frame, in any layout extract_luminance() accepts
+ * @return whether the gate is active, i.e. the frame should be fully processed
+ */
+bool MotionGate::update(const cv::Mat &frame) {
+  assert(!frame.empty());
+
+  const int width = std::min(sample_width, frame.cols);
+  const cv::Size sample_size(width, std::max(1, cvRound(frame.rows * width / (double) frame.cols)));
+  if (sample_size != watched_size) {
+    prepare_watch_mask(sample_size, frame.size());
+  }
+
+  // Nearest neighbour only reads the sampled pixels, so the cost does not grow with the frame
+  cv::resize(frame, sample, sample_size, 0, 0, cv::INTER_NEAREST);
+  sample_model.apply(sample, changed);
+  if (!watch_mask.empty()) {
+    cv::bitwise_and(changed, watch_mask, changed);
+  }
+  const int changed_pixels = cv::countNonZero(changed);
+  changed_fraction = watched_pixels > 0 ? changed_pixels / (double) watched_pixels : 0.0;
+  const bool motion = changed_pixels > 0 && changed_fraction > min_changed_fraction;
+
+  frames++;
+  if (motion) {
+    quiet_frames = 0;
+    if (state == GateState::IDLE) {
+      state = GateState::ACTIVE;
+      activations++;
+    }
+  } else if (state == GateState::ACTIVE && ++quiet_frames >= hold_frames) {
+    state = GateState::IDLE;
+  }
+  if (state == GateState::ACTIVE) {
+    active_frames++;
+  }
+  return state == GateState::ACTIVE;
+}
+
+/**
+ * Closes the gate, forgets the sampled background and clears the metrics
+ */
+void MotionGate::reset() {
+  state = GateState::IDLE;
+  quiet_frames = 0;
+  changed_fraction = 0.0;
+  frames = 0;
+  active_frames = 0;
+  activations = 0;
+  sample_model = RunningAverageBackgroundModel(SAMPLE_LEARNING_SHIFT, difference_threshold);
+}
+
+const GateState &MotionGate::get_state() const {
+  return state;
+}
+
+bool MotionGate::is_active() const {
+  return state == GateState::ACTIVE;
+}
+
+/**
+ * Fraction of the watched samples which changed in the last frame
+ */
+const double &MotionGate::get_changed_fraction() const {
+  return changed_fraction;
+}
+
+/**
+ * Number of frames the gate has seen since it was created or reset
+ */
+const unsigned long long &MotionGate::get_frames() const {
+  return frames;
+}
+
+/**
+ * Number of those frames during which the gate was active
+ */
+const unsigned long long &MotionGate::get_active_frames() const {
+  return active_frames;
+}
+
+/**
+ * Number of times the gate has opened
+ */
+const unsigned long long &MotionGate::get_activations() const {
+  return activations;
+}
+
+/**
+ * Fraction of frames during which the gate was active, i.e. the share of frames which paid for full processing
+ */
+double MotionGate::get_duty_cycle() const {
+  return frames > 0 ? active_frames / (double) frames : 0.0;
+}
+
+/**
+ * Printable name of a gate state, for logs
+ */
+const char *MotionGate::state_name(GateState state) {
+  return state == GateState::ACTIVE ? "active" : "idle";
+}
+
+/**
+ * Builds the mask of the samples within the region of interest
+ * @param sample_size cv::Size  size of the sampled frame
+ * @param frame_size cv::Size   size of the captured frame
+ */
+void MotionGate::prepare_watch_mask(const cv::Size &sample_size, const cv::Size &frame_size) {
+  watched_size = sample_size;
+  if (region.empty()) {
+    watch_mask.release();
+    watched_pixels = sample_size.area();
+    return;
+  }
+
+  RegionOfInterest sampled_region = region.scaled(sample_size.width / (double) frame_size.width);
+  sampled_region.prepare(sample_size);
+  const cv::Rect &rect = sampled_region.get_bounding_rect();
+  watch_mask = cv::Mat::zeros(sample_size, CV_8UC1);
+  if (rect.area() > 0) {
+    cv::Mat watched = watch_mask(rect);
+    sampled_region.get_mask().copyTo(watched);
+  }
+  watched_pixels = cv::countNonZero(watch_mask);
+}
@@ -0,0 +1,207 @@
+/**
+ * MotionModel.cpp
+ *
+ * A constant velocity Kalman filter for every tracked blob. Each track owns a fixed size state (position, velocity and
+ * their covariance) rather than a list of past positions, so predicting a track costs the same however long it has been
+ * followed. The states are kept as a struct of arrays and predict() advances all of them together in tight loops over
+ * contiguous floats, which the compiler vectorises.
+ *
+ * Tracks refer to their state through a slot. Every frame begin_frame() starts a fresh set of arrays and each surviving
+ * track carry()s its state across, so retired tracks simply stop being carried and the arrays stay dense without a free
+ * list. The two sets of arrays are swapped between frames, so the steady state does not allocate.
+ */
+
+#include <cmath>
+
+#include "MotionModel.hpp"
+
+/**
+ * Default constructor for MotionModel. Assumes detections jitter by around 2 pixels and vehicles change speed by
+ * around 1 pixel per frame.
+ */
+MotionModel::MotionModel()
+    : process_noise(1.0f),
+      measurement_noise(4.0f),
+      initial_velocity_variance(100.0f),
+      current(0) {}
+
+/**
+ * Constructor for MotionModel
+ * @param process_noise_ float  variance of the change in velocity between frames, in pixels^2 / frame^2
+ * @param measurement_noise_ float  variance of a detected blob centre about the true position, in pixels^2
+ * @param initial_velocity_variance_ float  how uncertain the velocity of a newly seen track is, in pixels^2 / frame^2
+ */
+MotionModel::MotionModel(float process_noise_, float measurement_noise_, float initial_velocity_variance_)
+    : process_noise(process_noise_),
+      measurement_noise(measurement_noise_),
+      initial_velocity_variance(initial_velocity_variance_),
+      current(0) {}
+
+const float &MotionModel::get_process_noise() const {
+  return process_noise;
+}
+
+void MotionModel::set_process_noise(const float process_noise_) {
+  process_noise = process_noise_;
+}
+
+const float &MotionModel::get_measurement_noise() const {
+  return measurement_noise;
+}
+
+void MotionModel::set_measurement_noise(const float measurement_noise_) {
+  measurement_noise = measurement_noise_;
+}
+
+const float &MotionModel::get_initial_velocity_variance() const {
+  return initial_velocity_variance;
+}
+
+void MotionModel::set_initial_velocity_variance(const float initial_velocity_variance_) {
+  initial_velocity_variance = initial_velocity_variance_;
+}
+
+/**
+ * Starts a new frame. The slots handed out during the previous frame remain valid for carry(), every other slot is
+ * invalidated.
+ */
+void MotionModel::begin_frame() {
+  current = 1 - current;
+  states[current].clear();
+}
+
+/**
+ * Copies a track's state from the previous frame into this frame
+ * @param slot int  the slot the track was given during the previous frame
+ * @return the track's slot for this frame, or -1 if the slot does not refer to a state from the previous frame
+ */
+int MotionModel::carry(int slot) {
+  const States &previous = states[1 - current];
+  if (slot < 0 || (size_t) slot >= previous.x.size()) {
+    return -1;
+  }
+  return (int) states[current].push_back(previous.x[slot], previous.y[slot], previous.vx[slot], previous.vy[slot],
+                                         previous.p_pos[slot], previous.p_cross[slot], previous.p_vel[slot]);
+}
+
+/**
+ * Starts following a new track in this frame
+ * @param position cv::Point    where the track was first seen
+ * @param velocity cv::Point    initial estimate of the velocity in pixels per frame, usually zero
+ * @return the track's slot for this frame
+ */
+int MotionModel::add(const cv::Point &position, const cv::Point &velocity) {
+  return (int) states[current].push_back((float) position.x, (float) position.y,
+                                         (float) velocity.x, (float) velocity.y,
+                                         measurement_noise, 0.0f, initial_velocity_variance);
+}
+
+/**
+ * Advances every track in this frame by one frame
+ */
+void MotionModel::predict() {
+  States &s = states[current];
+  const size_t count = s.x.size();
+  const float q_pos = process_noise * 0.25f;
+  const float q_cross = process_noise * 0.5f;
+  const float q_vel = process_noise;
+  float *x = s.x.data();
+  float *y = s.y.data();
+  const float *vx = s.vx.data();
+  const float *vy = s.vy.data();
+  float *p_pos = s.p_pos.data();
+  float *p_cross = s.p_cross.data();
+  float *p_vel = s.p_vel.data();
+
+  // Split in two so each loop touches few enough arrays for the compiler to vectorise it
+  for (size_t i = 0; i < count; i++) {
+    x[i] += vx[i];
+    y[i] += vy[i];
+  }
+  for (size_t i = 0; i < count; i++) {
+    p_pos[i] += 2.0f * p_cross[i] + p_vel[i] + q_pos;
+    p_cross[i] += p_vel[i] + q_cross;
+    p_vel[i] += q_vel;
+  }
+}
+
+/**
+ * Corrects a track's predicted state with the position it was detected at
+ * @param slot int  the track's slot for this frame
+ * @param measurement cv::Point     the centre of the blob matched to the track
+ */
+void MotionModel::correct(int slot, const cv::Point &measurement) {
+  States &s = states[current];
+  if (slot < 0 || (size_t) slot >= s.x.size()) {
+    return;
+  }
+  const float innovation_variance = s.p_pos[slot] + measurement_noise;
+  const float gain_pos = s.p_pos[slot] / innovation_variance;
+  const float gain_vel = s.p_cross[slot] / innovation_variance;
+  const float innovation_x = (float) measurement.x - s.x[slot];
+  const float innovation_y = (float) measurement.y - s.y[slot];
+
+  s.x[slot] += gain_pos * innovation_x;
+  s.y[slot] += gain_pos * innovation_y;
+  s.vx[slot] += gain_vel * innovation_x;
+  s.vy[slot] += gain_vel * innovation_y;
+
+  s.p_vel[slot] -= gain_vel * s.p_cross[slot];
+  s.p_cross[slot] *= 1.0f - gain_pos;
+  s.p_pos[slot] *= 1.0f - gain_pos;
+}
+
+/**
+ * Current position estimate of a track, rounded to the nearest pixel
+ * @param slot int  the track's slot for this frame
+ */
+cv::Point MotionModel::get_position(int slot) const {
+  const States &s = states[current];
+  return cv::Point((int) std::lround(s.x[slot]), (int) std::lround(s.y[slot]));
+}
+
+/**
+ * Current velocity estimate of a track in pixels per frame, rounded to the nearest pixel
+ * @param slot int  the track's slot for this frame
+ */
+cv::Point MotionModel::get_velocity(int slot) const {
+  const States &s = states[current];
+  return cv::Point((int) std::lround(s.vx[slot]), (int) std::lround(s.vy[slot]));
+}
+
+/**
+ * Number of tracks in this frame
+ */
+size_t MotionModel::size() const {
+  return states[current].x.size();
+}
+
+/**
+ * Forgets every track
+ */
+void MotionModel::clear() {
+  states[0].clear();
+  states[1].clear();
+}
+
+void MotionModel::States::clear() {
+  x.clear();
+  y.clear();
+  vx.clear();
+  vy.clear();
+  p_pos.clear();
+  p_cross.clear();
+  p_vel.clear();
+}
+
+size_t MotionModel::States::push_back(float x_, float y_, float vx_, float vy_,
+                                      float p_pos_, float p_cross_, float p_vel_) {
+  x.push_back(x_);
+  y.push_back(y_);
+  vx.push_back(vx_);
+  vy.push_back(vy_);
+  p_pos.push_back(p_pos_);
+  p_cross.push_back(p_cross_);
+  p_vel.push_back(p_vel_);
+  return x.size() - 1;
+}
@@ -0,0 +1,346 @@
+/**
+ * Profiler.cpp
+ *
+ * Each thread records into histograms of its own, so timing a stage costs two clock reads and a few uncontended atomic
+ * increments. The threads' histograms are only summed when a report is made. Trace events are likewise kept per thread
+ * and written out as a Chrome trace-event JSON file, which chrome://tracing and Perfetto open as a timeline of every
+ * stage on every thread.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+
+#include "Profiler.hpp"
+
+const unsigned int LatencyHistogram::BUCKETS;
+
+/**
+ * Duration at the given fraction of the recorded durations, to the precision of the bucket it falls in
+ * @param fraction double   0.5 for the median, 0.99 for the 99th percentile and so on. 1 gives the exact maximum.
+ * @return the duration in nanoseconds, or 0 when nothing was recorded
+ */
+uint64_t LatencySnapshot::percentile(double fraction) const {
+  if (count == 0) {
+    return 0;
+  }
+  if (fraction >= 1.0) {
+    return max;
+  }
+  const uint64_t rank = std::max<uint64_t>(1, (uint64_t) std::ceil(fraction * count));
+  uint64_t seen = 0;
+  for (unsigned int bucket = 0; bucket < counts.size(); bucket++) {
+    seen += counts[bucket];
+    if (seen >= rank) {
+      return std::min(LatencyHistogram::bucket_midpoint(bucket), max);
+    }
+  }
+  return max;
+}
+
+LatencyHistogram::LatencyHistogram() {
+  reset();
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+  counts[bucket_of(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+  total.fetch_add(nanoseconds, std::memory_order_relaxed);
+  uint64_t longest = max.load(std::memory_order_relaxed);
+  while (nanoseconds > longest && !max.compare_exchange_weak(longest, nanoseconds, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::reset() {
+  for (std::atomic<uint64_t> &bucket_count : counts) {
+    bucket_count.store(0, std::memory_order_relaxed);
+  }
+  total.store(0, std::memory_order_relaxed);
+  max.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Adds this histogram's counts to a snapshot, so the histograms of several threads can be summed
+ * @param snapshot LatencySnapshot  receives the counts. Sized to hold every bucket if it does not already.
+ */
+void LatencyHistogram::add_to(LatencySnapshot &snapshot) const {
+  snapshot.counts.resize(BUCKETS, 0);
+  for (unsigned int bucket = 0; bucket < BUCKETS; bucket++) {
+    const uint64_t bucket_count = counts[bucket].load(std::memory_order_relaxed);
+    snapshot.counts[bucket] += bucket_count;
+    snapshot.count += bucket_count;
+  }
+  snapshot.total += total.load(std::memory_order_relaxed);
+  snapshot.max = std::max(snapshot.max, max.load(std::memory_order_relaxed));
+}
+
+LatencySnapshot LatencyHistogram::snapshot() const {
+  LatencySnapshot copy;
+  add_to(copy);
+  return copy;
+}
+
+/**
+ * Durations below 8 ns have a bucket each. Above that, the three bits after the leading bit pick one of eight buckets
+ * within each power of two.
+ */
+unsigned int LatencyHistogram::bucket_of(uint64_t nanoseconds) {
+  if (nanoseconds < 8) {
+    return (unsigned int) nanoseconds;
+  }
+  const unsigned int leading_bit = 63 - (unsigned int) __builtin_clzll(nanoseconds);
+  const unsigned int sub_bucket = (unsigned int) (nanoseconds >> (leading_bit - 3)) & 7;
+  return std::min(BUCKETS - 1, (leading_bit - 2) * 8 + sub_bucket);
+}
+
+uint64_t LatencyHistogram::bucket_midpoint(unsigned int bucket) {
+  if (bucket < 8) {
+    return bucket;
+  }
+  const unsigned int shift = bucket / 8 - 1;
+  const uint64_t lower = (uint64_t) (8 + bucket % 8) << shift;
+  return lower + ((uint64_t) 1 << shift) / 2;
+}
+
+#ifdef TRAFFIC_MONITOR_PROFILE
+
+namespace {
+// Stages registered beyond this are not timed
+const unsigned int MAX_STAGES = 32;
+// Trace events kept per thread. Beyond this they are counted as dropped, bounding memory on long runs.
+const size_t TRACE_EVENT_LIMIT = 1 << 20;
+
+struct TraceEvent {
+  unsigned int stage;
+  uint64_t start;
+  uint64_t duration;
+};
+
+struct ThreadProfile {
+  unsigned int id = 0;
+  LatencyHistogram stages[MAX_STAGES];
+  // Guards the name and the trace events, which are only touched while tracing or reporting
+  std::mutex mutex;
+  std::string name;
+  std::vector<TraceEvent> events;
+  unsigned long long dropped_events = 0;
+};
+
+/**
+ * Every stage and every thread which has recorded a time. Threads' profiles are kept after the threads exit so that
+ * their times are still reported.
+ */
+struct Registry {
+  const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  std::atomic<bool> tracing{false};
+  std::mutex mutex;
+  std::vector<const char *> stage_names;
+  std::vector<std::unique_ptr<ThreadProfile>> threads;
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+thread_local ThreadProfile *current_thread = nullptr;
+
+ThreadProfile &thread_profile() {
+  if (current_thread == nullptr) {
+    Registry &profiler = registry();
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+    profiler.threads.emplace_back(new ThreadProfile());
+    current_thread = profiler.threads.back().get();
+    current_thread->id = (unsigned int) profiler.threads.size();
+  }
+  return *current_thread;
+}
+
+void write_json_string(std::FILE *file, const std::string &text) {
+  std::fputc('"', file);
+  for (char character : text) {
+    if (character == '"' || character == '\\') {
+      std::fputc('\\', file);
+    }
+    if ((unsigned char) character >= 0x20) {
+      std::fputc(character, file);
+    }
+  }
+  std::fputc('"', file);
+}
+}
+
+bool profiling_enabled() {
+  return true;
+}
+
+unsigned int profile_stage(const char *name) {
+  Registry &profiler = registry();
+  std::lock_guard<std::mutex> lock(profiler.mutex);
+  for (unsigned int stage = 0; stage < profiler.stage_names.size(); stage++) {
+    if (std::string(profiler.stage_names[stage]) == name) {
+      return stage;
+    }
+  }
+  if (profiler.stage_names.size() >= MAX_STAGES) {
+    return MAX_STAGES;
+  }
+  profiler.stage_names.push_back(name);
+  return (unsigned int) profiler.stage_names.size() - 1;
+}
+
+void profile_thread(const char *name) {
+  ThreadProfile &profile = thread_profile();
+  std::lock_guard<std::mutex> lock(profile.mutex);
+  profile.name = name;
+}
+
+uint64_t profile_now() {
+  return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - registry().epoch).count();
+}
+
+void profile_record(unsigned int stage, uint64_t start, uint64_t end) {
+  if (stage >= MAX_STAGES) {
+    return;
+  }
+  ThreadProfile &profile = thread_profile();
+  profile.stages[stage].record(end - start);
+  if (!registry().tracing.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(profile.mutex);
+  if (profile.events.size() < TRACE_EVENT_LIMIT) {
+    profile.events.push_back(TraceEvent{stage, start, end - start});
+  } else {
+    profile.dropped_events++;
+  }
+}
+
+void profile_reset() {
+  Registry &profiler = registry();
+  std::lock_guard<std::mutex> lock(profiler.mutex);
+  for (std::unique_ptr<ThreadProfile> &profile : profiler.threads) {
+    for (LatencyHistogram &histogram : profile->stages) {
+      histogram.reset();
+    }
+    std::lock_guard<std::mutex> events_lock(profile->mutex);
+    profile->events.clear();
+    profile->dropped_events = 0;
+  }
+}
+
+void profile_set_tracing(bool tracing) {
+  registry().tracing = tracing;
+}
+
+bool profile_is_tracing() {
+  return registry().tracing;
+}
+
+std::vector<StageSummary> profile_summaries() {
+  Registry &profiler = registry();
+  std::lock_guard<std::mutex> lock(profiler.mutex);
+  std::vector<StageSummary> summaries;
+  for (unsigned int stage = 0; stage < profiler.stage_names.size(); stage++) {
+    LatencySnapshot snapshot;
+    for (std::unique_ptr<ThreadProfile> &profile : profiler.threads) {
+      profile->stages[stage].add_to(snapshot);
+    }
+    if (snapshot.count == 0) {
+      continue;
+    }
+
+    StageSummary summary;
+    summary.name = profiler.stage_names[stage];
+    summary.count = snapshot.count;
+    summary.total = snapshot.total * 1e-9;
+    summary.p50 = snapshot.percentile(0.50) * 1e-9;
+    summary.p95 = snapshot.percentile(0.95) * 1e-9;
+    summary.p99 = snapshot.percentile(0.99) * 1e-9;
+    summary.max = snapshot.max * 1e-9;
+    summaries.push_back(summary);
+  }
+  return summaries;
+}
+
+/**
+ * Writes the trace events recorded since the last reset in Chrome's trace-event format, one complete event per timed
+ * stage, with times in microseconds since the profiler was first used
+ * @param path std::string  file to write, replacing any existing file
+ * @return false if the file could not be written
+ */
+bool profile_write_trace(const std::string &path) {
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+
+  Registry &profiler = registry();
+  std::lock_guard<std::mutex> lock(profiler.mutex);
+  const int pid = (int) ::getpid();
+  unsigned long long dropped_events = 0;
+  std::fprintf(file, "{\"traceEvents\":[\n");
+  std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"traffic-monitor\"}}",
+               pid);
+  for (std::unique_ptr<ThreadProfile> &profile : profiler.threads) {
+    std::lock_guard<std::mutex> events_lock(profile->mutex);
+    const std::string thread_name = profile->name.empty() ? "thread " + std::to_string(profile->id) : profile->name;
+    std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", pid,
+                 profile->id);
+    write_json_string(file, thread_name);
+    std::fprintf(file, "}}");
+
+    for (const TraceEvent &event : profile->events) {
+      std::fprintf(file, ",\n{\"name\":");
+      write_json_string(file, profiler.stage_names[event.stage]);
+      std::fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}", event.start / 1000.0,
+                   event.duration / 1000.0, pid, profile->id);
+    }
+    dropped_events += profile->dropped_events;
+  }
+  std::fprintf(file, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%llu}}\n", dropped_events);
+
+  const bool written = !std::ferror(file);
+  return std::fclose(file) == 0 && written;
+}
+
+#else
+
+bool profiling_enabled() {
+  return false;
+}
+
+unsigned int profile_stage(const char *) {
+  return 0;
+}
+
+void profile_thread(const char *) {}
+
+uint64_t profile_now() {
+  return 0;
+}
+
+void profile_record(unsigned int, uint64_t, uint64_t) {}
+
+void profile_reset() {}
+
+void profile_set_tracing(bool) {}
+
+bool profile_is_tracing() {
+  return false;
+}
+
+std::vector<StageSummary> profile_summaries() {
+  return std::vector<StageSummary>();
+}
+
+bool profile_write_trace(const std::string &) {
+  return false;
+}
+
+#endif
@@ -0,0 +1,222 @@
+/**
+ * QualityController.cpp
+ *
+ * Keeps the pipeline up with the camera when the board cannot afford full quality. The time each frame took to
+ * process is compared against the frame interval: once a smoothed average of it has stayed above degrade_load of the
+ * interval for degrade_frames frames, processing is degraded by one QualityLevel, and once it has stayed below
+ * recover_load for recover_frames frames it is restored by one. The gap between the two loads and the longer wait
+ * before recovering keep the level from flapping, since every degradation lowers the load it is measured by.
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#include "QualityController.hpp"
+
+/**
+ * Default constructor for QualityController. Expects 30 frames per second, degrades after 15 frames averaging over 90%
+ * of the frame interval and recovers after 90 frames averaging under 60%. The average moves a tenth of the way towards
+ * each new frame.
+ */
+QualityController::QualityController()
+    : frame_interval(1.0 / 30.0),
+      degrade_load(0.9),
+      recover_load(0.6),
+      degrade_frames(15),
+      recover_frames(90),
+      smoothing(0.1),
+      max_level(QualityLevel::SKIP_FRAMES),
+      level(QualityLevel::FULL),
+      average_seconds(0.0),
+      samples(0),
+      pressure_frames(0),
+      headroom_frames(0),
+      degradations(0),
+      recoveries(0) {}
+
+const double &QualityController::get_frame_interval() const {
+  return frame_interval;
+}
+
+/**
+ * Sets the time available to process each frame
+ * @param frame_interval_ double    seconds between frames, usually 1 / FPS
+ */
+void QualityController::set_frame_interval(const double frame_interval_) {
+  assert(frame_interval_ > 0.0);
+  frame_interval = frame_interval_;
+}
+
+const double &QualityController::get_degrade_load() const {
+  return degrade_load;
+}
+
+/**
+ * Sets the load above which processing is degraded
+ * @param degrade_load_ double  average processing time as a fraction of the frame interval
+ */
+void QualityController::set_degrade_load(const double degrade_load_) {
+  degrade_load = degrade_load_;
+}
+
+const double &QualityController::get_recover_load() const {
+  return recover_load;
+}
+
+/**
+ * Sets the load below which processing is restored. Should be well below the degrade load, as restoring a level raises
+ * the load again.
+ * @param recover_load_ double  average processing time as a fraction of the frame interval
+ */
+void QualityController::set_recover_load(const double recover_load_) {
+  recover_load = recover_load_;
+}
+
+const unsigned int &QualityController::get_degrade_frames() const {
+  return degrade_frames;
+}
+
+/**
+ * Sets how many frames in a row must be over the degrade load before each degradation
+ * @param degrade_frames_ unsigned int  number of frames, at least 1
+ */
+void QualityController::set_degrade_frames(const unsigned int degrade_frames_) {
+  degrade_frames = std::max(1u, degrade_frames_);
+}
+
+const unsigned int &QualityController::get_recover_frames() const {
+  return recover_frames;
+}
+
+/**
+ * Sets how many frames in a row must be under the recover load before each recovery
+ * @param recover_frames_ unsigned int  number of frames, at least 1
+ */
+void QualityController::set_recover_frames(const unsigned int recover_frames_) {
+  recover_frames = std::max(1u, recover_frames_);
+}
+
+const double &QualityController::get_smoothing() const {
+  return smoothing;
+}
+
+/**
+ * Sets how quickly the average processing time follows each new frame
+ * @param smoothing_ double     within (0, 1]. 1 uses the latest frame alone.
+ */
+void QualityController::set_smoothing(const double smoothing_) {
+  assert(smoothing_ > 0.0 && smoothing_ <= 1.0);
+  smoothing = smoothing_;
+}
+
+const QualityLevel &QualityController::get_max_level() const {
+  return max_level;
+}
+
+/**
+ * Sets the furthest processing may be degraded, e.g. NO_PREVIEW to never touch detection
+ * @param max_level_ QualityLevel   the lowest quality allowed
+ */
+void QualityController::set_max_level(const QualityLevel max_level_) {
+  max_level = max_level_;
+  level = std::min(level, max_level);
+}
+
+/**
+ * Records how long a frame took to process and moves the quality level when the load calls for it
+ * @param seconds double    processing time of the frame
+ * @return whether the level changed
+ */
+bool QualityController::record(const double seconds) {
+  average_seconds = samples++ == 0 ? seconds : average_seconds + smoothing * (seconds - average_seconds);
+
+  const double load = get_load();
+  if (load > degrade_load) {
+    pressure_frames++;
+    headroom_frames = 0;
+  } else if (load < recover_load) {
+    headroom_frames++;
+    pressure_frames = 0;
+  } else {
+    pressure_frames = 0;
+    headroom_frames = 0;
+  }
+
+  if (pressure_frames >= degrade_frames && level < max_level) {
+    level = static_cast<QualityLevel>(static_cast<int>(level) + 1);
+    degradations++;
+  } else if (headroom_frames >= recover_frames && level > QualityLevel::FULL) {
+    level = static_cast<QualityLevel>(static_cast<int>(level) - 1);
+    recoveries++;
+  } else {
+    return false;
+  }
+
+  // Each step is judged afresh on the frames processed after it
+  pressure_frames = 0;
+  headroom_frames = 0;
+  return true;
+}
+
+/**
+ * Restores full quality, forgets the measured times and clears the metrics
+ */
+void QualityController::reset() {
+  level = QualityLevel::FULL;
+  average_seconds = 0.0;
+  samples = 0;
+  pressure_frames = 0;
+  headroom_frames = 0;
+  degradations = 0;
+  recoveries = 0;
+}
+
+const QualityLevel &QualityController::get_level() const {
+  return level;
+}
+
+/**
+ * Smoothed processing time per frame, in seconds
+ */
+const double &QualityController::get_average_seconds() const {
+  return average_seconds;
+}
+
+/**
+ * Smoothed processing time as a fraction of the frame interval. Above 1 the pipeline is falling behind.
+ */
+double QualityController::get_load() const {
+  return average_seconds / frame_interval;
+}
+
+/**
+ * Number of times processing has been degraded since the controller was created or reset
+ */
+const unsigned long long &QualityController::get_degradations() const {
+  return degradations;
+}
+
+/**
+ * Number of times processing has been restored since the controller was created or reset
+ */
+const unsigned long long &QualityController::get_recoveries() const {
+  return recoveries;
+}
+
+/**
+ * Printable name of a quality level, for logs
+ */
+const char *QualityController::level_name(QualityLevel level) {
+  switch (level) {
+    case QualityLevel::NO_PREVIEW:
+      return "no-preview";
+    case QualityLevel::REDUCED_RESOLUTION:
+      return "reduced-resolution";
+    case QualityLevel::SPARSE_BACKGROUND:
+      return "sparse-background";
+    case QualityLevel::SKIP_FRAMES:
+      return "skip-frames";
+    default:
+      return "full";
+  }
+}
@@ -0,0 +1,123 @@
+/**
+ * RegionOfInterest.cpp
+ *
+ * Restricts processing to the road. Work is done within the bounding box of the polygons only, and a mask of the
+ * polygons within that box marks which of its pixels count, so the cost of a frame follows the area of the region
+ * rather than the area of the frame.
+ */
+
+#include "RegionOfInterest.hpp"
+
+/**
+ * Default constructor for RegionOfInterest. Covers the whole frame.
+ */
+RegionOfInterest::RegionOfInterest()
+    : prepared(false),
+      rectangular(true) {}
+
+/**
+ * Constructor for RegionOfInterest
+ * @param polygons_ std::vector<std::vector<cv::Point>>    polygons in frame coordinates. A pixel is within the region
+ * when it is within any of them.
+ */
+RegionOfInterest::RegionOfInterest(const std::vector<std::vector<cv::Point>> &polygons_)
+    : polygons(polygons_),
+      prepared(false),
+      rectangular(true) {}
+
+const std::vector<std::vector<cv::Point>> &RegionOfInterest::get_polygons() const {
+  return polygons;
+}
+
+void RegionOfInterest::set_polygons(const std::vector<std::vector<cv::Point>> &polygons_) {
+  polygons = polygons_;
+  prepared = false;
+}
+
+/**
+ * Adds a polygon to the region
+ * @param polygon std::vector<cv::Point>   at least three vertices in frame coordinates
+ */
+void RegionOfInterest::add_polygon(const std::vector<cv::Point> &polygon) {
+  polygons.push_back(polygon);
+  prepared = false;
+}
+
+/**
+ * Whether the region is empty, and so covers the whole frame
+ */
+bool RegionOfInterest::empty() const {
+  return polygons.empty();
+}
+
+/**
+ * The same region in the coordinates of a resized frame
+ * @param scale double  size of the resized frame relative to the frame the polygons were drawn on
+ */
+RegionOfInterest RegionOfInterest::scaled(double scale) const {
+  std::vector<std::vector<cv::Point>> scaled_polygons(polygons);
+  for (std::vector<cv::Point> &polygon : scaled_polygons) {
+    for (cv::Point &vertex : polygon) {
+      vertex.x = cvRound(vertex.x * scale);
+      vertex.y = cvRound(vertex.y * scale);
+    }
+  }
+  return RegionOfInterest(scaled_polygons);
+}
+
+/**
+ * Computes the bounding box and the mask of the polygons for frames of the given size. Does nothing when they are
+ * already prepared for this size.
+ * @param frame_size_ cv::Size  size of the frames the region will be applied to
+ */
+void RegionOfInterest::prepare(const cv::Size &frame_size_) {
+  if (prepared && frame_size == frame_size_) {
+    return;
+  }
+  frame_size = frame_size_;
+  prepared = true;
+
+  const cv::Rect frame_rect(cv::Point(0, 0), frame_size);
+  if (polygons.empty()) {
+    bounding_rect = frame_rect;
+    mask.release();
+    rectangular = true;
+    return;
+  }
+
+  bounding_rect = cv::boundingRect(polygons.front());
+  for (size_t i = 1; i < polygons.size(); i++) {
+    bounding_rect |= cv::boundingRect(polygons[i]);
+  }
+  bounding_rect &= frame_rect;
+
+  mask = cv::Mat::zeros(bounding_rect.size(), CV_8UC1);
+  if (bounding_rect.area() > 0) {
+    cv::fillPoly(mask, polygons, cv::Scalar(255), cv::LINE_8, 0, cv::Point(-bounding_rect.x, -bounding_rect.y));
+  }
+  // A single axis aligned rectangle needs no masking beyond the crop
+  rectangular = cv::countNonZero(mask) == bounding_rect.area();
+}
+
+/**
+ * Bounding box of the polygons clipped to the frame, as computed by the last call to prepare(). The whole frame when
+ * the region is empty; an empty rectangle when the polygons lie outside the frame.
+ */
+const cv::Rect &RegionOfInterest::get_bounding_rect() const {
+  return bounding_rect;
+}
+
+/**
+ * Mask of the polygons within the bounding box, where 255 marks pixels inside the region, as computed by the last call
+ * to prepare(). Empty when the region is empty.
+ */
+const cv::Mat &RegionOfInterest::get_mask() const {
+  return mask;
+}
+
+/**
+ * Whether every pixel of the bounding box is inside the region, so that cropping to it is enough
+ */
+bool RegionOfInterest::is_rectangular() const {
+  return rectangular;
+}
@@ -0,0 +1,200 @@
+/**
+ * SnapshotWriter.cpp
+ *
+ * Encodes the image of each timed vehicle on a small pool of worker threads, so a platoon of vehicles leaving the
+ * calibration region together does not hold up the tracking thread with one JPEG encode after another. submit() copies
+ * the vehicle out of the frame and queues the copy without waiting. When the workers have fallen behind and the queue
+ * is full the snapshot is dropped and counted instead.
+ */
+
+#include <algorithm>
+
+#include "SnapshotWriter.hpp"
+
+/**
+ * Default constructor for SnapshotWriter. Writes into data/tracked_cars/ with two workers and up to eight waiting
+ * snapshots, at JPEG quality 90 and full size.
+ */
+SnapshotWriter::SnapshotWriter()
+    : directory("data/tracked_cars/"),
+      workers(2),
+      capacity(8),
+      jpeg_quality(90),
+      max_dimension(0),
+      written(0),
+      dropped(0),
+      failed(0) {}
+
+SnapshotWriter::~SnapshotWriter() {
+  close();
+}
+
+const std::string &SnapshotWriter::get_directory() const {
+  return directory;
+}
+
+/**
+ * Sets where snapshots are written. Each is named after its vehicle, e.g. 12.jpg.
+ * @param directory_ std::string    path of an existing directory, including the trailing separator
+ */
+void SnapshotWriter::set_directory(const std::string &directory_) {
+  directory = directory_;
+}
+
+const unsigned int &SnapshotWriter::get_workers() const {
+  return workers;
+}
+
+/**
+ * Sets how many snapshots may be encoded at once
+ * @param workers_ unsigned int     number of worker threads, at least 1. Takes effect the next time the writer is opened.
+ */
+void SnapshotWriter::set_workers(const unsigned int workers_) {
+  workers = std::max(1u, workers_);
+}
+
+const size_t &SnapshotWriter::get_capacity() const {
+  return capacity;
+}
+
+/**
+ * Sets how many snapshots may wait for a worker before further snapshots are dropped
+ * @param capacity_ size_t  number of snapshots. Takes effect the next time the writer is opened.
+ */
+void SnapshotWriter::set_capacity(const size_t capacity_) {
+  capacity = capacity_;
+}
+
+const int &SnapshotWriter::get_jpeg_quality() const {
+  return jpeg_quality;
+}
+
+/**
+ * Sets the JPEG quality of the snapshots
+ * @param jpeg_quality_ int     within [0, 100]
+ */
+void SnapshotWriter::set_jpeg_quality(const int jpeg_quality_) {
+  jpeg_quality = std::min(100, std::max(0, jpeg_quality_));
+}
+
+const int &SnapshotWriter::get_max_dimension() const {
+  return max_dimension;
+}
+
+/**
+ * Sets the largest width or height a snapshot is written at. Larger vehicles are scaled down to fit, keeping their
+ * aspect ratio.
+ * @param max_dimension_ int    pixels. 0 writes every snapshot at the size it was captured.
+ */
+void SnapshotWriter::set_max_dimension(const int max_dimension_) {
+  max_dimension = std::max(0, max_dimension_);
+}
+
+/**
+ * Starts the worker threads
+ */
+void SnapshotWriter::open() {
+  close();
+
+  written = 0;
+  dropped = 0;
+  failed = 0;
+  queue.reset(new BoundedQueue<Snapshot>(capacity));
+  for (unsigned int i = 0; i < workers; i++) {
+    threads.emplace_back(&SnapshotWriter::encode_loop, this);
+  }
+}
+
+/**
+ * Copies a vehicle out of a frame and queues it for encoding without waiting. Safe to call from any thread while the
+ * writer is open.
+ * @param frame cv::Mat     the frame the vehicle was seen in. Not referenced once this returns.
+ * @param rect cv::Rect     the vehicle's bounding box, clipped to the frame
+ * @param vehicle_id unsigned int   names the file
+ * @return false if the writer is not open, the box lies outside the frame, or the queue is full and the snapshot was
+ * dropped
+ */
+bool SnapshotWriter::submit(const cv::Mat &frame, const cv::Rect &rect, unsigned int vehicle_id) {
+  if (!queue) {
+    return false;
+  }
+  const cv::Rect clipped = rect & cv::Rect(0, 0, frame.cols, frame.rows);
+  if (clipped.area() <= 0) {
+    return false;
+  }
+
+  Snapshot snapshot;
+  snapshot.image = frame(clipped).clone();
+  snapshot.vehicle_id = vehicle_id;
+  if (!queue->try_push(snapshot)) {
+    dropped++;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Encodes every queued snapshot and stops the workers
+ */
+void SnapshotWriter::close() {
+  if (!queue) {
+    return;
+  }
+  queue->close();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  queue.reset();
+}
+
+bool SnapshotWriter::is_open() const {
+  return queue != nullptr;
+}
+
+/**
+ * Number of snapshots written since the writer was opened
+ */
+unsigned long long SnapshotWriter::get_written() const {
+  return written;
+}
+
+/**
+ * Number of snapshots dropped since the writer was opened because the workers had fallen behind
+ */
+unsigned long long SnapshotWriter::get_dropped() const {
+  return dropped;
+}
+
+/**
+ * Number of snapshots which could not be encoded or written since the writer was opened
+ */
+unsigned long long SnapshotWriter::get_failed() const {
+  return failed;
+}
+
+/**
+ * Body of each worker thread. Encodes snapshots until the queue is closed and drained.
+ */
+void SnapshotWriter::encode_loop() {
+  const std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, jpeg_quality};
+  cv::Mat scaled;
+  Snapshot snapshot;
+  while (queue->pop(snapshot)) {
+    const cv::Mat *image = &snapshot.image;
+    const int largest = std::max(image->cols, image->rows);
+    if (max_dimension > 0 && largest > max_dimension) {
+      const double scale = max_dimension / (double) largest;
+      cv::resize(*image, scaled, cv::Size(std::max(1, cvRound(image->cols * scale)),
+                                          std::max(1, cvRound(image->rows * scale))), 0, 0, cv::INTER_AREA);
+      image = &scaled;
+    }
+
+    const std::string path = directory + std::to_string(snapshot.vehicle_id) + ".jpg";
+    if (cv::imwrite(path, *image, params)) {
+      written++;
+    } else {
+      failed++;
+    }
+  }
+}
@@ -0,0 +1,165 @@
+/**
+ * SpatialGrid.cpp
+ *
+ * A uniform grid over the plane used to find the tracked blobs near a point without comparing against every blob. Points
+ * are bucketed by the grid cell they fall in and the buckets are stored sorted by cell, so building the grid is a single
+ * sort and a query only inspects the cells which overlap its search radius. The entry storage is reused between frames.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "SpatialGrid.hpp"
+
+/**
+ * Default constructor for SpatialGrid. Uses 64 pixel cells.
+ */
+SpatialGrid::SpatialGrid()
+    : cell_size(64) {}
+
+/**
+ * Constructor for SpatialGrid
+ * @param cell_size_ int    width and height of each cell in pixels. Queries are cheapest when this is close to the
+ * typical search radius.
+ */
+SpatialGrid::SpatialGrid(int cell_size_)
+    : cell_size(cell_size_ > 0 ? cell_size_ : 1) {}
+
+const int &SpatialGrid::get_cell_size() const {
+  return cell_size;
+}
+
+/**
+ * Changes the cell size. Must be followed by clear() and re-inserting the points.
+ * @param cell_size_ int    width and height of each cell in pixels
+ */
+void SpatialGrid::set_cell_size(const int cell_size_) {
+  cell_size = cell_size_ > 0 ? cell_size_ : 1;
+}
+
+/**
+ * Removes every point from the grid while keeping the allocated storage
+ */
+void SpatialGrid::clear() {
+  entries.clear();
+}
+
+/**
+ * Adds a point to the grid. build() must be called once every point has been inserted and before querying.
+ * @param point cv::Point   location of the point
+ * @param index int     identifier returned by the queries, typically the index of the blob the point belongs to
+ */
+void SpatialGrid::insert(const cv::Point &point, int index) {
+  Entry entry;
+  entry.key = key_of(cell_of(point.x), cell_of(point.y));
+  entry.point = point;
+  entry.index = index;
+  entries.push_back(entry);
+}
+
+/**
+ * Sorts the inserted points by cell so they can be queried
+ */
+void SpatialGrid::build() {
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+    return a.key < b.key || (a.key == b.key && a.index < b.index);
+  });
+}
+
+/**
+ * Finds the closest point which is strictly within the given radius. Ties are resolved in favour of the lowest index,
+ * matching a linear scan over the points in index order.
+ * @param point cv::Point   centre of the search
+ * @param radius double     search radius in pixels
+ * @return the index of the closest point, or -1 if no point is within the radius
+ */
+int SpatialGrid::find_nearest(const cv::Point &point, double radius) const {
+  const double radius_squared = radius * radius;
+  const int reach = (int) std::ceil(radius);
+  const int min_cell_x = cell_of(point.x - reach);
+  const int max_cell_x = cell_of(point.x + reach);
+  const int min_cell_y = cell_of(point.y - reach);
+  const int max_cell_y = cell_of(point.y + reach);
+
+  int nearest_index = -1;
+  long long nearest_distance = 0;
+  for (int cell_y = min_cell_y; cell_y <= max_cell_y; cell_y++) {
+    for (int cell_x = min_cell_x; cell_x <= max_cell_x; cell_x++) {
+      auto range = cell_range(cell_x, cell_y);
+      for (auto it = range.first; it != range.second; ++it) {
+        long long distance = squared_distance(point, it->point);
+        if ((double) distance >= radius_squared) {
+          continue;
+        }
+        if (nearest_index < 0 || distance < nearest_distance ||
+            (distance == nearest_distance && it->index < nearest_index)) {
+          nearest_index = it->index;
+          nearest_distance = distance;
+        }
+      }
+    }
+  }
+  return nearest_index;
+}
+
+/**
+ * Collects every point which is strictly within the given radius
+ * @param point cv::Point   centre of the search
+ * @param radius double     search radius in pixels
+ * @param indices std::vector<int>  receives the indices of the points found, in no particular order
+ */
+void SpatialGrid::find_within(const cv::Point &point, double radius, std::vector<int> &indices) const {
+  const double radius_squared = radius * radius;
+  const int reach = (int) std::ceil(radius);
+  const int min_cell_x = cell_of(point.x - reach);
+  const int max_cell_x = cell_of(point.x + reach);
+  const int min_cell_y = cell_of(point.y - reach);
+  const int max_cell_y = cell_of(point.y + reach);
+
+  indices.clear();
+  for (int cell_y = min_cell_y; cell_y <= max_cell_y; cell_y++) {
+    for (int cell_x = min_cell_x; cell_x <= max_cell_x; cell_x++) {
+      auto range = cell_range(cell_x, cell_y);
+      for (auto it = range.first; it != range.second; ++it) {
+        if ((double) squared_distance(point, it->point) < radius_squared) {
+          indices.push_back(it->index);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Squared euclidian distance between two points. Cheaper than the true distance and sufficient for comparisons.
+ */
+long long SpatialGrid::squared_distance(const cv::Point &point1, const cv::Point &point2) {
+  long long dx = (long long) point1.x - point2.x;
+  long long dy = (long long) point1.y - point2.y;
+  return dx * dx + dy * dy;
+}
+
+int SpatialGrid::cell_of(int coordinate) const {
+  // Round towards negative infinity so predictions which fall off the frame still land in the correct cell
+  int cell = coordinate / cell_size;
+  if (coordinate % cell_size != 0 && coordinate < 0) {
+    cell--;
+  }
+  return cell;
+}
+
+uint64_t SpatialGrid::key_of(int cell_x, int cell_y) {
+  return ((uint64_t) (uint32_t) cell_y << 32) | (uint64_t) (uint32_t) cell_x;
+}
+
+std::pair<std::vector<SpatialGrid::Entry>::const_iterator,
+          std::vector<SpatialGrid::Entry>::const_iterator> SpatialGrid::cell_range(int cell_x, int cell_y) const {
+  const uint64_t key = key_of(cell_x, cell_y);
+  auto first = std::lower_bound(entries.begin(), entries.end(), key, [](const Entry &entry, uint64_t value) {
+    return entry.key < value;
+  });
+  auto last = first;
+  while (last != entries.end() && last->key == key) {
+    ++last;
+  }
+  return std::make_pair(first, last);
+}
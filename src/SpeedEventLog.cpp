@@ -0,0 +1,314 @@
+/**
+ * SpeedEventLog.cpp
+ *
+ * Records every timed vehicle without touching storage on the frame processing threads. log() only copies the event
+ * into a bounded queue, dropping it if the queue is full. A writer thread formats the events and writes them in
+ * batches, once flush_count events are waiting or flush_interval seconds after the first of them arrived, with a
+ * single write() per batch into a file which stays open for the whole run.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "SpeedEventLog.hpp"
+
+namespace {
+const char *CSV_HEADER = "vehicle_id,start_time,end_time,start_frame,end_frame,direction,speed_kmh,speed_error_kmh\n";
+}
+
+/**
+ * Default constructor for SpeedEventLog. Appends text lines to data/tracked_cars/speed.log, holds up to 256 events,
+ * writes every 32 events or after a second, and syncs to storage when closed.
+ */
+SpeedEventLog::SpeedEventLog()
+    : path("data/tracked_cars/speed.log"),
+      format(SpeedLogFormat::TEXT),
+      capacity(256),
+      flush_interval(1.0),
+      flush_count(32),
+      sync_policy(SyncPolicy::ON_CLOSE),
+      fd(-1),
+      written(0),
+      dropped(0),
+      flushes(0) {}
+
+SpeedEventLog::~SpeedEventLog() {
+  close();
+}
+
+const std::string &SpeedEventLog::get_path() const {
+  return path;
+}
+
+/**
+ * Sets the file the log appends to. Takes effect the next time the log is opened.
+ * @param path_ std::string     path of the log file. Its directory must exist.
+ */
+void SpeedEventLog::set_path(const std::string &path_) {
+  path = path_;
+}
+
+const SpeedLogFormat &SpeedEventLog::get_format() const {
+  return format;
+}
+
+/**
+ * Sets the layout of the log. See SpeedLogFormat.
+ * @param format_ SpeedLogFormat    takes effect the next time the log is opened
+ */
+void SpeedEventLog::set_format(const SpeedLogFormat format_) {
+  format = format_;
+}
+
+const size_t &SpeedEventLog::get_capacity() const {
+  return capacity;
+}
+
+/**
+ * Sets how many events may wait for the writer before further events are dropped
+ * @param capacity_ size_t  number of events. Takes effect the next time the log is opened.
+ */
+void SpeedEventLog::set_capacity(const size_t capacity_) {
+  capacity = capacity_;
+}
+
+const double &SpeedEventLog::get_flush_interval() const {
+  return flush_interval;
+}
+
+/**
+ * Sets the longest an event waits before it is written
+ * @param flush_interval_ double    seconds
+ */
+void SpeedEventLog::set_flush_interval(const double flush_interval_) {
+  flush_interval = flush_interval_;
+}
+
+const unsigned int &SpeedEventLog::get_flush_count() const {
+  return flush_count;
+}
+
+/**
+ * Sets how many waiting events are written at once without waiting for the flush interval
+ * @param flush_count_ unsigned int     number of events, at least 1
+ */
+void SpeedEventLog::set_flush_count(const unsigned int flush_count_) {
+  flush_count = flush_count_ > 0 ? flush_count_ : 1;
+}
+
+const SyncPolicy &SpeedEventLog::get_sync_policy() const {
+  return sync_policy;
+}
+
+/**
+ * Sets when the log is forced to storage. See SyncPolicy.
+ * @param sync_policy_ SyncPolicy   takes effect the next time the log is opened
+ */
+void SpeedEventLog::set_sync_policy(const SyncPolicy sync_policy_) {
+  sync_policy = sync_policy_;
+}
+
+/**
+ * Opens the log file for appending and starts the writer thread. A CSV header is written to a new or empty file.
+ * @return false if the file could not be opened
+ */
+bool SpeedEventLog::open() {
+  close();
+
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  if (format == SpeedLogFormat::CSV && ::lseek(fd, 0, SEEK_END) == 0) {
+    write_batch(CSV_HEADER);
+  }
+
+  written = 0;
+  dropped = 0;
+  flushes = 0;
+  queue.reset(new BoundedQueue<SpeedEvent>(capacity));
+  writer = std::thread(&SpeedEventLog::write_loop, this);
+  return true;
+}
+
+/**
+ * Queues an event for the writer without waiting. Safe to call from any thread while the log is open.
+ * @param event SpeedEvent  the timed vehicle
+ * @return false if the log is not open, or the event was dropped because the queue is full
+ */
+bool SpeedEventLog::log(const SpeedEvent &event) {
+  if (!queue) {
+    return false;
+  }
+  SpeedEvent queued = event;
+  if (!queue->try_push(queued)) {
+    dropped++;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Writes every queued event, syncs the file as the policy requires and stops the writer thread
+ */
+void SpeedEventLog::close() {
+  if (!queue) {
+    return;
+  }
+  queue->close();
+  writer.join();
+  queue.reset();
+
+  if (sync_policy != SyncPolicy::NEVER) {
+    ::fsync(fd);
+  }
+  ::close(fd);
+  fd = -1;
+}
+
+bool SpeedEventLog::is_open() const {
+  return queue != nullptr;
+}
+
+/**
+ * Number of events written to the file since the log was opened
+ */
+unsigned long long SpeedEventLog::get_written() const {
+  return written;
+}
+
+/**
+ * Number of events dropped since the log was opened because the writer had fallen behind
+ */
+unsigned long long SpeedEventLog::get_dropped() const {
+  return dropped;
+}
+
+/**
+ * Number of batches written since the log was opened
+ */
+unsigned long long SpeedEventLog::get_flushes() const {
+  return flushes;
+}
+
+/**
+ * Appends one event to a string in the given format, including the line break
+ * @param event SpeedEvent  the timed vehicle
+ * @param format SpeedLogFormat     layout of the line
+ * @param output std::string    the line is appended to it
+ */
+void SpeedEventLog::format_event(const SpeedEvent &event, SpeedLogFormat format, std::string &output) {
+  char line[256];
+  const char *direction = event.moving_left ? "left" : "right";
+  int length;
+  switch (format) {
+    case SpeedLogFormat::CSV:
+      length = std::snprintf(line, sizeof(line), "%u,%.3f,%.3f,%u,%u,%s,%.2f,%.2f\n", event.vehicle_id,
+                             event.start_time, event.end_time, event.start_frame, event.end_frame, direction,
+                             event.speed, event.speed_error);
+      break;
+    case SpeedLogFormat::JSON_LINES:
+      length = std::snprintf(line, sizeof(line),
+                             "{\"vehicle_id\":%u,\"start_time\":%.3f,\"end_time\":%.3f,\"start_frame\":%u,"
+                             "\"end_frame\":%u,\"direction\":\"%s\",\"speed_kmh\":%.2f,\"speed_error_kmh\":%.2f}\n",
+                             event.vehicle_id, event.start_time, event.end_time, event.start_frame, event.end_frame,
+                             direction, event.speed, event.speed_error);
+      break;
+    default:
+      // %g matches the default formatting of an std::ostream, which the text log was written with
+      length = std::snprintf(line, sizeof(line), "%u %g\n", event.vehicle_id, event.speed);
+      break;
+  }
+  if (length > 0) {
+    output.append(line, std::min((size_t) length, sizeof(line) - 1));
+  }
+}
+
+/**
+ * Looks up a format by the name used on the command line: text, csv or jsonl
+ * @param name std::string  the name
+ * @param format SpeedLogFormat     receives the format
+ * @return false if the name is not recognised
+ */
+bool SpeedEventLog::parse_format(const std::string &name, SpeedLogFormat &format) {
+  if (name == "text") {
+    format = SpeedLogFormat::TEXT;
+  } else if (name == "csv") {
+    format = SpeedLogFormat::CSV;
+  } else if (name == "jsonl") {
+    format = SpeedLogFormat::JSON_LINES;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Body of the writer thread. Gathers events into a batch until it is due and writes it, until the queue is closed and
+ * drained.
+ */
+void SpeedEventLog::write_loop() {
+  std::string batch;
+  unsigned int pending = 0;
+  std::chrono::steady_clock::time_point due;
+  SpeedEvent event;
+
+  while (true) {
+    bool popped;
+    if (pending == 0) {
+      popped = queue->pop(event);
+      due = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(flush_interval));
+    } else {
+      popped = queue->pop_for(event, due - std::chrono::steady_clock::now());
+    }
+
+    if (popped) {
+      format_event(event, format, batch);
+      pending++;
+    } else if (queue->is_closed()) {
+      break;
+    }
+
+    if (pending > 0 && (pending >= flush_count || std::chrono::steady_clock::now() >= due)) {
+      if (write_batch(batch)) {
+        written += pending;
+      }
+      batch.clear();
+      pending = 0;
+    }
+  }
+
+  if (pending > 0 && write_batch(batch)) {
+    written += pending;
+  }
+}
+
+/**
+ * Writes a batch to the file in full, syncing it if the policy asks for it
+ * @param batch std::string     formatted lines
+ * @return false if the write failed
+ */
+bool SpeedEventLog::write_batch(const std::string &batch) {
+  const char *data = batch.data();
+  size_t remaining = batch.size();
+  while (remaining > 0) {
+    const ssize_t count = ::write(fd, data, remaining);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += count;
+    remaining -= (size_t) count;
+  }
+  if (sync_policy == SyncPolicy::ON_FLUSH) {
+    ::fsync(fd);
+  }
+  flushes++;
+  return true;
+}
@@ -0,0 +1,104 @@
+/**
+ * SpeedFit.cpp
+ *
+ * A least squares fit of position against time, updated in constant time per sample. The tracker feeds it every
+ * position of a vehicle within the calibration region, so the speed is estimated from the whole pass rather than the
+ * two frames on which it entered and left, and the scatter of the positions about the fitted line shows how much the
+ * estimate can be trusted.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "SpeedFit.hpp"
+
+SpeedFit::SpeedFit() {
+  reset();
+}
+
+/**
+ * Adds a sample to the fit
+ * @param time double   when the position was observed, in seconds
+ * @param position double   where the vehicle was, in pixels along the road
+ */
+void SpeedFit::add(const double time, const double position) {
+  if (samples == 0) {
+    time_origin = time;
+    position_origin = position;
+  }
+  const double t = time - time_origin;
+  const double x = position - position_origin;
+  samples++;
+  sum_time += t;
+  sum_position += x;
+  sum_time_squared += t * t;
+  sum_time_position += t * x;
+  sum_position_squared += x * x;
+}
+
+/**
+ * Forgets every sample
+ */
+void SpeedFit::reset() {
+  samples = 0;
+  time_origin = 0.0;
+  position_origin = 0.0;
+  sum_time = 0.0;
+  sum_position = 0.0;
+  sum_time_squared = 0.0;
+  sum_time_position = 0.0;
+  sum_position_squared = 0.0;
+}
+
+/**
+ * Number of samples in the fit
+ */
+const unsigned int &SpeedFit::get_samples() const {
+  return samples;
+}
+
+/**
+ * Whether the fit is determined and has a residual to judge it by: at least three samples at two or more times
+ */
+bool SpeedFit::is_valid() const {
+  return samples >= 3 && samples * sum_time_squared - sum_time * sum_time > 0.0;
+}
+
+/**
+ * Fitted rate of change of the position, in pixels per second. Negative when the position decreases.
+ */
+double SpeedFit::get_slope() const {
+  const double denominator = samples * sum_time_squared - sum_time * sum_time;
+  if (samples < 2 || denominator <= 0.0) {
+    return 0.0;
+  }
+  return (samples * sum_time_position - sum_time * sum_position) / denominator;
+}
+
+/**
+ * Standard error of the slope, in pixels per second
+ */
+double SpeedFit::get_slope_error() const {
+  if (!is_valid()) {
+    return 0.0;
+  }
+  const double time_spread = sum_time_squared - sum_time * sum_time / samples;
+  return std::sqrt(residual_sum_of_squares() / (samples - 2) / time_spread);
+}
+
+/**
+ * Root mean square distance of the samples from the fitted line, in pixels
+ */
+double SpeedFit::get_residual() const {
+  if (samples == 0) {
+    return 0.0;
+  }
+  return std::sqrt(residual_sum_of_squares() / samples);
+}
+
+double SpeedFit::residual_sum_of_squares() const {
+  const double position_spread = sum_position_squared - sum_position * sum_position / samples;
+  const double covariance = sum_time_position - sum_time * sum_position / samples;
+  // Rounding can leave a perfect fit fractionally below zero
+  return std::max(0.0, position_spread - get_slope() * covariance);
+}
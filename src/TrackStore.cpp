@@ -0,0 +1,129 @@
+/**
+ * TrackStore.cpp
+ *
+ * Owns every blob which is currently being tracked. Blobs which have stopped being tracked are retired from the store
+ * once per frame and the position history kept for each blob is capped, so the memory used and the time spent scanning
+ * the blobs each frame is proportional to the number of vehicles currently in view rather than to the length of the
+ * run.
+ */
+
+#include <algorithm>
+
+#include "TrackStore.hpp"
+
+/**
+ * Default constructor for TrackStore. Keeps the last 2 positions of each blob, which is all that line crossing needs,
+ * and at most 16 MiB of tracks.
+ */
+TrackStore::TrackStore()
+    : max_history(2),
+      memory_ceiling(16 * 1024 * 1024),
+      retired_count(0) {}
+
+/**
+ * Constructor for TrackStore
+ * @param max_history_ number of centre positions to keep for each blob. The tracker predicts from its MotionModel
+ * rather than the history, but line crossing and speed tracking need at least the last 2 positions.
+ * @param memory_ceiling_ approximate number of bytes the live tracks may use before the stalest are retired early
+ */
+TrackStore::TrackStore(size_t max_history_, size_t memory_ceiling_)
+    : max_history(max_history_),
+      memory_ceiling(memory_ceiling_),
+      retired_count(0) {}
+
+std::vector<Blob> &TrackStore::get_blobs() {
+  return blobs;
+}
+
+const std::vector<Blob> &TrackStore::get_blobs() const {
+  return blobs;
+}
+
+const size_t &TrackStore::get_max_history() const {
+  return max_history;
+}
+
+void TrackStore::set_max_history(const size_t max_history_) {
+  max_history = max_history_;
+}
+
+const size_t &TrackStore::get_memory_ceiling() const {
+  return memory_ceiling;
+}
+
+void TrackStore::set_memory_ceiling(const size_t memory_ceiling_) {
+  memory_ceiling = memory_ceiling_;
+}
+
+/**
+ * Total number of blobs which have been retired from the store since it was created
+ */
+const unsigned long long &TrackStore::get_retired_count() const {
+  return retired_count;
+}
+
+/**
+ * Retires every blob which is no longer being tracked, trims the position history of the remaining blobs and, if the
+ * store is still above its memory ceiling, retires the blobs which have gone the longest without a match. Call once per
+ * frame after the tracker has finished with the blobs.
+ * @return the number of blobs retired
+ */
+size_t TrackStore::compact() {
+  const size_t initial_size = blobs.size();
+
+  blobs.erase(std::remove_if(blobs.begin(), blobs.end(), [](const Blob &blob) {
+    return !blob.blnStillBeingTracked;
+  }), blobs.end());
+
+  size_t total_memory = 0;
+  for (Blob &blob : blobs) {
+    if (max_history > 0 && blob.centerPositions.size() > max_history) {
+      blob.centerPositions.erase(blob.centerPositions.begin(), blob.centerPositions.end() - max_history);
+    }
+    total_memory += estimated_memory(blob);
+  }
+
+  while (total_memory > memory_ceiling && !blobs.empty()) {
+    // Oldest blobs sit at the front of the vector, so ties are broken in favour of retiring the oldest
+    std::vector<Blob>::iterator stalest = blobs.begin();
+    for (std::vector<Blob>::iterator it = blobs.begin(); it != blobs.end(); ++it) {
+      if (it->intNumOfConsecutiveFramesWithoutAMatch > stalest->intNumOfConsecutiveFramesWithoutAMatch) {
+        stalest = it;
+      }
+    }
+    total_memory -= estimated_memory(*stalest);
+    blobs.erase(stalest);
+  }
+
+  const size_t retired = initial_size - blobs.size();
+  retired_count += retired;
+  return retired;
+}
+
+/**
+ * Approximate number of bytes used by all of the blobs in the store
+ */
+size_t TrackStore::estimated_memory() const {
+  size_t total_memory = 0;
+  for (const Blob &blob : blobs) {
+    total_memory += estimated_memory(blob);
+  }
+  return total_memory;
+}
+
+/**
+ * Approximate number of bytes used by a single blob, including its contour and position history
+ * @param blob Blob     the blob to measure
+ */
+size_t TrackStore::estimated_memory(const Blob &blob) {
+  return sizeof(Blob) +
+      blob.currentContour.capacity() * sizeof(cv::Point) +
+      blob.centerPositions.capacity() * sizeof(cv::Point);
+}
+
+/**
+ * Removes every blob from the store
+ */
+void TrackStore::clear() {
+  blobs.clear();
+}
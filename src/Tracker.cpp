@@ -4,19 +4,32 @@
  * This class handles all of the functionality related to continually tracking a detected blob.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 
+#include "Profiler.hpp"
 #include "Tracker.hpp"
 
-Tracker::Tracker() = default;
+Tracker::Tracker()
+    : matching_strategy(MatchingStrategy::GREEDY),
+      speed_timing(SpeedTiming::FRAME_COUNT),
+      speed_event_log(nullptr),
+      snapshot_writer(nullptr),
+      clip_recorder(nullptr) {}
 
 Tracker::Tracker(unsigned int car_count_, cv::Mat &frame1_, cv::Mat &frame2_, std::vector<Blob> &blobs_, const double fps_)
     : car_count(car_count_),
       frame1(frame1_),
       frame2(frame2_),
       blobs(blobs_),
-      fps(fps_) {};
+      fps(fps_),
+      matching_strategy(MatchingStrategy::GREEDY),
+      speed_timing(SpeedTiming::FRAME_COUNT),
+      speed_event_log(nullptr),
+      snapshot_writer(nullptr),
+      clip_recorder(nullptr) {};
 
 void Tracker::set_car_count(const unsigned int &car_count_) {
   car_count = car_count_;
@@ -58,46 +71,217 @@ const double &Tracker::get_fps() {
   return fps;
 };
 
+const MatchingStrategy &Tracker::get_matching_strategy() const {
+  return matching_strategy;
+}
+
+/**
+ * Selects how blobs in the current frame are paired with the existing tracks. See MatchingStrategy.
+ * @param strategy_ MatchingStrategy    the matching engine to use from the next frame onwards
+ */
+void Tracker::set_matching_strategy(const MatchingStrategy &strategy_) {
+  matching_strategy = strategy_;
+}
+
+const SpeedTiming &Tracker::get_speed_timing() const {
+  return speed_timing;
+}
+
+/**
+ * Selects how the time taken to cross the calibration region is measured. See SpeedTiming.
+ * @param timing_ SpeedTiming   frame counts at the nominal FPS, or capture timestamps
+ */
+void Tracker::set_speed_timing(const SpeedTiming &timing_) {
+  speed_timing = timing_;
+}
+
+/**
+ * Sends every timed vehicle to an asynchronous log instead of writing it on the tracking thread
+ * @param speed_event_log_ SpeedEventLog    an open log which outlives its use by the tracker, or nullptr to write
+ * synchronously
+ */
+void Tracker::set_speed_event_log(SpeedEventLog *speed_event_log_) {
+  speed_event_log = speed_event_log_;
+}
+
+/**
+ * Encodes the image of every timed vehicle on a worker pool instead of on the tracking thread
+ * @param snapshot_writer_ SnapshotWriter   an open writer which outlives its use by the tracker, or nullptr to encode
+ * synchronously
+ */
+void Tracker::set_snapshot_writer(SnapshotWriter *snapshot_writer_) {
+  snapshot_writer = snapshot_writer_;
+}
+
+/**
+ * Asks for a clip of every timed vehicle
+ * @param clip_recorder_ ClipRecorder   an open recorder which outlives its use by the tracker, or nullptr to record no
+ * clips
+ */
+void Tracker::set_clip_recorder(ClipRecorder *clip_recorder_) {
+  clip_recorder = clip_recorder_;
+}
+
+/**
+ * The motion state of every tracked blob. Exposed so the filter's noise parameters can be tuned.
+ */
+MotionModel &Tracker::get_motion_model() {
+  return motion_model;
+}
+
 // Copyright: Chris Dahms
 /**
  * Map existing blobs to the current frame. Necessary to identify unique and reoccurring bloba in a frame.
+ * A blob in the current frame may only be matched to a tracked blob whose predicted position lies within half of the
+ * blob's diagonal. The predicted positions are indexed in a uniform grid so each blob only compares against the tracked
+ * blobs around it rather than every blob seen so far. See set_matching_strategy() for how the matches are chosen.
  * @param existingBlobs std::vector<Blob>   contains all of the blobs which have currently been seen
  * @param currentFrameBlobs std::vector<Blob>   contains all of the blobs detected for the current frame
  */
 void Tracker::match_current_frame_to_existing_blobs(std::vector<Blob> &existingBlobs,
                                                     std::vector<Blob> &currentFrameBlobs) {
+  PROFILE_SCOPE("track.match");
+  predict_tracked_blobs(existingBlobs);
+
+  index_predicted_positions(existingBlobs, currentFrameBlobs);
+
+  if (matching_strategy == MatchingStrategy::GLOBAL) {
+    match_global(existingBlobs, currentFrameBlobs);
+  } else {
+    match_greedy(existingBlobs, currentFrameBlobs);
+  }
+
+  for (Blob &existingBlob : existingBlobs) {
+    if (!existingBlob.blnCurrentMatchFoundOrNewBlob) {
+      existingBlob.intNumOfConsecutiveFramesWithoutAMatch++;
+    }
+    if (existingBlob.intNumOfConsecutiveFramesWithoutAMatch >= 5) {
+      existingBlob.blnStillBeingTracked = false;
+    }
+  }
+}
+
+/**
+ * Carries the tracked blobs through a frame which detection skipped. Their positions are predicted, so the next
+ * detected frame is matched against where they will be by then, but an undetected frame is not a missed match and does
+ * not age them.
+ * @param existingBlobs std::vector<Blob>   contains all of the blobs which have currently been seen
+ */
+void Tracker::predict_undetected_frame(std::vector<Blob> &existingBlobs) {
+  PROFILE_SCOPE("track.match");
+  predict_tracked_blobs(existingBlobs);
+}
+
+/**
+ * Predicts where every tracked blob will be in the current frame. The motion state of each tracked blob is carried into
+ * this frame, blobs without a state (for example those built outside the tracker) are given one from their last two
+ * positions, and then every state is advanced in a single batched pass. Blobs which are no longer tracked are skipped.
+ * @param existingBlobs std::vector<Blob>   contains all of the blobs which have currently been seen
+ */
+void Tracker::predict_tracked_blobs(std::vector<Blob> &existingBlobs) {
+  motion_model.begin_frame();
   for (Blob &existingBlob : existingBlobs) {
     existingBlob.blnCurrentMatchFoundOrNewBlob = false;
-    existingBlob.predict_next_position();
+    if (!existingBlob.blnStillBeingTracked) {
+      existingBlob.motion_slot = -1;
+      continue;
+    }
+    existingBlob.motion_slot = motion_model.carry(existingBlob.motion_slot);
+    if (existingBlob.motion_slot < 0) {
+      const std::vector<cv::Point> &positions = existingBlob.centerPositions;
+      cv::Point velocity(0, 0);
+      if (positions.size() >= 2) {
+        velocity = positions.back() - positions[positions.size() - 2];
+      }
+      existingBlob.motion_slot = motion_model.add(positions.back(), velocity);
+    }
+  }
+
+  motion_model.predict();
+
+  for (Blob &existingBlob : existingBlobs) {
+    if (existingBlob.motion_slot >= 0) {
+      existingBlob.predictedNextPosition = motion_model.get_position(existingBlob.motion_slot);
+      // Measured from where the blob was first seen, so noise in the latest detections cannot flip the direction
+      existingBlob.moving_left = existingBlob.predictedNextPosition.x - existingBlob.origin_position.x <= 0;
+    }
   }
+}
 
+/**
+ * Builds the grid of predicted positions for the tracked blobs
+ * @param existingBlobs std::vector<Blob>   contains all of the blobs which have currently been seen
+ * @param currentFrameBlobs std::vector<Blob>   contains all of the blobs detected for the current frame
+ */
+void Tracker::index_predicted_positions(std::vector<Blob> &existingBlobs, std::vector<Blob> &currentFrameBlobs) {
+  // Size the cells to the largest search radius so every query touches at most 3x3 cells
+  double max_match_distance = 0.0;
   for (Blob &currentFrameBlob : currentFrameBlobs) {
-    int intIndexOfLeastDistance = 0;
-    double dblLeastDistance = 100000.0;
-    for (unsigned int i = 0; i < existingBlobs.size(); i++) {
-      if (existingBlobs[i].blnStillBeingTracked) {
-        double dblDistance =
-            distance_between_points(currentFrameBlob.centerPositions.back(), existingBlobs[i].predictedNextPosition);
-        if (dblDistance < dblLeastDistance) {
-          dblLeastDistance = dblDistance;
-          intIndexOfLeastDistance = i;
-        }
-      }
+    max_match_distance = std::max(max_match_distance, currentFrameBlob.dblCurrentDiagonalSize * 0.5);
+  }
+  match_grid.set_cell_size((int) std::ceil(max_match_distance));
+  match_grid.clear();
+  for (unsigned int i = 0; i < existingBlobs.size(); i++) {
+    if (existingBlobs[i].blnStillBeingTracked) {
+      match_grid.insert(existingBlobs[i].predictedNextPosition, i);
     }
+  }
+  match_grid.build();
+}
 
-    if (dblLeastDistance < currentFrameBlob.dblCurrentDiagonalSize * 0.5) {
+// Copyright: Chris Dahms
+/**
+ * Matches each blob in the current frame, in turn, to the nearest tracked blob within its gate
+ * @param existingBlobs std::vector<Blob>   contains all of the blobs which have currently been seen
+ * @param currentFrameBlobs std::vector<Blob>   contains all of the blobs detected for the current frame
+ */
+void Tracker::match_greedy(std::vector<Blob> &existingBlobs, std::vector<Blob> &currentFrameBlobs) {
+  for (Blob &currentFrameBlob : currentFrameBlobs) {
+    int intIndexOfLeastDistance = match_grid.find_nearest(currentFrameBlob.centerPositions.back(),
+                                                          currentFrameBlob.dblCurrentDiagonalSize * 0.5);
+
+    if (intIndexOfLeastDistance >= 0) {
       add_blob_to_existing_blobs(currentFrameBlob, existingBlobs, intIndexOfLeastDistance);
     } else {
       add_new_blob(currentFrameBlob, existingBlobs);
     }
   }
+}
 
-  for (Blob &existingBlob : existingBlobs) {
-    if (!existingBlob.blnCurrentMatchFoundOrNewBlob) {
-      existingBlob.intNumOfConsecutiveFramesWithoutAMatch++;
+/**
+ * Pairs the blobs in the current frame with the tracked blobs so that the total distance is minimised and each tracked
+ * blob is claimed at most once. Each pair costs its distance as a fraction of the gate, and leaving a blob unmatched
+ * (starting a new track) costs as much as a pair at the edge of the gate.
+ * @param existingBlobs std::vector<Blob>   contains all of the blobs which have currently been seen
+ * @param currentFrameBlobs std::vector<Blob>   contains all of the blobs detected for the current frame
+ */
+void Tracker::match_global(std::vector<Blob> &existingBlobs, std::vector<Blob> &currentFrameBlobs) {
+  assignment_edges.clear();
+  for (unsigned int i = 0; i < currentFrameBlobs.size(); i++) {
+    const cv::Point &center = currentFrameBlobs[i].centerPositions.back();
+    const double gate = currentFrameBlobs[i].dblCurrentDiagonalSize * 0.5;
+    match_grid.find_within(center, gate, match_candidates);
+    for (int candidate : match_candidates) {
+      AssignmentEdge edge;
+      edge.row = (int) i;
+      edge.col = candidate;
+      edge.cost = std::sqrt((double) SpatialGrid::squared_distance(center, existingBlobs[candidate].predictedNextPosition))
+          / gate;
+      assignment_edges.push_back(edge);
     }
-    if (existingBlob.intNumOfConsecutiveFramesWithoutAMatch >= 5) {
-      existingBlob.blnStillBeingTracked = false;
+  }
+
+  assignment_solver.solve((int) currentFrameBlobs.size(), (int) existingBlobs.size(), assignment_edges, assignment);
+
+  // New blobs are appended only after every assignment has been applied, so the track indices remain valid
+  for (unsigned int i = 0; i < currentFrameBlobs.size(); i++) {
+    if (assignment[i] >= 0) {
+      add_blob_to_existing_blobs(currentFrameBlobs[i], existingBlobs, assignment[i]);
+    }
+  }
+  for (unsigned int i = 0; i < currentFrameBlobs.size(); i++) {
+    if (assignment[i] < 0) {
+      add_new_blob(currentFrameBlobs[i], existingBlobs);
     }
   }
 }
@@ -113,9 +297,11 @@ void Tracker::add_blob_to_existing_blobs(Blob &currentFrameBlob, std::vector<Blo
   existingBlobs[intIndex].currentContour = currentFrameBlob.currentContour;
   existingBlobs[intIndex].currentBoundingRect = currentFrameBlob.currentBoundingRect;
   existingBlobs[intIndex].centerPositions.push_back(currentFrameBlob.centerPositions.back());
+  motion_model.correct(existingBlobs[intIndex].motion_slot, currentFrameBlob.centerPositions.back());
   existingBlobs[intIndex].dblCurrentDiagonalSize = currentFrameBlob.dblCurrentDiagonalSize;
   existingBlobs[intIndex].blnStillBeingTracked = true;
   existingBlobs[intIndex].blnCurrentMatchFoundOrNewBlob = true;
+  existingBlobs[intIndex].intNumOfConsecutiveFramesWithoutAMatch = 0;
 }
 
 // Copyright: Chris Dahms
@@ -127,6 +313,7 @@ void Tracker::add_blob_to_existing_blobs(Blob &currentFrameBlob, std::vector<Blo
 void Tracker::add_new_blob(Blob &currentFrameBlob, std::vector<Blob> &existingBlobs) {
 
   currentFrameBlob.blnCurrentMatchFoundOrNewBlob = true;
+  currentFrameBlob.motion_slot = motion_model.add(currentFrameBlob.centerPositions.back(), cv::Point(0, 0));
 
   existingBlobs.push_back(currentFrameBlob);
 }
@@ -140,10 +327,7 @@ void Tracker::add_new_blob(Blob &currentFrameBlob, std::vector<Blob> &existingBl
  */
 double Tracker::distance_between_points(cv::Point point1, cv::Point point2) {
 
-  int intX = abs(point1.x - point2.x);
-  int intY = abs(point1.y - point2.y);
-
-  return (sqrt(pow(intX, 2) + pow(intY, 2)));
+  return std::sqrt((double) SpatialGrid::squared_distance(point1, point2));
 }
 
 // Copyright: Chris Dahms
@@ -175,7 +359,10 @@ void Tracker::draw_and_show_contours(cv::Size imageSize, std::vector<Blob> blobs
 }
 
 /**
- * Computes the speed of a blob in kilometers per hour.
+ * Computes the speed of a blob in kilometers per hour. When the blob was seen on at least three frames within the
+ * calibration region the speed is fitted to all of its centre positions, which averages out both the detection noise
+ * and the quantisation of entry and exit to whole frames, and its standard error is reported alongside. Otherwise it
+ * is timed from the entry and exit frames alone.
  * @param blob Blob     blob object to compute the speed of
  * @param conversion    ratio between pixels to real world meters. See AppConfig.cpp for how this is computed
  */
@@ -186,14 +373,39 @@ void Tracker::calculate_speed(Blob &blob, double conversion) {
   // the true distance in meters
   double dist = cv::norm(blob.end_dist - blob.start_dist) / conversion;
 
-  // Get the time by dividing the difference in frames by the FPS of the video feed
-  // Cannot use a simple clock() approach as this does not accurately represent the time
-  // it truly took for the blobs to cross the calibration area.
-  double time = (blob.end_frame - blob.start_frame) / get_fps();
+  // Cannot use a simple clock() approach as this does not accurately represent the time it truly took for the blobs to
+  // cross the calibration area. Either the capture timestamps of the entry and exit frames are used, or the difference
+  // in frames divided by the FPS of the video feed.
+  double time = speed_timing == SpeedTiming::TIMESTAMPS ? blob.end_time - blob.start_time
+                                                        : (blob.end_frame - blob.start_frame) / get_fps();
   double speed = dist / time;
 
   // Convert the speed from meters per second to kilometers per hour
   blob.speed = speed * 3.6;
+  blob.speed_error = 0.0;
+  blob.speed_residual = 0.0;
+
+  if (blob.speed_fit.is_valid()) {
+    blob.speed = std::abs(blob.speed_fit.get_slope()) / conversion * 3.6;
+    blob.speed_error = blob.speed_fit.get_slope_error() / conversion * 3.6;
+    blob.speed_residual = blob.speed_fit.get_residual();
+  }
+}
+
+/**
+ * Tracks a car travelling both left and right within a frame, timing each frame at the nominal FPS
+ * @param blobs std::vector<Blob>   vector of the blobs to track
+ * @param start_point std::vector<cv::Point>    start points of the calibration region
+ * @param end_point std::vector<cv::Point>    end points of the calibration region
+ * @param conversion    ratio between pixels to real world meters
+ * @param frame_count int   number of frames currently viewed
+ */
+void Tracker::track_car_speed(std::vector<Blob> &blobs,
+                              std::vector<cv::Point> &start_point,
+                              std::vector<cv::Point> &end_point,
+                              double conversion,
+                              unsigned int frame_count) {
+  track_car_speed(blobs, start_point, end_point, conversion, frame_count, frame_count / get_fps());
 }
 
 // This needs to be refactored into a more elegant solution
@@ -207,14 +419,18 @@ void Tracker::calculate_speed(Blob &blob, double conversion) {
  * @param conversion    ratio between pixels to real world meters. See AppConfig.cpp for how this is computed
  * @param frame_count int   number of frames currently viewed. Need this to calculate the time a blob has taken to pass a
  * calibration region.
+ * @param timestamp double  capture time of the current frame in seconds, used when timing with SpeedTiming::TIMESTAMPS
  */
 void Tracker::track_car_speed(std::vector<Blob> &blobs,
                               std::vector<cv::Point> &start_point,
                               std::vector<cv::Point> &end_point,
                               double conversion,
-                              unsigned int frame_count) {
+                              unsigned int frame_count,
+                              double timestamp) {
+  PROFILE_SCOPE("track.speed");
   int start_x;
   int finish_x;
+  const double time = speed_timing == SpeedTiming::TIMESTAMPS ? timestamp : frame_count / get_fps();
 
   for (Blob &blob : blobs) {
     if (blob.blnStillBeingTracked && blob.centerPositions.size() >= 2) {
@@ -230,13 +446,22 @@ void Tracker::track_car_speed(std::vector<Blob> &blobs,
       // The car is beginning to reach the calibrated region
       if (blob.currentBoundingRect.x >= start_x && !blob.tracking_speed && blob.moving_left) {
         blob.start_frame = frame_count;
+        blob.start_time = timestamp;
         blob.tracking_speed = true;
         blob.start_dist = blob.currentBoundingRect.x;
+        blob.speed_fit.reset();
       }
       else if (!blob.moving_left && blob.currentBoundingRect.x <= start_x && !blob.tracking_speed) {
         blob.start_frame = frame_count;
+        blob.start_time = timestamp;
         blob.tracking_speed = true;
         blob.start_dist = blob.currentBoundingRect.x;
+        blob.speed_fit.reset();
+      }
+
+      // Only positions measured in this frame are fitted. A blob which went unmatched still holds its last position.
+      if (blob.tracking_speed && blob.blnCurrentMatchFoundOrNewBlob) {
+        blob.speed_fit.add(time, blob.centerPositions.back().x);
       }
 
 
@@ -245,25 +470,59 @@ void Tracker::track_car_speed(std::vector<Blob> &blobs,
           blob.moving_left &&
           (blob.currentBoundingRect.x + blob.currentBoundingRect.width) <= finish_x) {
         blob.end_frame = frame_count;
+        blob.end_time = timestamp;
         calculate_speed(blob, conversion);
         blob.tracking_speed = false;
-        write_tracked_car_speed(blob.speed, blob.id, "data/tracked_cars/speed.log");
-        write_tracked_car_image(get_frame1(), blob.currentBoundingRect, blob.id, "data/tracked_cars/");
+        report_vehicle(blob);
       }
       // The car has passed the calibration region heading right
       else if (blob.tracking_speed &&
           !blob.moving_left &&
           blob.currentBoundingRect.x >= finish_x) {
         blob.end_frame = frame_count;
+        blob.end_time = timestamp;
         calculate_speed(blob, conversion);
         blob.tracking_speed = false;
-        write_tracked_car_speed(blob.speed, blob.id, "data/tracked_cars/speed.log");
-        write_tracked_car_image(get_frame1(), blob.currentBoundingRect, blob.id, "data/tracked_cars/");
+        report_vehicle(blob);
       }
     }
   }
 }
 
+/**
+ * Records a vehicle which has just been timed: its speed, its image and, when clips are recorded, a clip of it. Each
+ * goes to its asynchronous writer when one is set, otherwise the speed and image are written to data/tracked_cars/
+ * straight away.
+ * @param blob Blob     the vehicle, as seen in the current frame
+ */
+void Tracker::report_vehicle(const Blob &blob) {
+  SpeedEvent event;
+  event.vehicle_id = blob.id;
+  event.start_time = blob.start_time;
+  event.end_time = blob.end_time;
+  event.start_frame = blob.start_frame;
+  event.end_frame = blob.end_frame;
+  event.moving_left = blob.moving_left;
+  event.speed = blob.speed;
+  event.speed_error = blob.speed_error;
+
+  if (speed_event_log != nullptr) {
+    speed_event_log->log(event);
+  } else {
+    write_tracked_car_speed(blob.speed, blob.id, "data/tracked_cars/speed.log");
+  }
+
+  if (snapshot_writer != nullptr) {
+    snapshot_writer->submit(get_frame1(), blob.currentBoundingRect, blob.id);
+  } else {
+    write_tracked_car_image(get_frame1(), blob.currentBoundingRect, blob.id, "data/tracked_cars/");
+  }
+
+  if (clip_recorder != nullptr) {
+    clip_recorder->request(event);
+  }
+}
+
 /**
  * Writes a tracked car image to disk for later viewing.
  * @param frame cv::Mat     the frame to write
@@ -335,7 +594,8 @@ void Tracker::draw_blob_info_on_image(std::vector<Blob> &blobs, cv::Mat &imgFram
 
 void Tracker::draw_car_count_on_image(const int &carCount, cv::Mat &imgFrame2Copy) {
   int intFontFace = CV_FONT_HERSHEY_SIMPLEX;
-  double dblFontScale = (imgFrame2Copy.rows * imgFrame2Copy.cols) / 300000.0;
+  // Grows with the frame height, giving the same size as before at 640x480 without ballooning at higher resolutions
+  double dblFontScale = imgFrame2Copy.rows * 640 / 300000.0;
   int intFontThickness = (int) std::round(dblFontScale * 1.5);
 
   cv::Size textSize = cv::getTextSize(std::to_string(carCount), intFontFace, dblFontScale, intFontThickness, 0);
@@ -9,6 +9,11 @@
 
 #include "Transform.hpp"
 
+/**
+ * Default constructor for Transform
+ */
+Transform::Transform() = default;
+
 /**
  * Constructor for just the current frame
  * @param frame a matrix composed of the relevant RGB values to make up the frame
@@ -0,0 +1,422 @@
+/**
+ * V4l2FrameSource.cpp
+ *
+ * Captures straight from a V4L2 camera by streaming I/O, without cv::VideoCapture. The driver fills a ring of buffers
+ * memory mapped into the process. Raw frames are handed out as cv::Mat views of those buffers, so no frame is copied or
+ * converted before the pipeline sees it. Each view carries a lease and the buffer is queued back to the driver once the
+ * last copy of the lease is dropped. While too few buffers are left with the driver, frames are copied instead and
+ * their buffers queued back at once, so that a pipeline holding on to frames can never starve the camera.
+ *
+ * Frames keep the driver's capture timestamp and are numbered by the driver's sequence number, so frames the driver
+ * dropped show up as gaps in the index and are counted.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <mutex>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Luminance.hpp"
+#include "V4l2FrameSource.hpp"
+
+struct V4l2Device {
+  struct Buffer {
+    void *start;
+    size_t length;
+  };
+
+  int fd = -1;
+  std::vector<Buffer> buffers;
+  // Guards streaming and queued, as leases queue their buffers back from whichever thread drops them last
+  std::mutex mutex;
+  bool streaming = false;
+  unsigned int queued = 0;
+
+  ~V4l2Device();
+  bool queue_buffer(unsigned int index);
+};
+
+namespace {
+int xioctl(int fd, unsigned long request, void *argument) {
+  int result;
+  do {
+    result = ::ioctl(fd, request, argument);
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+/**
+ * Asks the driver for frames of a size and pixel format
+ * @return false if the driver settled on another pixel format
+ */
+bool set_format(int fd, const cv::Size &size, unsigned int pixel_format, v4l2_format &format) {
+  std::memset(&format, 0, sizeof(format));
+  format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  format.fmt.pix.width = (unsigned int) size.width;
+  format.fmt.pix.height = (unsigned int) size.height;
+  format.fmt.pix.pixelformat = pixel_format;
+  format.fmt.pix.field = V4L2_FIELD_NONE;
+  return xioctl(fd, VIDIOC_S_FMT, &format) == 0 && format.fmt.pix.pixelformat == pixel_format;
+}
+}
+
+/**
+ * Unmaps the buffers and closes the device once the source and every lease have let go of it
+ */
+V4l2Device::~V4l2Device() {
+  for (const Buffer &buffer : buffers) {
+    ::munmap(buffer.start, buffer.length);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+/**
+ * Hands a buffer back to the driver to capture into. Does nothing once the stream has stopped.
+ * @param index unsigned int    index of the buffer
+ */
+bool V4l2Device::queue_buffer(unsigned int index) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!streaming) {
+    return false;
+  }
+  v4l2_buffer buffer;
+  std::memset(&buffer, 0, sizeof(buffer));
+  buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buffer.memory = V4L2_MEMORY_MMAP;
+  buffer.index = index;
+  if (xioctl(fd, VIDIOC_QBUF, &buffer) < 0) {
+    return false;
+  }
+  queued++;
+  return true;
+}
+
+/**
+ * Constructor for V4l2FrameSource. Maps 8 buffers, keeps at least 2 of them with the driver and gives up on a camera
+ * which delivers nothing for 2 seconds.
+ * @param device_path_ std::string  the camera's device node, e.g. /dev/video0
+ */
+V4l2FrameSource::V4l2FrameSource(const std::string &device_path_)
+    : device_path(device_path_),
+      buffer_count(8),
+      reserved_buffers(2),
+      timeout_ms(2000),
+      frame_type(CV_8UC2),
+      bytes_per_line(0),
+      first_sequence_seen(false),
+      first_sequence(0),
+      last_sequence(0),
+      dropped_frames(0),
+      copied_frames(0) {}
+
+V4l2FrameSource::~V4l2FrameSource() {
+  close();
+}
+
+const std::string &V4l2FrameSource::get_device_path() const {
+  return device_path;
+}
+
+const unsigned int &V4l2FrameSource::get_buffer_count() const {
+  return buffer_count;
+}
+
+/**
+ * Sets how many buffers are requested from the driver. More buffers let the pipeline hold on to more frames without
+ * copying them, and absorb longer stalls before the driver drops frames. The driver may grant a different number.
+ * @param buffer_count_ unsigned int    number of buffers, at least 2. Takes effect the next time the source is opened.
+ */
+void V4l2FrameSource::set_buffer_count(const unsigned int buffer_count_) {
+  buffer_count = std::max(2u, buffer_count_);
+}
+
+const unsigned int &V4l2FrameSource::get_reserved_buffers() const {
+  return reserved_buffers;
+}
+
+/**
+ * Sets how many buffers must stay with the driver. Frames are copied rather than lent out while no more are left.
+ * @param reserved_buffers_ unsigned int    number of buffers, at least 1
+ */
+void V4l2FrameSource::set_reserved_buffers(const unsigned int reserved_buffers_) {
+  reserved_buffers = std::max(1u, reserved_buffers_);
+}
+
+const int &V4l2FrameSource::get_timeout_ms() const {
+  return timeout_ms;
+}
+
+/**
+ * Sets how long read() waits for a frame before treating the stream as ended
+ * @param timeout_ms_ int   milliseconds
+ */
+void V4l2FrameSource::set_timeout_ms(const int timeout_ms_) {
+  timeout_ms = timeout_ms_;
+}
+
+/**
+ * Opens the camera, asks for YUYV frames, or failing that grayscale, of the requested size and rate, maps the buffers
+ * and starts streaming
+ * @return false if the device is not a streaming capture device, only offers other pixel formats, or any step fails
+ */
+bool V4l2FrameSource::open() {
+  close();
+  restart_stream();
+  first_sequence_seen = false;
+  dropped_frames = 0;
+  copied_frames = 0;
+
+  std::shared_ptr<V4l2Device> opened = std::make_shared<V4l2Device>();
+  opened->fd = ::open(device_path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (opened->fd < 0) {
+    return false;
+  }
+
+  v4l2_capability capability;
+  std::memset(&capability, 0, sizeof(capability));
+  if (xioctl(opened->fd, VIDIOC_QUERYCAP, &capability) < 0) {
+    return false;
+  }
+  const unsigned int capabilities =
+      (capability.capabilities & V4L2_CAP_DEVICE_CAPS) ? capability.device_caps : capability.capabilities;
+  if (!(capabilities & V4L2_CAP_VIDEO_CAPTURE) || !(capabilities & V4L2_CAP_STREAMING)) {
+    return false;
+  }
+
+  v4l2_format format;
+  if (set_format(opened->fd, requested_size, V4L2_PIX_FMT_YUYV, format)) {
+    frame_type = CV_8UC2;
+  } else if (set_format(opened->fd, requested_size, V4L2_PIX_FMT_GREY, format)) {
+    frame_type = CV_8UC1;
+  } else {
+    return false;
+  }
+  frame_size = cv::Size((int) format.fmt.pix.width, (int) format.fmt.pix.height);
+  bytes_per_line = format.fmt.pix.bytesperline;
+  if (bytes_per_line < (size_t) frame_size.width * CV_ELEM_SIZE(frame_type)) {
+    bytes_per_line = (size_t) frame_size.width * CV_ELEM_SIZE(frame_type);
+  }
+
+  // Not every driver lets the frame rate be chosen, and the camera then runs at its own rate
+  v4l2_streamparm parameters;
+  std::memset(&parameters, 0, sizeof(parameters));
+  parameters.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  parameters.parm.capture.timeperframe.numerator = 1000;
+  parameters.parm.capture.timeperframe.denominator = (unsigned int) std::lround(fps * 1000.0);
+  xioctl(opened->fd, VIDIOC_S_PARM, &parameters);
+
+  v4l2_requestbuffers request;
+  std::memset(&request, 0, sizeof(request));
+  request.count = buffer_count;
+  request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  request.memory = V4L2_MEMORY_MMAP;
+  if (xioctl(opened->fd, VIDIOC_REQBUFS, &request) < 0 || request.count < 2) {
+    return false;
+  }
+
+  for (unsigned int index = 0; index < request.count; index++) {
+    v4l2_buffer buffer;
+    std::memset(&buffer, 0, sizeof(buffer));
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = index;
+    if (xioctl(opened->fd, VIDIOC_QUERYBUF, &buffer) < 0) {
+      return false;
+    }
+    void *start = ::mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, opened->fd, buffer.m.offset);
+    if (start == MAP_FAILED) {
+      return false;
+    }
+    opened->buffers.push_back(V4l2Device::Buffer{start, buffer.length});
+  }
+
+  opened->streaming = true;
+  for (unsigned int index = 0; index < opened->buffers.size(); index++) {
+    if (!opened->queue_buffer(index)) {
+      return false;
+    }
+  }
+  v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (xioctl(opened->fd, VIDIOC_STREAMON, &type) < 0) {
+    return false;
+  }
+
+  device = opened;
+  return true;
+}
+
+/**
+ * Waits for the driver to fill the next buffer. A raw frame is lent out as a view of the buffer while enough buffers
+ * remain with the driver, and copied otherwise. Frames which are not raw are converted to BGR.
+ */
+bool V4l2FrameSource::read(SourceFrame &frame) {
+  if (!device) {
+    return false;
+  }
+
+  v4l2_buffer buffer;
+  while (true) {
+    pollfd ready = {device->fd, POLLIN, 0};
+    const int polled = ::poll(&ready, 1, timeout_ms);
+    if (polled < 0 && errno == EINTR) {
+      continue;
+    }
+    if (polled <= 0) {
+      return false;
+    }
+
+    std::memset(&buffer, 0, sizeof(buffer));
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(device->fd, VIDIOC_DQBUF, &buffer) < 0) {
+      if (errno == EAGAIN) {
+        continue;
+      }
+      return false;
+    }
+    {
+      std::lock_guard<std::mutex> lock(device->mutex);
+      device->queued--;
+    }
+    if (!(buffer.flags & V4L2_BUF_FLAG_ERROR) && buffer.bytesused >= bytes_per_line * frame_size.height) {
+      break;
+    }
+    // A corrupted frame is discarded, and shows up as a gap in the sequence if the driver counted it
+    device->queue_buffer(buffer.index);
+  }
+
+  if (!first_sequence_seen) {
+    first_sequence = buffer.sequence;
+    first_sequence_seen = true;
+  } else if (buffer.sequence > last_sequence + 1) {
+    dropped_frames += buffer.sequence - last_sequence - 1;
+  }
+  last_sequence = buffer.sequence;
+
+  // The frame's previous image may be a view of a driver buffer, which must never be written to. Views do not own
+  // their data, unlike the buffers OpenCV allocates.
+  frame.lease.reset();
+  if (frame.image.data != nullptr && frame.image.u == nullptr) {
+    frame.image = cv::Mat();
+  }
+
+  const unsigned int index = buffer.index;
+  cv::Mat view(frame_size, frame_type, device->buffers[index].start, bytes_per_line);
+  unsigned int queued;
+  {
+    std::lock_guard<std::mutex> lock(device->mutex);
+    queued = device->queued;
+  }
+  if (is_raw() && queued >= reserved_buffers) {
+    std::shared_ptr<V4l2Device> owner = device;
+    frame.image = view;
+    frame.lease = std::shared_ptr<void>(view.data, [owner, index](void *) {
+      owner->queue_buffer(index);
+    });
+  } else {
+    if (is_raw()) {
+      view.copyTo(frame.image);
+      copied_frames++;
+    } else {
+      convert_to_bgr(view, frame.image);
+    }
+    device->queue_buffer(index);
+  }
+
+  stamp(frame, buffer.timestamp.tv_sec + buffer.timestamp.tv_usec / 1e6);
+  frame.index = buffer.sequence - first_sequence;
+  return true;
+}
+
+/**
+ * Stops streaming. Buffers still lent out stay mapped until their leases are dropped, but are no longer queued back.
+ */
+void V4l2FrameSource::close() {
+  if (!device) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(device->mutex);
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    xioctl(device->fd, VIDIOC_STREAMOFF, &type);
+    device->streaming = false;
+    device->queued = 0;
+  }
+  device.reset();
+}
+
+bool V4l2FrameSource::is_open() const {
+  return device != nullptr;
+}
+
+cv::Size V4l2FrameSource::get_frame_size() const {
+  return frame_size;
+}
+
+bool V4l2FrameSource::is_raw() const {
+  return raw_requested;
+}
+
+bool V4l2FrameSource::is_live() const {
+  return true;
+}
+
+/**
+ * Number of frames the driver skipped since the source was opened, judged by gaps in its sequence numbers
+ */
+unsigned long long V4l2FrameSource::get_dropped_frames() const {
+  return dropped_frames;
+}
+
+/**
+ * Number of buffers mapped from the driver, which may differ from the number requested
+ */
+unsigned int V4l2FrameSource::get_mapped_buffers() const {
+  return device ? (unsigned int) device->buffers.size() : 0;
+}
+
+/**
+ * Number of buffers currently with the driver, rather than being read or lent out
+ */
+unsigned int V4l2FrameSource::get_queued_buffers() const {
+  if (!device) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(device->mutex);
+  return device->queued;
+}
+
+/**
+ * Number of raw frames copied since the source was opened because too few buffers were left with the driver to lend
+ * them out
+ */
+const unsigned long long &V4l2FrameSource::get_copied_frames() const {
+  return copied_frames;
+}
+
+/**
+ * Whether a device node is the vivid virtual camera, which the tests capture from
+ * @param device_path std::string   the device node, e.g. /dev/video0
+ */
+bool V4l2FrameSource::is_vivid(const std::string &device_path) {
+  const int fd = ::open(device_path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  v4l2_capability capability;
+  std::memset(&capability, 0, sizeof(capability));
+  const bool vivid = xioctl(fd, VIDIOC_QUERYCAP, &capability) == 0 &&
+      std::strcmp(reinterpret_cast<const char *>(capability.driver), "vivid") == 0;
+  ::close(fd);
+  return vivid;
+}
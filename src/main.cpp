@@ -1,11 +1,41 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
 #include <opencv2/opencv.hpp>
 
 
 #include "AppConfig.hpp"
+#include "V4l2FrameSource.hpp"
+
+/**
+ * Parses a polygon given on the command line as comma separated coordinates, x1,y1,x2,y2,...
+ */
+static std::vector<cv::Point> parse_polygon(const char *vertices) {
+  std::vector<int> coordinates;
+  const char *cursor = vertices;
+  char *end = nullptr;
+  while (*cursor != '\0') {
+    const long coordinate = std::strtol(cursor, &end, 10);
+    if (end == cursor) {
+      break;
+    }
+    coordinates.push_back((int) coordinate);
+    cursor = *end == ',' ? end + 1 : end;
+  }
+
+  std::vector<cv::Point> polygon;
+  for (size_t i = 0; i + 1 < coordinates.size(); i += 2) {
+    polygon.push_back(cv::Point(coordinates[i], coordinates[i + 1]));
+  }
+  return polygon;
+}
 
 int main(int argc, char *argv[]) {
   Tracker tracker;
   BackgroundSubtractor bgs;
+  RegionOfInterest region;
   std::vector<cv::Point> crossing_lines;
   std::vector<cv::Point> start_points;
   std::vector<cv::Point> end_points;
@@ -14,6 +44,29 @@ int main(int argc, char *argv[]) {
   int frame_width = 640;
   int frame_height = 480;
   int calibration_region_area = 4;
+  int v4l2_buffers = 0;
+
+  // --global-matching resolves contested detections with the gated global assignment instead of greedily
+  // --background running-average swaps MOG2 for the cheaper running average model on low-power boards
+  // --stripes N subtracts N horizontal stripes of each frame in parallel
+  // --roi x1,y1,x2,y2,... only processes the polygon through these vertices. Repeat for several road polygons.
+  // --frame-count-timing times vehicles by counting frames at the nominal FPS rather than by capture timestamps
+  tracker.set_speed_timing(SpeedTiming::TIMESTAMPS);
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--global-matching") == 0) {
+      tracker.set_matching_strategy(MatchingStrategy::GLOBAL);
+    } else if (std::strcmp(argv[i], "--background") == 0 && i + 1 < argc) {
+      bool running_average = std::strcmp(argv[++i], BackgroundModel::engine_name(BackgroundEngine::RUNNING_AVERAGE)) == 0;
+      bgs.set_engine(running_average ? BackgroundEngine::RUNNING_AVERAGE : BackgroundEngine::MOG2);
+    } else if (std::strcmp(argv[i], "--stripes") == 0 && i + 1 < argc) {
+      bgs.set_stripes(std::max(1, std::atoi(argv[++i])));
+    } else if (std::strcmp(argv[i], "--roi") == 0 && i + 1 < argc) {
+      region.add_polygon(parse_polygon(argv[++i]));
+    } else if (std::strcmp(argv[i], "--frame-count-timing") == 0) {
+      tracker.set_speed_timing(SpeedTiming::FRAME_COUNT);
+    }
+  }
+  bgs.set_region_of_interest(region);
 
   AppConfig app(tracker,
                 bgs,
@@ -27,6 +80,74 @@ int main(int argc, char *argv[]) {
                 calibration_region_area
   );
 
+  // --headless runs without a display, --preview N shows every Nth frame while headless
+  // --working-scale S detects vehicles on frames scaled by S, e.g. 0.5 to detect 1080p input at 540p
+  // --luminance detects vehicles on the luminance of each frame alone
+  // --motion-gate idles detection and tracking while nothing moves on the road
+  // --adaptive-quality degrades processing in steps whenever frames take longer than the frame interval
+  // --speed-log PATH appends the timed vehicles to PATH, --speed-log-format text|csv|jsonl selects its layout
+  // --snapshot-quality Q encodes vehicle snapshots at JPEG quality Q, --snapshot-max-size N scales them to fit N pixels
+  // --clips records a clip around each timed vehicle, --clip-min-speed KMH only of vehicles at or above KMH
+  // --no-recording stops writing every frame to output.h264
+  // --source PATH reads a video file, a printf style image sequence such as frames/%06d.png, or /dev/videoN
+  // --v4l2-buffers N maps N driver buffers when capturing from /dev/videoN
+  // --raw-frames PATH WxH gray|yuyv|bgr reads headerless raw frames of that size and layout packed back to back
+  // --prefetch N decodes up to N frames ahead of processing on a thread of its own, 0 to decode on the capture stage
+  // --trace PATH writes a Chrome trace of every pipeline stage to PATH, in builds with TRAFFIC_MONITOR_PROFILE
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--headless") == 0) {
+      app.set_headless(true);
+    } else if (std::strcmp(argv[i], "--preview") == 0 && i + 1 < argc) {
+      app.set_preview_interval((unsigned int) std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--working-scale") == 0 && i + 1 < argc) {
+      app.set_working_scale(std::atof(argv[++i]));
+    } else if (std::strcmp(argv[i], "--luminance") == 0) {
+      app.set_luminance_only(true);
+    } else if (std::strcmp(argv[i], "--motion-gate") == 0) {
+      app.set_motion_gating(true);
+    } else if (std::strcmp(argv[i], "--adaptive-quality") == 0) {
+      app.set_adaptive_quality(true);
+    } else if (std::strcmp(argv[i], "--speed-log") == 0 && i + 1 < argc) {
+      app.get_speed_event_log().set_path(argv[++i]);
+    } else if (std::strcmp(argv[i], "--speed-log-format") == 0 && i + 1 < argc) {
+      SpeedLogFormat format;
+      if (SpeedEventLog::parse_format(argv[++i], format)) {
+        app.get_speed_event_log().set_format(format);
+      }
+    } else if (std::strcmp(argv[i], "--snapshot-quality") == 0 && i + 1 < argc) {
+      app.get_snapshot_writer().set_jpeg_quality(std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--snapshot-max-size") == 0 && i + 1 < argc) {
+      app.get_snapshot_writer().set_max_dimension(std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--clips") == 0) {
+      app.set_clip_recording(true);
+    } else if (std::strcmp(argv[i], "--clip-min-speed") == 0 && i + 1 < argc) {
+      app.get_clip_recorder().set_min_speed(std::atof(argv[++i]));
+    } else if (std::strcmp(argv[i], "--no-recording") == 0) {
+      app.set_continuous_recording(false);
+    } else if (std::strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+      app.set_SOURCE_VIDEO_PATH(argv[++i]);
+    } else if (std::strcmp(argv[i], "--raw-frames") == 0 && i + 3 < argc) {
+      const char *path = argv[++i];
+      cv::Size size;
+      RawPixelFormat format;
+      if (std::sscanf(argv[++i], "%dx%d", &size.width, &size.height) == 2 &&
+          FrameSource::parse_raw_format(argv[++i], format)) {
+        app.set_frame_source(cv::makePtr<RawFileFrameSource>(path, size, format));
+      }
+    } else if (std::strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc) {
+      app.set_prefetch_frames((size_t) std::max(0, std::atoi(argv[++i])));
+    } else if (std::strcmp(argv[i], "--v4l2-buffers") == 0 && i + 1 < argc) {
+      v4l2_buffers = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      app.set_trace_path(argv[++i]);
+    }
+  }
+  if (v4l2_buffers > 0 && app.get_SOURCE_VIDEO_PATH().compare(0, 10, "/dev/video") == 0) {
+    cv::Ptr<V4l2FrameSource> camera = cv::makePtr<V4l2FrameSource>(app.get_SOURCE_VIDEO_PATH());
+    camera->set_buffer_count((unsigned int) v4l2_buffers);
+    app.set_frame_source(camera);
+  }
+
   app.run();
 
   return 0;
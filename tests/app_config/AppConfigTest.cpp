@@ -0,0 +1,250 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "AllocationCounter.hpp"
+#include "AppConfig.hpp"
+
+namespace {
+const int EMPTY_FRAMES = 40;
+const int VEHICLE_FRAMES = 20;
+const int SECOND_VEHICLE_FRAME = 100;
+const int TOTAL_FRAMES = 160;
+const int WARM_UP_FRAMES = 10;
+// The leftbound vehicle is in view until it has left the calibration region
+const int LEFTBOUND_VEHICLE_FRAMES = 48;
+const int LEFTBOUND_TOTAL_FRAMES = 100;
+// Frames at the end of each gap between vehicles, by which time the last vehicle's trail has faded from the model
+const int SETTLED_FRAMES = 20;
+// Every frame with a vehicle in it builds the vehicle's Blob: its contour is copied into the constructor's argument and
+// again into the Blob, and its first centre position is pushed. Extraction itself reuses its buffers.
+const unsigned long long BLOB_ALLOCATIONS = 3;
+// A new track copies the Blob's contour and positions
+const unsigned long long NEW_TRACK_ALLOCATIONS = 2;
+// The track's position history grows on its second and third frames, to the capacity its trim to 2 positions keeps
+const unsigned long long HISTORY_GROWTH_ALLOCATIONS = 1;
+
+/**
+ * The exact number of allocations for a frame of the second vehicle, which crosses once the first vehicle has grown
+ * every scratch buffer in the detection and tracking path
+ */
+unsigned long long vehicle_frame_allocations(int vehicle_frame) {
+  if (vehicle_frame == 0) {
+    return BLOB_ALLOCATIONS + NEW_TRACK_ALLOCATIONS;
+  }
+  return vehicle_frame < 3 ? BLOB_ALLOCATIONS + HISTORY_GROWTH_ALLOCATIONS : BLOB_ALLOCATIONS;
+}
+
+/**
+ * An empty grey road, crossed twice by a dark 100x70 vehicle moving right. The vehicle stays left of the calibration
+ * region so it is never timed. Each read also records the heap allocations the pipeline made for the frame before.
+ */
+class SyntheticRoad : public FrameSource {
+ public:
+  SyntheticRoad(const AppConfig &app_, std::vector<unsigned long long> &allocations_)
+      : app(app_),
+        allocations(allocations_),
+        next_frame(0),
+        opened(false) {}
+
+  bool open() override {
+    restart_stream();
+    next_frame = 0;
+    opened = true;
+    return true;
+  }
+
+  bool read(SourceFrame &frame) override {
+    if (!opened || next_frame >= TOTAL_FRAMES) {
+      return false;
+    }
+    if (next_frame > 0) {
+      allocations.push_back(app.get_frame_allocations());
+    }
+
+    frame.image.create(get_frame_size(), CV_8UC3);
+    frame.image.setTo(cv::Scalar::all(128));
+    const int vehicle_frame = next_frame - (next_frame < SECOND_VEHICLE_FRAME ? EMPTY_FRAMES : SECOND_VEHICLE_FRAME);
+    if (vehicle_frame >= 0 && vehicle_frame < VEHICLE_FRAMES) {
+      frame.image(cv::Rect(20 + 4 * vehicle_frame, 300, 100, 70)).setTo(cv::Scalar::all(30));
+    }
+    next_frame++;
+    stamp(frame, -1.0);
+    return true;
+  }
+
+  void close() override {
+    opened = false;
+  }
+
+  bool is_open() const override {
+    return opened;
+  }
+
+  cv::Size get_frame_size() const override {
+    return cv::Size(640, 480);
+  }
+
+ private:
+  const AppConfig &app;
+  std::vector<unsigned long long> &allocations;
+  int next_frame;
+  bool opened;
+};
+/**
+ * An empty grey road, crossed right to left by a dark 100x70 vehicle which passes through the calibration region
+ */
+class LeftboundVehicle : public FrameSource {
+ public:
+  LeftboundVehicle()
+      : next_frame(0),
+        opened(false) {}
+
+  bool open() override {
+    restart_stream();
+    next_frame = 0;
+    opened = true;
+    return true;
+  }
+
+  bool read(SourceFrame &frame) override {
+    if (!opened || next_frame >= LEFTBOUND_TOTAL_FRAMES) {
+      return false;
+    }
+
+    frame.image.create(get_frame_size(), CV_8UC3);
+    frame.image.setTo(cv::Scalar::all(128));
+    const int vehicle_frame = next_frame - EMPTY_FRAMES;
+    if (vehicle_frame >= 0 && vehicle_frame < LEFTBOUND_VEHICLE_FRAMES) {
+      frame.image(cv::Rect(520 - 8 * vehicle_frame, 300, 100, 70)).setTo(cv::Scalar::all(30));
+    }
+    next_frame++;
+    stamp(frame, -1.0);
+    return true;
+  }
+
+  void close() override {
+    opened = false;
+  }
+
+  bool is_open() const override {
+    return opened;
+  }
+
+  cv::Size get_frame_size() const override {
+    return cv::Size(640, 480);
+  }
+
+ private:
+  int next_frame;
+  bool opened;
+};
+}
+
+class AppConfigTest : public ::testing::Test {
+ protected:
+  const std::string speed_log = "tests/app_config/speed.log";
+  // Snapshot of a timed vehicle. Vehicles which never cross the counting line keep the id 0.
+  const std::string snapshot = "tests/app_config/0.jpg";
+
+  virtual void TearDown() {
+    std::remove(speed_log.c_str());
+    std::remove(snapshot.c_str());
+  }
+};
+
+TEST_F(AppConfigTest, frame_loop_allocations_after_warm_up) {
+  if (!allocation_counting_enabled()) {
+    GTEST_SKIP() << "Built without TRAFFIC_MONITOR_COUNT_ALLOCATIONS";
+  }
+
+  Tracker tracker;
+  BackgroundSubtractor bgs;
+  // The running average model allocates nothing once seeded, unlike MOG2 whose internals are OpenCV's
+  bgs.set_engine(BackgroundEngine::RUNNING_AVERAGE);
+  std::vector<cv::Point> crossing_lines;
+  std::vector<cv::Point> start_points;
+  std::vector<cv::Point> end_points;
+  AppConfig app(tracker, bgs, crossing_lines, start_points, end_points, "", 30.0, 640, 480, 4);
+  app.set_pipelined(false);
+  app.set_prefetch_frames(0);
+  app.set_headless(true);
+  app.set_continuous_recording(false);
+  app.get_speed_event_log().set_path(speed_log);
+  app.get_snapshot_writer().set_directory("tests/app_config/");
+
+  std::vector<unsigned long long> allocations;
+  allocations.reserve(TOTAL_FRAMES);
+  app.set_frame_source(cv::makePtr<SyntheticRoad>(app, allocations));
+  app.run();
+  allocations.push_back(app.get_frame_allocations());
+
+  ASSERT_EQ(allocations.size(), (size_t) TOTAL_FRAMES);
+  ASSERT_EQ(app.get_tracker().get_car_count(), 0u);
+  // Once warmed up, frames of an empty road are captured, detected, tracked and written without a single allocation
+  for (int frame = WARM_UP_FRAMES; frame < EMPTY_FRAMES; frame++) {
+    ASSERT_EQ(allocations[frame], 0u) << "frame " << frame;
+  }
+  // The first vehicle grows the buffers, after which the road is again free of allocations once its trail has faded
+  for (int frame = SECOND_VEHICLE_FRAME - SETTLED_FRAMES; frame < SECOND_VEHICLE_FRAME; frame++) {
+    ASSERT_EQ(allocations[frame], 0u) << "frame " << frame;
+  }
+  for (int frame = SECOND_VEHICLE_FRAME; frame < SECOND_VEHICLE_FRAME + VEHICLE_FRAMES; frame++) {
+    ASSERT_EQ(allocations[frame], vehicle_frame_allocations(frame - SECOND_VEHICLE_FRAME)) << "frame " << frame;
+  }
+  for (int frame = TOTAL_FRAMES - SETTLED_FRAMES; frame < TOTAL_FRAMES; frame++) {
+    ASSERT_EQ(allocations[frame], 0u) << "frame " << frame;
+  }
+}
+
+TEST_F(AppConfigTest, skipped_frames_keep_a_vehicle_on_one_track) {
+  Tracker tracker;
+  BackgroundSubtractor bgs;
+  std::vector<cv::Point> crossing_lines;
+  std::vector<cv::Point> start_points;
+  std::vector<cv::Point> end_points;
+  AppConfig app(tracker, bgs, crossing_lines, start_points, end_points, "", 30.0, 640, 480, 4);
+  app.set_pipelined(false);
+  app.set_prefetch_frames(0);
+  app.set_headless(true);
+  app.set_continuous_recording(false);
+  app.get_speed_event_log().set_path(speed_log);
+  app.get_speed_event_log().set_format(SpeedLogFormat::CSV);
+  app.get_snapshot_writer().set_directory("tests/app_config/");
+
+  // Any processing time at all is pressure, so quality falls a level a frame to SKIP_FRAMES well before the vehicle
+  QualityController quality;
+  quality.set_degrade_load(0.0);
+  quality.set_recover_load(-1.0);
+  quality.set_degrade_frames(1);
+  app.set_quality_controller(quality);
+  app.set_adaptive_quality(true);
+
+  app.set_frame_source(cv::makePtr<LeftboundVehicle>());
+  app.run();
+  ASSERT_EQ(app.get_quality_controller().get_level(), QualityLevel::SKIP_FRAMES);
+
+  std::ifstream log(speed_log);
+  std::string header;
+  std::getline(log, header);
+  std::vector<std::string> events;
+  for (std::string line; std::getline(log, line);) {
+    events.push_back(line);
+  }
+  ASSERT_EQ(events.size(), 1u);
+
+  // vehicle_id,start_time,end_time,start_frame
+  std::stringstream fields(events[0]);
+  std::string field;
+  for (int column = 0; column < 4; column++) {
+    std::getline(fields, field, ',');
+  }
+  // Timed from the second frame it was detected on. A track aged by the skipped frames is retired within 10 frames,
+  // and the vehicle's last track would only start being timed part way across.
+  ASSERT_LE(std::stoi(field), EMPTY_FRAMES + 4);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "AssignmentSolver.hpp"
+
+static AssignmentEdge edge(int row, int col, double cost) {
+  AssignmentEdge assignment_edge;
+  assignment_edge.row = row;
+  assignment_edge.col = col;
+  assignment_edge.cost = cost;
+  return assignment_edge;
+}
+
+TEST(AssignmentSolverTest, prefers_lower_total_cost) {
+  // Greedily giving row 0 its cheapest column would leave row 1 with nothing
+  std::vector<AssignmentEdge> edges;
+  edges.push_back(edge(0, 0, 0.1));
+  edges.push_back(edge(0, 1, 0.2));
+  edges.push_back(edge(1, 0, 0.15));
+
+  AssignmentSolver solver;
+  std::vector<int> assignment;
+  solver.solve(2, 2, edges, assignment);
+
+  ASSERT_EQ(assignment.at(0), 1);
+  ASSERT_EQ(assignment.at(1), 0);
+}
+
+TEST(AssignmentSolverTest, each_column_used_once) {
+  std::vector<AssignmentEdge> edges;
+  edges.push_back(edge(0, 0, 0.3));
+  edges.push_back(edge(1, 0, 0.1));
+
+  AssignmentSolver solver;
+  std::vector<int> assignment;
+  solver.solve(2, 1, edges, assignment);
+
+  ASSERT_EQ(assignment.at(0), -1);
+  ASSERT_EQ(assignment.at(1), 0);
+}
+
+TEST(AssignmentSolverTest, rows_without_edges_are_unassigned) {
+  std::vector<AssignmentEdge> edges;
+  edges.push_back(edge(2, 4, 0.5));
+
+  AssignmentSolver solver;
+  std::vector<int> assignment;
+  solver.solve(3, 5, edges, assignment);
+
+  ASSERT_EQ(assignment.at(0), -1);
+  ASSERT_EQ(assignment.at(1), -1);
+  ASSERT_EQ(assignment.at(2), 4);
+}
+
+TEST(AssignmentSolverTest, independent_components) {
+  std::vector<AssignmentEdge> edges;
+  edges.push_back(edge(0, 0, 0.2));
+  edges.push_back(edge(1, 0, 0.1));
+  edges.push_back(edge(1, 1, 0.4));
+  edges.push_back(edge(2, 2, 0.9));
+  edges.push_back(edge(3, 3, 0.5));
+
+  AssignmentSolver solver;
+  std::vector<int> assignment;
+  solver.solve(4, 4, edges, assignment);
+
+  ASSERT_EQ(assignment.at(0), 0);
+  ASSERT_EQ(assignment.at(1), 1);
+  ASSERT_EQ(assignment.at(2), 2);
+  ASSERT_EQ(assignment.at(3), 3);
+}
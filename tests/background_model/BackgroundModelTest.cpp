@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "BackgroundModel.hpp"
+#include "BackgroundSubtractor.hpp"
+
+TEST(BackgroundModelTest, creates_requested_engine) {
+  ASSERT_EQ(BackgroundModel::create(BackgroundEngine::MOG2)->get_engine(), BackgroundEngine::MOG2);
+  ASSERT_EQ(BackgroundModel::create(BackgroundEngine::RUNNING_AVERAGE)->get_engine(),
+            BackgroundEngine::RUNNING_AVERAGE);
+}
+
+TEST(BackgroundModelTest, running_average_marks_moving_object) {
+  RunningAverageBackgroundModel model;
+  cv::Mat background(120, 160, CV_8UC3, cv::Scalar(40, 40, 40));
+  cv::Mat foreground;
+  for (int i = 0; i < 10; i++) {
+    model.apply(background, foreground);
+  }
+  ASSERT_EQ(cv::countNonZero(foreground), 0);
+
+  cv::Mat frame = background.clone();
+  cv::rectangle(frame, cv::Rect(50, 40, 30, 20), cv::Scalar(200, 200, 200), -1);
+  model.apply(frame, foreground);
+  ASSERT_EQ(cv::countNonZero(foreground), 30 * 20);
+  ASSERT_EQ(foreground.at<uchar>(50, 60), 255);
+}
+
+TEST(BackgroundModelTest, running_average_absorbs_stationary_object) {
+  RunningAverageBackgroundModel model(2, 25);
+  cv::Mat frame(60, 80, CV_8UC1, cv::Scalar(30));
+  cv::Mat foreground;
+  model.apply(frame, foreground);
+
+  cv::rectangle(frame, cv::Rect(10, 10, 20, 20), cv::Scalar(220), -1);
+  for (int i = 0; i < 40; i++) {
+    model.apply(frame, foreground);
+  }
+  ASSERT_EQ(cv::countNonZero(foreground), 0);
+}
+
+TEST(BackgroundModelTest, running_average_holds_still_without_updates) {
+  RunningAverageBackgroundModel model(2, 25);
+  cv::Mat frame(60, 80, CV_8UC1, cv::Scalar(30));
+  cv::Mat foreground;
+  model.apply(frame, foreground);
+
+  // Without updates a stationary object is never absorbed
+  cv::rectangle(frame, cv::Rect(10, 10, 20, 20), cv::Scalar(220), -1);
+  for (int i = 0; i < 40; i++) {
+    model.apply(frame, foreground, false);
+  }
+  ASSERT_EQ(cv::countNonZero(foreground), 20 * 20);
+}
+
+TEST(BackgroundModelTest, subtractor_runs_selected_engine) {
+  BackgroundSubtractor subtractor;
+  subtractor.set_engine(BackgroundEngine::RUNNING_AVERAGE);
+  cv::Mat frame(240, 320, CV_8UC3, cv::Scalar(50, 50, 50));
+  cv::Mat foreground;
+  subtractor.subtract(frame, foreground);
+
+  cv::rectangle(frame, cv::Rect(100, 100, 60, 40), cv::Scalar(250, 250, 250), -1);
+  subtractor.subtract(frame, foreground);
+  ASSERT_EQ(subtractor.get_engine(), BackgroundEngine::RUNNING_AVERAGE);
+  // The 3x3 erode trims a pixel from each side and the 6x6 close, anchored at (3, 3), shifts the result by one pixel
+  ASSERT_EQ(cv::boundingRect(foreground), cv::Rect(102, 102, 58, 38));
+}
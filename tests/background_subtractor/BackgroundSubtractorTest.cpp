@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <gtest/gtest.h>
 #include <opencv2/opencv.hpp>
 
@@ -19,3 +21,84 @@ TEST(BackgroundSubtractorTest, SubtractInvalidFrame) {
 }
 
 
+
+namespace {
+
+/**
+ * Runs a single model and a striped subtractor over a noisy scene with a vehicle moving down across the stripe
+ * boundaries, and returns the largest fraction of pixels on which their masks disagreed
+ */
+double striped_mask_difference(BackgroundEngine engine, int stripes) {
+  BackgroundSubtractor single;
+  single.set_engine(engine);
+  BackgroundSubtractor striped;
+  striped.set_engine(engine);
+  striped.set_stripes(stripes);
+  EXPECT_EQ(striped.get_stripes(), stripes);
+
+  cv::RNG rng(7);
+  cv::Mat background(240, 320, CV_8UC3);
+  rng.fill(background, cv::RNG::UNIFORM, cv::Scalar::all(40), cv::Scalar::all(90));
+  cv::Mat frame;
+  cv::Mat noise(background.size(), CV_8UC3);
+  cv::Mat single_foreground;
+  cv::Mat striped_foreground;
+  double worst = 0.0;
+  for (int i = 0; i < 60; i++) {
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(6));
+    cv::add(background, noise, frame);
+    if (i >= 30) {
+      cv::rectangle(frame, cv::Rect(120, 5 * (i - 30), 70, 45), cv::Scalar(230, 230, 230), -1);
+    }
+    single.subtract(frame, single_foreground);
+    striped.subtract(frame, striped_foreground);
+
+    cv::Mat difference;
+    cv::compare(single_foreground, striped_foreground, difference, cv::CMP_NE);
+    worst = std::max(worst, cv::countNonZero(difference) / (double) difference.total());
+  }
+  EXPECT_GT(cv::countNonZero(striped_foreground), 0);
+  return worst;
+}
+
+}
+
+TEST(BackgroundSubtractorTest, striped_running_average_matches_single_model) {
+  ASSERT_EQ(striped_mask_difference(BackgroundEngine::RUNNING_AVERAGE, 4), 0.0);
+  ASSERT_EQ(striped_mask_difference(BackgroundEngine::RUNNING_AVERAGE, 7), 0.0);
+}
+
+TEST(BackgroundSubtractorTest, striped_mog2_matches_single_model) {
+  ASSERT_LT(striped_mask_difference(BackgroundEngine::MOG2, 4), 0.001);
+}
+
+TEST(BackgroundSubtractorTest, working_sizes_keep_their_models) {
+  BackgroundSubtractor subtractor;
+  subtractor.set_engine(BackgroundEngine::RUNNING_AVERAGE);
+  const cv::Size full(320, 240);
+  const cv::Size half(160, 120);
+  ASSERT_FALSE(subtractor.set_working_size(full, RegionOfInterest()));
+
+  cv::Mat road(full, CV_8UC1, cv::Scalar(128));
+  cv::Mat small_road(half, CV_8UC1, cv::Scalar(128));
+  cv::Mat foreground;
+  for (int i = 0; i < 10; i++) {
+    subtractor.subtract(road, foreground);
+  }
+
+  // The first move to a size learns it afresh, and the move back resumes the model learnt at full size
+  ASSERT_FALSE(subtractor.set_working_size(half, RegionOfInterest()));
+  subtractor.subtract(small_road, foreground);
+  ASSERT_EQ(foreground.size(), half);
+  ASSERT_TRUE(subtractor.set_working_size(full, RegionOfInterest()));
+
+  // A fresh model would take this frame as its background, so the vehicle is only found by the resumed model
+  cv::Mat vehicle = road.clone();
+  vehicle(cv::Rect(100, 100, 60, 40)).setTo(cv::Scalar(30));
+  subtractor.subtract(vehicle, foreground);
+  ASSERT_GT(cv::countNonZero(foreground), 0);
+
+  ASSERT_TRUE(subtractor.set_working_size(half, RegionOfInterest()));
+  subtractor.set_region_of_interest(RegionOfInterest());
+  ASSERT_FALSE(subtractor.set_working_size(full, RegionOfInterest()));
+}
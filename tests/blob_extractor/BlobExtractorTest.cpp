@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "BlobExtractor.hpp"
+
+TEST(BlobExtractorTest, keeps_only_vehicle_sized_regions) {
+  cv::Mat foreground = cv::Mat::zeros(480, 640, CV_8UC1);
+  // A vehicle, a speck of noise, a region too large to be a vehicle and a thin diagonal line
+  cv::rectangle(foreground, cv::Rect(100, 100, 80, 60), cv::Scalar(255), -1);
+  cv::rectangle(foreground, cv::Rect(20, 20, 3, 3), cv::Scalar(255), -1);
+  cv::rectangle(foreground, cv::Rect(300, 250, 300, 200), cv::Scalar(255), -1);
+  cv::line(foreground, cv::Point(300, 20), cv::Point(400, 120), cv::Scalar(255), 3);
+
+  BlobExtractor extractor;
+  std::vector<Blob> blobs;
+  extractor.extract(foreground, blobs);
+
+  ASSERT_EQ(extractor.get_component_count(), 4);
+  // Only the vehicle and the diagonal line are sized like a vehicle, and the line is rejected by its fill
+  ASSERT_EQ(extractor.get_hull_count(), 2);
+  ASSERT_EQ(blobs.size(), 1u);
+  ASSERT_EQ(blobs.at(0).currentBoundingRect, cv::Rect(100, 100, 80, 60));
+}
+
+TEST(BlobExtractorTest, thresholds_are_configurable) {
+  cv::Mat foreground = cv::Mat::zeros(240, 320, CV_8UC1);
+  cv::rectangle(foreground, cv::Rect(10, 10, 30, 30), cv::Scalar(255), -1);
+
+  BlobExtractor extractor;
+  std::vector<Blob> blobs;
+  extractor.extract(foreground, blobs);
+  ASSERT_TRUE(blobs.empty());
+
+  BlobFilter filter;
+  filter.min_area = 100;
+  filter.min_width = 20;
+  filter.min_height = 20;
+  extractor.set_filter(filter);
+  extractor.extract(foreground, blobs);
+  ASSERT_EQ(blobs.size(), 1u);
+  ASSERT_EQ(blobs.at(0).currentBoundingRect.width, 30);
+}
+
+TEST(BlobExtractorTest, filter_scales_with_frame_size) {
+  BlobFilter filter;
+  const BlobFilter scaled = filter.scaled_to(cv::Size(1280, 720));
+  ASSERT_EQ(scaled.min_area, 3000);
+  ASSERT_EQ(scaled.max_area, 75000);
+  ASSERT_EQ(scaled.min_width, 100);
+  ASSERT_EQ(scaled.min_height, 75);
+  ASSERT_EQ(scaled.min_fill, filter.min_fill);
+  ASSERT_EQ(scaled.reference_size, cv::Size(1280, 720));
+
+  const BlobFilter unchanged = filter.scaled_to(filter.reference_size);
+  ASSERT_EQ(unchanged.min_area, filter.min_area);
+}
+
+TEST(BlobExtractorTest, maps_blobs_back_to_frame_resolution) {
+  // A 160x120 vehicle in a 1280x960 frame, detected on a mask downscaled by 4
+  cv::Mat foreground = cv::Mat::zeros(240, 320, CV_8UC1);
+  cv::rectangle(foreground, cv::Rect(50, 60, 40, 30), cv::Scalar(255), -1);
+
+  BlobExtractor extractor(BlobFilter().scaled_to(foreground.size()));
+  std::vector<Blob> blobs;
+  extractor.extract(foreground(cv::Rect(10, 20, 200, 200)), blobs, cv::Point(10, 20), 4.0);
+
+  ASSERT_EQ(blobs.size(), 1u);
+  const cv::Rect &rect = blobs.at(0).currentBoundingRect;
+  // Each mask pixel covers 4x4 frame pixels, and the outline is mapped to the centres of those blocks
+  ASSERT_NEAR(rect.x, 200, 2);
+  ASSERT_NEAR(rect.y, 240, 2);
+  ASSERT_NEAR(rect.width, 160, 4);
+  ASSERT_NEAR(rect.height, 120, 4);
+}
@@ -0,0 +1,97 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "BoundedQueue.hpp"
+
+TEST(BoundedQueueTest, preserves_order) {
+  BoundedQueue<int> queue(4);
+  std::thread producer([&queue]() {
+    for (int i = 0; i < 100; i++) {
+      queue.push(i);
+    }
+    queue.close();
+  });
+
+  int expected = 0;
+  int value;
+  while (queue.pop(value)) {
+    ASSERT_EQ(value, expected);
+    expected++;
+  }
+  producer.join();
+  ASSERT_EQ(expected, 100);
+}
+
+TEST(BoundedQueueTest, try_push_when_full) {
+  BoundedQueue<int> queue(2);
+  int value = 1;
+  ASSERT_TRUE(queue.try_push(value));
+  value = 2;
+  ASSERT_TRUE(queue.try_push(value));
+  value = 3;
+  ASSERT_FALSE(queue.try_push(value));
+  ASSERT_EQ(queue.size(), 2u);
+}
+
+TEST(BoundedQueueTest, close_drains_remaining_items) {
+  BoundedQueue<int> queue(4);
+  queue.push(1);
+  queue.push(2);
+  queue.close();
+  ASSERT_FALSE(queue.push(3));
+
+  int value;
+  ASSERT_TRUE(queue.pop(value));
+  ASSERT_EQ(value, 1);
+  ASSERT_TRUE(queue.pop(value));
+  ASSERT_EQ(value, 2);
+  ASSERT_FALSE(queue.pop(value));
+}
+
+TEST(BoundedQueueTest, pop_for_times_out_when_empty) {
+  BoundedQueue<int> queue(2);
+  int value = 0;
+  ASSERT_FALSE(queue.pop_for(value, std::chrono::milliseconds(5)));
+  ASSERT_FALSE(queue.is_closed());
+
+  queue.push(7);
+  ASSERT_TRUE(queue.pop_for(value, std::chrono::milliseconds(5)));
+  ASSERT_EQ(value, 7);
+
+  queue.close();
+  ASSERT_FALSE(queue.pop_for(value, std::chrono::seconds(10)));
+}
+
+TEST(BoundedQueueTest, reports_depth) {
+  BoundedQueue<int> queue(8);
+  queue.push(1);
+  queue.push(2);
+  queue.push(3);
+  int value;
+  queue.pop(value);
+
+  QueueStats stats = queue.get_stats("test");
+  ASSERT_EQ(stats.name, "test");
+  ASSERT_EQ(stats.capacity, 8u);
+  ASSERT_EQ(stats.max_depth, 3u);
+  ASSERT_DOUBLE_EQ(stats.mean_depth, 2.0);
+}
+
+TEST(BoundedQueueTest, push_swap_recycles_popped_items) {
+  BoundedQueue<int> queue(1);
+  int produced = 1;
+  ASSERT_TRUE(queue.push_swap(produced));
+  ASSERT_EQ(produced, 0);
+
+  // The consumer leaves its previous item in the slot, and the producer receives it on the next push
+  int consumed = 42;
+  ASSERT_TRUE(queue.pop(consumed));
+  ASSERT_EQ(consumed, 1);
+  produced = 2;
+  ASSERT_TRUE(queue.push_swap(produced));
+  ASSERT_EQ(produced, 42);
+
+  queue.close();
+  ASSERT_FALSE(queue.push_swap(produced));
+}
@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "ClipRecorder.hpp"
+
+class ClipRecorderTest : public ::testing::Test {
+ protected:
+  const std::string directory = "tests/clip_recorder/";
+
+  virtual void TearDown() {
+    for (int id = 1; id <= 3; id++) {
+      std::remove((directory + std::to_string(id) + ".avi").c_str());
+    }
+  }
+
+  void configure(ClipRecorder &recorder) {
+    recorder.set_directory(directory);
+    recorder.set_fourcc(CV_FOURCC('M', 'J', 'P', 'G'), ".avi");
+    recorder.set_pre_roll(1.0);
+    recorder.set_post_roll(1.0);
+    recorder.set_fps(10.0);
+  }
+
+  int clip_frames(int id) {
+    cv::VideoCapture clip(directory + std::to_string(id) + ".avi");
+    int frames = 0;
+    cv::Mat frame;
+    while (clip.read(frame)) {
+      frames++;
+    }
+    return frames;
+  }
+};
+
+static SpeedEvent make_event(unsigned int id, unsigned int start_frame, unsigned int end_frame, double speed) {
+  SpeedEvent event;
+  event.vehicle_id = id;
+  event.start_frame = start_frame;
+  event.end_frame = end_frame;
+  event.speed = speed;
+  return event;
+}
+
+TEST_F(ClipRecorderTest, records_pre_and_post_roll) {
+  ClipRecorder recorder;
+  configure(recorder);
+  recorder.open();
+
+  const cv::Mat frame(120, 160, CV_8UC3, cv::Scalar(50, 100, 150));
+  for (unsigned int i = 0; i < 60; i++) {
+    recorder.push(frame, i, i / 10.0);
+    // The vehicle is timed from frame 20 to frame 30, and reported once frame 30 has been tracked
+    if (i == 30) {
+      ASSERT_TRUE(recorder.request(make_event(1, 20, 30, 80.0)));
+    }
+  }
+  recorder.close();
+
+  ASSERT_EQ(recorder.get_written(), 1u);
+  ASSERT_EQ(recorder.get_failed(), 0u);
+  // One second either side of frames 20 to 30 at 10 frames per second
+  ASSERT_EQ(clip_frames(1), 31);
+}
+
+TEST_F(ClipRecorderTest, skips_slow_vehicles_and_cuts_pending_clips_on_close) {
+  ClipRecorder recorder;
+  configure(recorder);
+  recorder.set_min_speed(50.0);
+  ASSERT_FALSE(recorder.request(make_event(1, 0, 5, 80.0)));
+  recorder.open();
+
+  const cv::Mat frame(120, 160, CV_8UC3, cv::Scalar(50, 100, 150));
+  for (unsigned int i = 0; i < 20; i++) {
+    recorder.push(frame, i, i / 10.0);
+  }
+  ASSERT_FALSE(recorder.request(make_event(2, 5, 15, 30.0)));
+  ASSERT_TRUE(recorder.request(make_event(3, 10, 15, 90.0)));
+  recorder.close();
+
+  ASSERT_EQ(recorder.get_written(), 1u);
+  // From one second before frame 10 until the stream ended at frame 19, short of the post-roll
+  ASSERT_EQ(clip_frames(3), 20);
+}
+
+TEST_F(ClipRecorderTest, frames_may_be_reused_once_pushed) {
+  ClipRecorder recorder;
+  configure(recorder);
+  recorder.open();
+
+  // The pipeline draws the next frame into the same buffer as soon as the last one has been pushed
+  cv::Mat frame(120, 160, CV_8UC3);
+  for (unsigned int i = 0; i < 40; i++) {
+    frame.setTo(cv::Scalar::all(i < 20 ? 200 : 0));
+    recorder.push(frame, i, i / 10.0);
+    if (i == 15) {
+      ASSERT_TRUE(recorder.request(make_event(1, 12, 15, 80.0)));
+    }
+  }
+  recorder.close();
+
+  ASSERT_EQ(recorder.get_written(), 1u);
+  // Frames 2 to 25, of which frames 2 to 19 were bright when they were pushed
+  cv::VideoCapture clip(directory + "1.avi");
+  cv::Mat decoded;
+  int bright = 0;
+  int frames = 0;
+  while (clip.read(decoded)) {
+    frames++;
+    if (cv::mean(decoded)[0] > 100) {
+      bright++;
+    }
+  }
+  ASSERT_EQ(frames, 24);
+  ASSERT_EQ(bright, 18);
+}
@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "FrameCache.hpp"
+
+namespace {
+const std::string cache_path = "tests/frame_cache/test.frames";
+
+/**
+ * Writes count frames of 16x8 to the cache, each filled with 10 times its index and stamped 40ms apart
+ */
+void write_cache(int count, RawPixelFormat format) {
+  FrameCacheWriter writer;
+  ASSERT_TRUE(writer.open(cache_path, cv::Size(16, 8), format, 25.0));
+  const int type = format == RawPixelFormat::GRAY ? CV_8UC1 : CV_8UC3;
+  for (int i = 0; i < count; i++) {
+    ASSERT_TRUE(writer.write(cv::Mat(8, 16, type, cv::Scalar::all(10 * i)), 1.0 + i * 0.04));
+  }
+  ASSERT_EQ(writer.get_frame_count(), (uint32_t) count);
+  ASSERT_TRUE(writer.close());
+}
+}
+
+TEST(FrameCacheTest, replays_frames_and_timestamps) {
+  write_cache(5, RawPixelFormat::BGR);
+  cv::Ptr<FrameSource> source = FrameSource::create(cache_path);
+  ASSERT_TRUE(source->open());
+  ASSERT_EQ(source->get_frame_size(), cv::Size(16, 8));
+  ASSERT_DOUBLE_EQ(source->get_fps(), 25.0);
+
+  SourceFrame frame;
+  for (unsigned int i = 0; i < 5; i++) {
+    ASSERT_TRUE(source->read(frame));
+    ASSERT_EQ(frame.index, i);
+    ASSERT_DOUBLE_EQ(frame.timestamp, 1.0 + i * 0.04);
+    ASSERT_EQ(frame.image.type(), CV_8UC3);
+    ASSERT_NE(frame.lease, nullptr);
+    ASSERT_EQ(frame.image.at<cv::Vec3b>(7, 15)[2], 10 * i);
+  }
+  ASSERT_FALSE(source->read(frame));
+  source->close();
+  std::remove(cache_path.c_str());
+}
+
+TEST(FrameCacheTest, drawing_on_a_frame_leaves_the_cache_untouched) {
+  write_cache(1, RawPixelFormat::BGR);
+  MappedFrameSource source(cache_path);
+  SourceFrame frame;
+  ASSERT_TRUE(source.open());
+  ASSERT_TRUE(source.read(frame));
+  frame.image.setTo(cv::Scalar(255, 255, 255));
+  frame = SourceFrame();
+  source.close();
+
+  ASSERT_TRUE(source.open());
+  ASSERT_TRUE(source.read(frame));
+  ASSERT_EQ(frame.image.at<cv::Vec3b>(0, 0)[0], 0);
+  source.close();
+  std::remove(cache_path.c_str());
+}
+
+TEST(FrameCacheTest, gray_frames_are_converted_unless_raw_requested) {
+  write_cache(2, RawPixelFormat::GRAY);
+  MappedFrameSource source(cache_path);
+  ASSERT_TRUE(source.open());
+  ASSERT_EQ(source.get_format(), RawPixelFormat::GRAY);
+  ASSERT_FALSE(source.is_raw());
+
+  SourceFrame frame;
+  ASSERT_TRUE(source.read(frame));
+  ASSERT_EQ(frame.image.type(), CV_8UC3);
+  ASSERT_EQ(frame.lease, nullptr);
+
+  source.set_raw_requested(true);
+  ASSERT_TRUE(source.open());
+  ASSERT_TRUE(source.is_raw());
+  ASSERT_TRUE(source.read(frame));
+  ASSERT_EQ(frame.image.type(), CV_8UC1);
+  ASSERT_NE(frame.lease, nullptr);
+  source.close();
+  std::remove(cache_path.c_str());
+}
+
+TEST(FrameCacheTest, rejects_mismatched_frames_and_other_files) {
+  FrameCacheWriter writer;
+  ASSERT_TRUE(writer.open(cache_path, cv::Size(16, 8), RawPixelFormat::BGR, 25.0));
+  ASSERT_FALSE(writer.write(cv::Mat(8, 16, CV_8UC1, cv::Scalar(0)), 0.0));
+  ASSERT_FALSE(writer.write(cv::Mat(4, 16, CV_8UC3, cv::Scalar::all(0)), 0.0));
+  ASSERT_TRUE(writer.close());
+
+  std::ofstream other(cache_path, std::ios::trunc);
+  other << std::string(256, 'x');
+  other.close();
+  MappedFrameSource source(cache_path);
+  ASSERT_FALSE(source.open());
+  std::remove(cache_path.c_str());
+}
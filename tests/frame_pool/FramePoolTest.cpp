@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "AllocationCounter.hpp"
+#include "BoundedQueue.hpp"
+#include "FramePool.hpp"
+
+TEST(FramePoolTest, acquire_and_release) {
+  FramePool pool(2, cv::Size(640, 480), CV_8UC3, 8);
+  ASSERT_EQ(pool.get_available(), 2u);
+
+  FramePacket *first = pool.acquire();
+  FramePacket *second = pool.acquire();
+  ASSERT_NE(first, second);
+  ASSERT_EQ(pool.get_available(), 0u);
+  ASSERT_EQ(first->frame.rows, 480);
+  ASSERT_EQ(first->frame.cols, 640);
+  ASSERT_EQ(first->foreground.type(), CV_8UC1);
+
+  pool.release(first);
+  pool.release(second);
+  ASSERT_EQ(pool.get_available(), 2u);
+}
+
+TEST(FramePoolTest, acquire_after_close) {
+  FramePool pool(1, cv::Size(64, 48), CV_8UC3, 8);
+  FramePacket *packet = pool.acquire();
+  pool.close();
+  ASSERT_EQ(pool.acquire(), nullptr);
+  pool.release(packet);
+}
+
+TEST(FramePoolTest, steady_state_does_not_allocate) {
+  if (!allocation_counting_enabled()) {
+    GTEST_SKIP() << "Built without TRAFFIC_MONITOR_COUNT_ALLOCATIONS";
+  }
+
+  const cv::Size frame_size(640, 480);
+  FramePool pool(4, frame_size, CV_8UC3, 8);
+  BoundedQueue<FramePacket *> queue(4);
+  cv::Mat source(frame_size, CV_8UC3, cv::Scalar(10, 20, 30));
+  cv::Mat mask(frame_size, CV_8UC1, cv::Scalar(255));
+
+  // One cycle through the pool, the queue and the frame buffers
+  auto cycle = [&]() {
+    FramePacket *packet = pool.acquire();
+    source.copyTo(packet->frame);
+    mask.copyTo(packet->foreground);
+    queue.push(packet);
+    FramePacket *received = nullptr;
+    queue.pop(received);
+    pool.release(received);
+  };
+
+  // Warm up
+  for (int i = 0; i < 8; i++) {
+    cycle();
+  }
+
+  unsigned long long allocations = 0;
+  {
+    ScopedAllocationCounter count_allocations(allocations);
+    for (int i = 0; i < 100; i++) {
+      cycle();
+    }
+  }
+  ASSERT_EQ(allocations, 0u);
+}
+
+TEST(FramePoolTest, allocates_working_buffers) {
+  FramePool pool(1, cv::Size(1920, 1080), CV_8UC3, 8, cv::Size(960, 540));
+  FramePacket *packet = pool.acquire();
+  ASSERT_EQ(packet->frame.size(), cv::Size(1920, 1080));
+  ASSERT_EQ(packet->working_frame.size(), cv::Size(960, 540));
+  ASSERT_EQ(packet->working_frame.type(), CV_8UC3);
+  ASSERT_EQ(packet->foreground.size(), cv::Size(960, 540));
+  pool.release(packet);
+}
@@ -0,0 +1,60 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "FrameRingBuffer.hpp"
+
+static cv::Mat numbered_frame(int number) {
+  return cv::Mat(120, 160, CV_8UC3, cv::Scalar::all(number % 256));
+}
+
+TEST(FrameRingBufferTest, keeps_only_the_last_duration) {
+  FrameRingBuffer buffer;
+  buffer.set_duration(1.0);
+  buffer.set_jpeg_quality(0);
+  for (unsigned int i = 0; i < 100; i++) {
+    buffer.push(numbered_frame(i), i, i / 30.0);
+  }
+  // Frames 69 to 99 span exactly one second
+  ASSERT_EQ(buffer.size(), 31u);
+  ASSERT_EQ(buffer.oldest().frame_count, 69u);
+  ASSERT_EQ(buffer.newest().frame_count, 99u);
+  ASSERT_EQ(buffer.get_bytes(), 31u * 120 * 160 * 3);
+
+  double timestamp = 0.0;
+  ASSERT_TRUE(buffer.find(80, timestamp));
+  ASSERT_DOUBLE_EQ(timestamp, 80 / 30.0);
+  ASSERT_FALSE(buffer.find(10, timestamp));
+}
+
+TEST(FrameRingBufferTest, stays_within_memory_limit) {
+  FrameRingBuffer buffer;
+  buffer.set_jpeg_quality(0);
+  buffer.set_memory_limit(10 * 120 * 160 * 3);
+  for (unsigned int i = 0; i < 50; i++) {
+    buffer.push(numbered_frame(i), i, i / 30.0);
+  }
+  ASSERT_EQ(buffer.size(), 10u);
+  ASSERT_EQ(buffer.oldest().frame_count, 40u);
+}
+
+TEST(FrameRingBufferTest, compressed_frames_decode_and_are_shared) {
+  FrameRingBuffer buffer;
+  for (unsigned int i = 0; i < 10; i++) {
+    buffer.push(numbered_frame(100 + 10 * i), i, i * 0.1);
+  }
+  ASSERT_LT(buffer.get_bytes(), 10u * 120 * 160 * 3 / 10);
+
+  std::vector<BufferedFrame> collected;
+  buffer.collect(0.25, 0.55, collected);
+  ASSERT_EQ(collected.size(), 3u);
+  ASSERT_EQ(collected.front().frame_count, 3u);
+
+  // Collected frames outlive the buffer
+  buffer.clear();
+  cv::Mat frame;
+  ASSERT_TRUE(collected.front().decode(frame));
+  ASSERT_EQ(frame.size(), cv::Size(160, 120));
+  ASSERT_NEAR(frame.at<cv::Vec3b>(60, 80)[0], 130, 2);
+}
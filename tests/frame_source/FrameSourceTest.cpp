@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "FrameSource.hpp"
+
+namespace {
+const std::string raw_path = "tests/frame_source/frames.raw";
+
+/**
+ * Writes count grayscale frames of 8x4 to the raw file, each filled with its index
+ */
+void write_raw_frames(int count) {
+  std::FILE *file = std::fopen(raw_path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  for (int i = 0; i < count; i++) {
+    cv::Mat frame(4, 8, CV_8UC1, cv::Scalar(i));
+    std::fwrite(frame.data, 1, frame.total(), file);
+  }
+  std::fclose(file);
+}
+}
+
+TEST(FrameSourceTest, raw_file_numbers_and_times_frames) {
+  write_raw_frames(3);
+  RawFileFrameSource source(raw_path, cv::Size(8, 4), RawPixelFormat::GRAY);
+  source.set_fps(10.0);
+  source.set_raw_requested(true);
+  ASSERT_TRUE(source.open());
+  ASSERT_TRUE(source.is_raw());
+  ASSERT_EQ(source.get_frame_size(), cv::Size(8, 4));
+
+  SourceFrame frame;
+  for (unsigned int i = 0; i < 3; i++) {
+    ASSERT_TRUE(source.read(frame));
+    ASSERT_EQ(frame.index, i);
+    ASSERT_NEAR(frame.timestamp, i * 0.1, 1e-9);
+    ASSERT_EQ(frame.image.type(), CV_8UC1);
+    ASSERT_EQ(frame.image.at<unsigned char>(3, 7), i);
+  }
+  ASSERT_FALSE(source.read(frame));
+  source.close();
+  std::remove(raw_path.c_str());
+}
+
+TEST(FrameSourceTest, raw_file_converts_to_bgr_unless_raw_requested) {
+  write_raw_frames(1);
+  RawFileFrameSource source(raw_path, cv::Size(8, 4), RawPixelFormat::GRAY);
+  ASSERT_TRUE(source.open());
+  ASSERT_FALSE(source.is_raw());
+
+  SourceFrame frame;
+  ASSERT_TRUE(source.read(frame));
+  ASSERT_EQ(frame.image.type(), CV_8UC3);
+  ASSERT_EQ(frame.image.size(), cv::Size(8, 4));
+  source.close();
+  std::remove(raw_path.c_str());
+}
+
+TEST(FrameSourceTest, prefetching_delivers_every_frame_in_order) {
+  write_raw_frames(50);
+  cv::Ptr<FrameSource> raw = cv::makePtr<RawFileFrameSource>(raw_path, cv::Size(8, 4), RawPixelFormat::GRAY);
+  raw->set_raw_requested(true);
+  PrefetchingFrameSource source(raw, 2);
+  ASSERT_TRUE(source.open());
+  ASSERT_TRUE(source.is_raw());
+  ASSERT_EQ(source.get_frame_size(), cv::Size(8, 4));
+
+  // Buffers handed back by each read are decoded into again, so every frame must still carry its own pixels
+  SourceFrame frame;
+  unsigned int count = 0;
+  while (source.read(frame)) {
+    ASSERT_EQ(frame.index, count);
+    ASSERT_EQ(frame.image.at<unsigned char>(0, 0), count);
+    count++;
+  }
+  ASSERT_EQ(count, 50u);
+  ASSERT_LE(source.get_stats("prefetch").max_depth, 2u);
+  source.close();
+  std::remove(raw_path.c_str());
+}
+
+TEST(FrameSourceTest, image_sequence_starts_at_one) {
+  const std::string pattern = "tests/frame_source/image_%03d.png";
+  char path[64];
+  for (int i = 1; i <= 3; i++) {
+    std::snprintf(path, sizeof(path), pattern.c_str(), i);
+    cv::imwrite(path, cv::Mat(6, 10, CV_8UC3, cv::Scalar(10 * i, 0, 0)));
+  }
+
+  cv::Ptr<FrameSource> source = FrameSource::create(pattern);
+  source->set_fps(20.0);
+  ASSERT_TRUE(source->open());
+  ASSERT_EQ(source->get_frame_size(), cv::Size(10, 6));
+
+  SourceFrame frame;
+  for (unsigned int i = 0; i < 3; i++) {
+    ASSERT_TRUE(source->read(frame));
+    ASSERT_EQ(frame.index, i);
+    ASSERT_NEAR(frame.timestamp, i * 0.05, 1e-9);
+    ASSERT_EQ(frame.image.at<cv::Vec3b>(0, 0)[0], 10 * (i + 1));
+  }
+  ASSERT_FALSE(source->read(frame));
+  source->close();
+
+  for (int i = 1; i <= 3; i++) {
+    std::snprintf(path, sizeof(path), pattern.c_str(), i);
+    std::remove(path);
+  }
+}
+
+TEST(FrameSourceTest, missing_sources_fail_to_open) {
+  ASSERT_FALSE(FrameSource::create("tests/frame_source/missing_%03d.png")->open());
+  RawFileFrameSource raw("tests/frame_source/missing.raw", cv::Size(8, 4), RawPixelFormat::YUYV);
+  ASSERT_FALSE(raw.open());
+}
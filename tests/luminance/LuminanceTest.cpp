@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "BackgroundSubtractor.hpp"
+#include "Luminance.hpp"
+
+TEST(LuminanceTest, shares_grayscale_frames) {
+  cv::Mat frame(48, 64, CV_8UC1, cv::Scalar(90));
+  cv::Mat luminance;
+  extract_luminance(frame, luminance);
+  ASSERT_EQ(luminance.data, frame.data);
+}
+
+TEST(LuminanceTest, takes_luma_plane_of_yuyv) {
+  // Y0 U Y1 V: a luma byte alternates with a chroma byte
+  cv::Mat frame(2, 4, CV_8UC2);
+  for (int row = 0; row < frame.rows; row++) {
+    for (int col = 0; col < frame.cols; col++) {
+      frame.at<cv::Vec2b>(row, col) = cv::Vec2b((uchar) (10 * row + col), (uchar) (col % 2 == 0 ? 100 : 200));
+    }
+  }
+  cv::Mat luminance;
+  extract_luminance(frame, luminance);
+  ASSERT_EQ(luminance.type(), CV_8UC1);
+  ASSERT_EQ(luminance.size(), frame.size());
+  ASSERT_EQ(luminance.at<uchar>(1, 3), 13);
+}
+
+TEST(LuminanceTest, converts_bgr_once) {
+  cv::RNG rng(5);
+  cv::Mat frame(30, 40, CV_8UC3);
+  rng.fill(frame, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+  cv::Mat expected;
+  cv::cvtColor(frame, expected, cv::COLOR_BGR2GRAY);
+
+  cv::Mat luminance(30, 40, CV_8UC1);
+  const uchar *data = luminance.data;
+  extract_luminance(frame, luminance);
+  ASSERT_EQ(luminance.data, data);
+  ASSERT_EQ(cv::countNonZero(luminance != expected), 0);
+}
+
+TEST(LuminanceTest, converts_yuyv_to_bgr) {
+  // Neutral chroma gives a gray pixel with the brightness of the luma
+  cv::Mat frame(4, 8, CV_8UC2, cv::Scalar(120, 128));
+  cv::Mat bgr;
+  convert_to_bgr(frame, bgr);
+  ASSERT_EQ(bgr.type(), CV_8UC3);
+  const cv::Vec3b pixel = bgr.at<cv::Vec3b>(2, 5);
+  ASSERT_NEAR(pixel[0], pixel[2], 2);
+  ASSERT_NEAR(pixel[1], 120, 20);
+}
+
+TEST(LuminanceTest, subtractor_detects_on_luminance) {
+  BackgroundSubtractor subtractor;
+  cv::Mat frame(240, 320, CV_8UC1, cv::Scalar(50));
+  cv::Mat foreground;
+  for (int i = 0; i < 20; i++) {
+    subtractor.subtract(frame, foreground);
+  }
+  cv::rectangle(frame, cv::Rect(100, 100, 60, 40), cv::Scalar(250), -1);
+  subtractor.subtract(frame, foreground);
+  ASSERT_EQ(foreground.type(), CV_8UC1);
+  ASSERT_GT(cv::countNonZero(foreground(cv::Rect(100, 100, 60, 40))), 60 * 40 / 2);
+}
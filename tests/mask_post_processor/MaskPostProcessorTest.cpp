@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "MaskPostProcessor.hpp"
+
+static const SimdPath ALL_PATHS[] = {SimdPath::SCALAR, SimdPath::SSE2, SimdPath::AVX2, SimdPath::NEON};
+
+// The sequence MaskPostProcessor replaces
+static cv::Mat reference(const cv::Mat &input, int threshold, bool enable_threshold, bool enable_open_close) {
+  cv::Mat output = input.clone();
+  if (enable_threshold) {
+    cv::threshold(output, output, threshold, 255, cv::THRESH_BINARY);
+  }
+  if (enable_open_close) {
+    cv::Mat erode_element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3), cv::Point(-1, -1));
+    cv::Mat close_element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(6, 6), cv::Point(-1, -1));
+    cv::morphologyEx(output, output, cv::MORPH_ERODE, erode_element);
+    cv::morphologyEx(output, output, cv::MORPH_CLOSE, close_element);
+  }
+  return output;
+}
+
+static cv::Mat random_mask(int rows, int cols, unsigned int seed) {
+  cv::RNG rng(seed);
+  cv::Mat mask(rows, cols, CV_8UC1);
+  rng.fill(mask, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+  return mask;
+}
+
+static void expect_matches_reference(const cv::Mat &input, int threshold, bool enable_threshold,
+                                     bool enable_open_close) {
+  const cv::Mat expected = reference(input, threshold, enable_threshold, enable_open_close);
+  for (SimdPath path : ALL_PATHS) {
+    if (!MaskPostProcessor::is_supported(path)) {
+      continue;
+    }
+    MaskPostProcessor post_processor(threshold, enable_threshold, enable_open_close);
+    post_processor.set_simd_path(path);
+
+    cv::Mat output;
+    post_processor.apply(input, output);
+    ASSERT_EQ(cv::countNonZero(output != expected), 0)
+        << MaskPostProcessor::simd_path_name(path) << " " << input.cols << "x" << input.rows;
+
+    // The output may be the input buffer, as it is within BackgroundSubtractor::subtract()
+    cv::Mat in_place = input.clone();
+    post_processor.apply(in_place, in_place);
+    ASSERT_EQ(cv::countNonZero(in_place != expected), 0)
+        << MaskPostProcessor::simd_path_name(path) << " in place " << input.cols << "x" << input.rows;
+  }
+}
+
+TEST(MaskPostProcessorTest, bit_exact_with_opencv) {
+  const cv::Size sizes[] = {cv::Size(1, 1), cv::Size(7, 1), cv::Size(1, 7), cv::Size(5, 5), cv::Size(17, 33),
+                            cv::Size(65, 35), cv::Size(257, 101), cv::Size(640, 480), cv::Size(1920, 13)};
+  unsigned int seed = 1;
+  for (const cv::Size &size : sizes) {
+    const cv::Mat input = random_mask(size.height, size.width, seed++);
+    expect_matches_reference(input, 160, true, true);
+    expect_matches_reference(input, 0, true, true);
+    expect_matches_reference(input, 254, true, true);
+  }
+}
+
+TEST(MaskPostProcessorTest, bit_exact_with_stages_disabled) {
+  const cv::Mat input = random_mask(120, 161, 42);
+  expect_matches_reference(input, 160, false, true);
+  expect_matches_reference(input, 160, true, false);
+  expect_matches_reference(input, 160, false, false);
+  expect_matches_reference(input, 255, true, true);
+  expect_matches_reference(input, -1, true, true);
+}
+
+TEST(MaskPostProcessorTest, bit_exact_on_vehicle_shaped_mask) {
+  // Mostly background with solid vehicles, shadows at the MOG2 shadow value and scattered noise
+  cv::Mat input = cv::Mat::zeros(480, 640, CV_8UC1);
+  cv::RNG rng(7);
+  for (int i = 0; i < 2000; i++) {
+    input.at<uchar>(rng.uniform(0, 480), rng.uniform(0, 640)) = (uchar) (rng.uniform(0, 2) ? 255 : 127);
+  }
+  cv::rectangle(input, cv::Rect(100, 100, 120, 70), cv::Scalar(255), -1);
+  cv::rectangle(input, cv::Rect(400, 300, 90, 60), cv::Scalar(255), -1);
+  cv::rectangle(input, cv::Rect(220, 110, 30, 60), cv::Scalar(127), -1);
+  expect_matches_reference(input, 160, true, true);
+}
+
+TEST(MaskPostProcessorTest, reuses_output_buffer) {
+  const cv::Mat input = random_mask(48, 64, 3);
+  cv::Mat output(48, 64, CV_8UC1);
+  const uchar *data = output.data;
+
+  MaskPostProcessor post_processor;
+  post_processor.apply(input, output);
+  ASSERT_EQ(output.data, data);
+}
+
+TEST(MaskPostProcessorTest, bands_stitch_without_seams) {
+  const cv::Mat input = random_mask(97, 130, 11);
+  const cv::Mat expected = reference(input, 160, true, true);
+  MaskPostProcessor post_processor;
+  std::vector<unsigned char> band_scratch;
+  for (int bands = 1; bands <= 16; bands++) {
+    cv::Mat output(input.size(), CV_8UC1, cv::Scalar(1));
+    for (int band = 0; band < bands; band++) {
+      post_processor.apply_rows(input, output, input.rows * band / bands, input.rows * (band + 1) / bands,
+                                band_scratch);
+    }
+    ASSERT_EQ(cv::countNonZero(output != expected), 0) << bands << " bands";
+  }
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "MotionGate.hpp"
+
+// An empty road with a little sensor noise
+static cv::Mat road_frame(cv::RNG &rng) {
+  cv::Mat frame(240, 320, CV_8UC3, cv::Scalar(60, 60, 60));
+  cv::Mat noise(frame.size(), CV_8UC3);
+  rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(4));
+  cv::add(frame, noise, frame);
+  return frame;
+}
+
+TEST(MotionGateTest, stays_idle_on_empty_road) {
+  MotionGate gate;
+  cv::RNG rng(1);
+  for (int i = 0; i < 50; i++) {
+    ASSERT_FALSE(gate.update(road_frame(rng)));
+  }
+  ASSERT_EQ(gate.get_state(), GateState::IDLE);
+  ASSERT_EQ(gate.get_frames(), 50u);
+  ASSERT_EQ(gate.get_activations(), 0u);
+  ASSERT_EQ(gate.get_duty_cycle(), 0.0);
+}
+
+TEST(MotionGateTest, opens_on_vehicle_and_closes_once_quiet) {
+  MotionGate gate;
+  gate.set_hold_frames(5);
+  cv::RNG rng(2);
+  for (int i = 0; i < 20; i++) {
+    gate.update(road_frame(rng));
+  }
+
+  // A vehicle drives across the road for 10 frames
+  for (int i = 0; i < 10; i++) {
+    cv::Mat frame = road_frame(rng);
+    cv::rectangle(frame, cv::Rect(20 + 25 * i, 100, 60, 40), cv::Scalar(220, 220, 220), -1);
+    ASSERT_TRUE(gate.update(frame)) << "frame " << i;
+    ASSERT_GT(gate.get_changed_fraction(), gate.get_min_changed_fraction());
+  }
+  ASSERT_EQ(gate.get_activations(), 1u);
+
+  for (int i = 0; i < 60; i++) {
+    gate.update(road_frame(rng));
+  }
+  ASSERT_FALSE(gate.is_active());
+  ASSERT_EQ(gate.get_activations(), 1u);
+  ASSERT_GT(gate.get_duty_cycle(), 10.0 / 90.0 - 1e-9);
+  ASSERT_LT(gate.get_duty_cycle(), 0.5);
+}
+
+TEST(MotionGateTest, ignores_motion_outside_region) {
+  MotionGate gate;
+  gate.set_region_of_interest(RegionOfInterest(
+      {{cv::Point(160, 0), cv::Point(319, 0), cv::Point(319, 239), cv::Point(160, 239)}}));
+  cv::RNG rng(3);
+  gate.update(road_frame(rng));
+
+  cv::Mat frame = road_frame(rng);
+  cv::rectangle(frame, cv::Rect(20, 100, 60, 40), cv::Scalar(220, 220, 220), -1);
+  ASSERT_FALSE(gate.update(frame));
+
+  frame = road_frame(rng);
+  cv::rectangle(frame, cv::Rect(200, 100, 60, 40), cv::Scalar(220, 220, 220), -1);
+  ASSERT_TRUE(gate.update(frame));
+}
+
+TEST(MotionGateTest, reset_clears_metrics) {
+  MotionGate gate;
+  cv::RNG rng(4);
+  gate.update(road_frame(rng));
+  cv::Mat frame = road_frame(rng);
+  cv::rectangle(frame, cv::Rect(100, 100, 60, 40), cv::Scalar(220, 220, 220), -1);
+  ASSERT_TRUE(gate.update(frame));
+
+  gate.reset();
+  ASSERT_FALSE(gate.is_active());
+  ASSERT_EQ(gate.get_frames(), 0u);
+  ASSERT_EQ(gate.get_active_frames(), 0u);
+  // The sampled background is forgotten too, so the first frame after a reset only seeds it
+  ASSERT_FALSE(gate.update(frame));
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include "MotionModel.hpp"
+
+TEST(MotionModelTest, new_track_predicts_its_initial_velocity) {
+  MotionModel model;
+  model.begin_frame();
+  int slot = model.add(cv::Point(100, 50), cv::Point(4, -2));
+
+  model.begin_frame();
+  slot = model.carry(slot);
+  model.predict();
+
+  ASSERT_EQ(model.get_position(slot).x, 104);
+  ASSERT_EQ(model.get_position(slot).y, 48);
+}
+
+TEST(MotionModelTest, learns_constant_velocity) {
+  MotionModel model;
+  model.begin_frame();
+  int slot = model.add(cv::Point(0, 200), cv::Point(0, 0));
+
+  for (int frame = 1; frame <= 30; frame++) {
+    model.begin_frame();
+    slot = model.carry(slot);
+    model.predict();
+    model.correct(slot, cv::Point(6 * frame, 200 - 3 * frame));
+  }
+
+  ASSERT_EQ(model.get_velocity(slot).x, 6);
+  ASSERT_EQ(model.get_velocity(slot).y, -3);
+
+  model.begin_frame();
+  slot = model.carry(slot);
+  model.predict();
+  ASSERT_NEAR(model.get_position(slot).x, 6 * 31, 1);
+  ASSERT_NEAR(model.get_position(slot).y, 200 - 3 * 31, 1);
+}
+
+TEST(MotionModelTest, uncarried_tracks_are_dropped) {
+  MotionModel model;
+  model.begin_frame();
+  int kept = model.add(cv::Point(10, 10), cv::Point(1, 0));
+  model.add(cv::Point(500, 500), cv::Point(-1, 0));
+  ASSERT_EQ(model.size(), 2u);
+
+  model.begin_frame();
+  kept = model.carry(kept);
+  ASSERT_EQ(model.size(), 1u);
+  ASSERT_EQ(kept, 0);
+  ASSERT_EQ(model.get_position(kept).x, 10);
+
+  // Slots from two frames ago are no longer valid
+  model.begin_frame();
+  ASSERT_EQ(model.carry(1), -1);
+}
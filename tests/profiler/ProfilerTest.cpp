@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "Profiler.hpp"
+
+namespace {
+const std::string trace_path = "tests/profiler/test_trace.json";
+
+const StageSummary *find_stage(const std::vector<StageSummary> &summaries, const std::string &name) {
+  for (const StageSummary &summary : summaries) {
+    if (summary.name == name) {
+      return &summary;
+    }
+  }
+  return nullptr;
+}
+}
+
+TEST(ProfilerTest, buckets_cover_every_duration_in_order) {
+  unsigned int previous = 0;
+  for (uint64_t nanoseconds = 1; nanoseconds < ((uint64_t) 1 << 40); nanoseconds = nanoseconds * 5 / 4 + 1) {
+    const unsigned int bucket = LatencyHistogram::bucket_of(nanoseconds);
+    ASSERT_GE(bucket, previous);
+    ASSERT_LT(bucket, LatencyHistogram::BUCKETS);
+    // The midpoint of a bucket is within an eighth of any duration in it
+    ASSERT_NEAR((double) LatencyHistogram::bucket_midpoint(bucket), (double) nanoseconds, nanoseconds / 8.0 + 1.0);
+    previous = bucket;
+  }
+  ASSERT_EQ(LatencyHistogram::bucket_of(~(uint64_t) 0), LatencyHistogram::BUCKETS - 1);
+}
+
+TEST(ProfilerTest, percentiles_of_uniform_durations) {
+  LatencyHistogram histogram;
+  for (uint64_t microseconds = 1; microseconds <= 1000; microseconds++) {
+    histogram.record(microseconds * 1000);
+  }
+
+  const LatencySnapshot snapshot = histogram.snapshot();
+  ASSERT_EQ(snapshot.count, 1000u);
+  ASSERT_EQ(snapshot.total, 500500000u);
+  ASSERT_EQ(snapshot.max, 1000000u);
+  ASSERT_NEAR((double) snapshot.percentile(0.50), 500000.0, 500000.0 / 8);
+  ASSERT_NEAR((double) snapshot.percentile(0.95), 950000.0, 950000.0 / 8);
+  ASSERT_NEAR((double) snapshot.percentile(0.99), 990000.0, 990000.0 / 8);
+  ASSERT_EQ(snapshot.percentile(1.0), 1000000u);
+  ASSERT_LE(snapshot.percentile(0.999), snapshot.max);
+
+  histogram.reset();
+  ASSERT_EQ(histogram.snapshot().count, 0u);
+  ASSERT_EQ(histogram.snapshot().percentile(0.5), 0u);
+}
+
+TEST(ProfilerTest, sums_stages_across_threads) {
+  if (!profiling_enabled()) {
+    GTEST_SKIP() << "Built without TRAFFIC_MONITOR_PROFILE";
+  }
+  profile_reset();
+  auto work = []() {
+    for (int i = 0; i < 10; i++) {
+      PROFILE_SCOPE("test.sleep");
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  };
+  std::thread other(work);
+  work();
+  other.join();
+
+  const std::vector<StageSummary> summaries = profile_summaries();
+  const StageSummary *stage = find_stage(summaries, "test.sleep");
+  ASSERT_NE(stage, nullptr);
+  ASSERT_EQ(stage->count, 20u);
+  ASSERT_GE(stage->p50, 0.0009);
+  ASSERT_LE(stage->p50, stage->p95);
+  ASSERT_LE(stage->p95, stage->p99);
+  ASSERT_LE(stage->p99, stage->max);
+  ASSERT_GE(stage->total, 0.018);
+
+  profile_reset();
+  ASSERT_EQ(find_stage(profile_summaries(), "test.sleep"), nullptr);
+}
+
+TEST(ProfilerTest, writes_chrome_trace_only_while_tracing) {
+  if (!profiling_enabled()) {
+    ASSERT_FALSE(profile_write_trace(trace_path));
+    GTEST_SKIP() << "Built without TRAFFIC_MONITOR_PROFILE";
+  }
+  profile_reset();
+  {
+    PROFILE_SCOPE("test.untraced");
+  }
+  profile_set_tracing(true);
+  std::thread traced([]() {
+    PROFILE_THREAD("test \"worker\"");
+    PROFILE_SCOPE("test.traced");
+  });
+  traced.join();
+  profile_set_tracing(false);
+
+  ASSERT_TRUE(profile_write_trace(trace_path));
+  std::ifstream file(trace_path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  const std::string trace = contents.str();
+  std::remove(trace_path.c_str());
+
+  ASSERT_EQ(trace.find("{\"traceEvents\":["), 0u);
+  ASSERT_NE(trace.find("\"name\":\"test.traced\",\"ph\":\"X\""), std::string::npos);
+  ASSERT_EQ(trace.find("test.untraced"), std::string::npos);
+  ASSERT_NE(trace.find("\"args\":{\"name\":\"test \\\"worker\\\"\"}"), std::string::npos);
+  ASSERT_NE(find_stage(profile_summaries(), "test.untraced"), nullptr);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include "QualityController.hpp"
+
+// Feeds the controller frames which take the given share of a 40 ms frame interval
+static int record_frames(QualityController &controller, double load, int frames) {
+  int changes = 0;
+  for (int i = 0; i < frames; i++) {
+    changes += controller.record(load * controller.get_frame_interval()) ? 1 : 0;
+  }
+  return changes;
+}
+
+static QualityController make_controller() {
+  QualityController controller;
+  controller.set_frame_interval(0.04);
+  controller.set_smoothing(1.0);
+  controller.set_degrade_frames(5);
+  controller.set_recover_frames(20);
+  return controller;
+}
+
+TEST(QualityControllerTest, stays_at_full_quality_with_headroom) {
+  QualityController controller = make_controller();
+  ASSERT_EQ(record_frames(controller, 0.5, 200), 0);
+  ASSERT_EQ(controller.get_level(), QualityLevel::FULL);
+  ASSERT_NEAR(controller.get_load(), 0.5, 1e-9);
+  ASSERT_NEAR(controller.get_average_seconds(), 0.02, 1e-9);
+}
+
+TEST(QualityControllerTest, degrades_one_step_at_a_time) {
+  QualityController controller = make_controller();
+  ASSERT_EQ(record_frames(controller, 1.5, 4), 0);
+  ASSERT_TRUE(controller.record(0.06));
+  ASSERT_EQ(controller.get_level(), QualityLevel::NO_PREVIEW);
+
+  // Every further step needs its own run of overloaded frames
+  ASSERT_EQ(record_frames(controller, 1.5, 4), 0);
+  ASSERT_EQ(record_frames(controller, 1.5, 1), 1);
+  ASSERT_EQ(controller.get_level(), QualityLevel::REDUCED_RESOLUTION);
+
+  ASSERT_EQ(record_frames(controller, 1.5, 100), 2);
+  ASSERT_EQ(controller.get_level(), QualityLevel::SKIP_FRAMES);
+  ASSERT_EQ(controller.get_degradations(), 4u);
+  ASSERT_EQ(controller.get_recoveries(), 0u);
+}
+
+TEST(QualityControllerTest, recovers_once_headroom_returns) {
+  QualityController controller = make_controller();
+  record_frames(controller, 1.5, 10);
+  ASSERT_EQ(controller.get_level(), QualityLevel::REDUCED_RESOLUTION);
+
+  // Between the two loads nothing changes
+  ASSERT_EQ(record_frames(controller, 0.75, 200), 0);
+  ASSERT_EQ(controller.get_level(), QualityLevel::REDUCED_RESOLUTION);
+
+  ASSERT_EQ(record_frames(controller, 0.3, 19), 0);
+  ASSERT_EQ(record_frames(controller, 0.3, 1), 1);
+  ASSERT_EQ(controller.get_level(), QualityLevel::NO_PREVIEW);
+  ASSERT_EQ(record_frames(controller, 0.3, 100), 1);
+  ASSERT_EQ(controller.get_level(), QualityLevel::FULL);
+  ASSERT_EQ(controller.get_recoveries(), 2u);
+}
+
+TEST(QualityControllerTest, a_single_slow_frame_is_smoothed_away) {
+  QualityController controller = make_controller();
+  controller.set_smoothing(0.1);
+  record_frames(controller, 0.5, 50);
+  ASSERT_EQ(record_frames(controller, 3.0, 1), 0);
+  ASSERT_EQ(record_frames(controller, 0.5, 50), 0);
+  ASSERT_EQ(controller.get_level(), QualityLevel::FULL);
+}
+
+TEST(QualityControllerTest, respects_max_level) {
+  QualityController controller = make_controller();
+  controller.set_max_level(QualityLevel::NO_PREVIEW);
+  record_frames(controller, 2.0, 100);
+  ASSERT_EQ(controller.get_level(), QualityLevel::NO_PREVIEW);
+  ASSERT_EQ(controller.get_degradations(), 1u);
+
+  controller.reset();
+  ASSERT_EQ(controller.get_level(), QualityLevel::FULL);
+  ASSERT_EQ(controller.get_degradations(), 0u);
+  ASSERT_STREQ(QualityController::level_name(QualityLevel::SPARSE_BACKGROUND), "sparse-background");
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "BackgroundSubtractor.hpp"
+#include "BlobExtractor.hpp"
+#include "RegionOfInterest.hpp"
+
+// A road running diagonally across the right half of a 320x240 frame
+static std::vector<cv::Point> road_polygon() {
+  return {cv::Point(150, 0), cv::Point(250, 0), cv::Point(340, 239), cv::Point(200, 239)};
+}
+
+TEST(RegionOfInterestTest, empty_region_covers_whole_frame) {
+  RegionOfInterest region;
+  region.prepare(cv::Size(320, 240));
+  ASSERT_TRUE(region.empty());
+  ASSERT_TRUE(region.is_rectangular());
+  ASSERT_EQ(region.get_bounding_rect(), cv::Rect(0, 0, 320, 240));
+}
+
+TEST(RegionOfInterestTest, bounding_rect_covers_all_polygons_within_frame) {
+  RegionOfInterest region;
+  region.add_polygon(road_polygon());
+  region.add_polygon({cv::Point(10, 100), cv::Point(40, 100), cv::Point(40, 130), cv::Point(10, 130)});
+  region.prepare(cv::Size(320, 240));
+  // The road extends past the right edge, so the box is clipped to the frame
+  ASSERT_EQ(region.get_bounding_rect(), cv::Rect(10, 0, 310, 240));
+  ASSERT_FALSE(region.is_rectangular());
+}
+
+TEST(RegionOfInterestTest, mask_marks_pixels_inside_polygons) {
+  RegionOfInterest region({road_polygon()});
+  region.prepare(cv::Size(320, 240));
+  const cv::Rect &rect = region.get_bounding_rect();
+  const cv::Mat &mask = region.get_mask();
+  ASSERT_EQ(mask.size(), rect.size());
+  // Frame pixels (200, 10) and (160, 200) lie on and off the road respectively
+  ASSERT_EQ(mask.at<uchar>(10 - rect.y, 200 - rect.x), 255);
+  ASSERT_EQ(mask.at<uchar>(200 - rect.y, 160 - rect.x), 0);
+
+  RegionOfInterest rectangle({{cv::Point(20, 30), cv::Point(99, 30), cv::Point(99, 79), cv::Point(20, 79)}});
+  rectangle.prepare(cv::Size(320, 240));
+  ASSERT_EQ(rectangle.get_bounding_rect(), cv::Rect(20, 30, 80, 50));
+  ASSERT_TRUE(rectangle.is_rectangular());
+}
+
+TEST(RegionOfInterestTest, subtractor_ignores_motion_outside_region) {
+  BackgroundSubtractor subtractor;
+  subtractor.set_engine(BackgroundEngine::RUNNING_AVERAGE);
+  subtractor.set_region_of_interest(RegionOfInterest({road_polygon()}));
+  cv::Mat frame(240, 320, CV_8UC3, cv::Scalar(50, 50, 50));
+  cv::Mat foreground;
+  subtractor.subtract(frame, foreground);
+
+  // A vehicle on the road and a tree swaying off it
+  cv::rectangle(frame, cv::Rect(200, 60, 60, 40), cv::Scalar(250, 250, 250), -1);
+  cv::rectangle(frame, cv::Rect(20, 150, 60, 40), cv::Scalar(250, 250, 250), -1);
+  subtractor.subtract(frame, foreground);
+
+  ASSERT_EQ(foreground.size(), frame.size());
+  ASSERT_EQ(subtractor.get_processed_rect(), cv::Rect(150, 0, 170, 240));
+  ASSERT_EQ(cv::countNonZero(foreground(cv::Rect(0, 0, 150, 240))), 0);
+  ASSERT_EQ(foreground.at<uchar>(80, 230), 255);
+}
+
+TEST(RegionOfInterestTest, blobs_come_out_in_frame_coordinates) {
+  BackgroundSubtractor subtractor;
+  subtractor.set_engine(BackgroundEngine::RUNNING_AVERAGE);
+  subtractor.set_region_of_interest(RegionOfInterest({road_polygon()}));
+  cv::Mat frame(240, 320, CV_8UC3, cv::Scalar(50, 50, 50));
+  cv::Mat foreground;
+  subtractor.subtract(frame, foreground);
+  cv::rectangle(frame, cv::Rect(200, 60, 60, 40), cv::Scalar(250, 250, 250), -1);
+  subtractor.subtract(frame, foreground);
+
+  BlobFilter filter;
+  filter.min_area = 500;
+  filter.min_width = 20;
+  filter.min_height = 20;
+  BlobExtractor extractor(filter);
+  std::vector<Blob> blobs;
+  const cv::Rect &rect = subtractor.get_processed_rect();
+  extractor.extract(foreground(rect), blobs, rect.tl(), 1.0);
+
+  ASSERT_EQ(blobs.size(), 1u);
+  // The 3x3 erode trims a pixel from each side and the 6x6 close shifts the result by one pixel
+  ASSERT_EQ(blobs.at(0).currentBoundingRect, cv::Rect(202, 62, 58, 38));
+}
+
+TEST(RegionOfInterestTest, scales_with_working_frame) {
+  RegionOfInterest region({road_polygon()});
+  const RegionOfInterest half = region.scaled(0.5);
+  ASSERT_EQ(half.get_polygons().size(), 1u);
+  ASSERT_EQ(half.get_polygons().front().at(1), cv::Point(125, 0));
+  ASSERT_EQ(half.get_polygons().front().at(3), cv::Point(100, 120));
+}
@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "SnapshotWriter.hpp"
+
+class SnapshotWriterTest : public ::testing::Test {
+ protected:
+  const std::string directory = "tests/snapshot_writer/";
+
+  virtual void TearDown() {
+    for (int id = 1; id <= 50; id++) {
+      std::remove((directory + std::to_string(id) + ".jpg").c_str());
+    }
+  }
+};
+
+TEST_F(SnapshotWriterTest, writes_crops_once_closed) {
+  SnapshotWriter writer;
+  writer.set_directory(directory);
+  writer.open();
+
+  cv::Mat frame(240, 320, CV_8UC3, cv::Scalar(30, 30, 30));
+  ASSERT_TRUE(writer.submit(frame, cv::Rect(10, 20, 60, 40), 1));
+  // The frame is reused for the next capture as soon as submit() returns
+  frame.setTo(cv::Scalar(255, 255, 255));
+  // Boxes are clipped to the frame
+  ASSERT_TRUE(writer.submit(frame, cv::Rect(300, 200, 60, 60), 2));
+  ASSERT_FALSE(writer.submit(frame, cv::Rect(400, 300, 10, 10), 3));
+  writer.close();
+
+  ASSERT_EQ(writer.get_written(), 2u);
+  cv::Mat first = cv::imread(directory + "1.jpg");
+  ASSERT_EQ(first.size(), cv::Size(60, 40));
+  ASSERT_LT(first.at<cv::Vec3b>(20, 30)[0], 60);
+  ASSERT_EQ(cv::imread(directory + "2.jpg").size(), cv::Size(20, 40));
+}
+
+TEST_F(SnapshotWriterTest, scales_down_to_max_dimension) {
+  SnapshotWriter writer;
+  writer.set_directory(directory);
+  writer.set_max_dimension(50);
+  writer.set_jpeg_quality(70);
+  writer.open();
+
+  cv::Mat frame(240, 320, CV_8UC3, cv::Scalar(90, 90, 90));
+  writer.submit(frame, cv::Rect(0, 0, 200, 100), 1);
+  writer.submit(frame, cv::Rect(0, 0, 40, 30), 2);
+  writer.close();
+
+  ASSERT_EQ(cv::imread(directory + "1.jpg").size(), cv::Size(50, 25));
+  ASSERT_EQ(cv::imread(directory + "2.jpg").size(), cv::Size(40, 30));
+}
+
+TEST_F(SnapshotWriterTest, counts_every_snapshot_written_or_dropped) {
+  SnapshotWriter writer;
+  writer.set_directory(directory);
+  writer.set_workers(1);
+  writer.set_capacity(1);
+  writer.open();
+
+  cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(120, 60, 30));
+  int accepted = 0;
+  for (unsigned int id = 1; id <= 50; id++) {
+    accepted += writer.submit(frame, cv::Rect(0, 0, 640, 480), id) ? 1 : 0;
+  }
+  writer.close();
+
+  ASSERT_EQ(writer.get_written(), (unsigned long long) accepted);
+  ASSERT_EQ(writer.get_written() + writer.get_dropped(), 50u);
+  ASSERT_FALSE(writer.submit(frame, cv::Rect(0, 0, 10, 10), 1));
+}
@@ -0,0 +1,62 @@
+#include <cstdlib>
+
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "SpatialGrid.hpp"
+
+TEST(SpatialGridTest, find_nearest_within_radius) {
+  SpatialGrid grid(50);
+  grid.insert(cv::Point(100, 100), 0);
+  grid.insert(cv::Point(130, 100), 1);
+  grid.insert(cv::Point(400, 400), 2);
+  grid.build();
+
+  ASSERT_EQ(grid.find_nearest(cv::Point(125, 100), 20.0), 1);
+  ASSERT_EQ(grid.find_nearest(cv::Point(105, 100), 20.0), 0);
+  ASSERT_EQ(grid.find_nearest(cv::Point(250, 250), 20.0), -1);
+}
+
+TEST(SpatialGridTest, radius_is_exclusive) {
+  SpatialGrid grid(10);
+  grid.insert(cv::Point(0, 0), 0);
+  grid.build();
+
+  ASSERT_EQ(grid.find_nearest(cv::Point(3, 4), 5.0), -1);
+  ASSERT_EQ(grid.find_nearest(cv::Point(3, 4), 5.01), 0);
+}
+
+TEST(SpatialGridTest, negative_coordinates) {
+  SpatialGrid grid(16);
+  grid.insert(cv::Point(-20, -5), 0);
+  grid.build();
+
+  ASSERT_EQ(grid.find_nearest(cv::Point(-12, -1), 10.0), 0);
+}
+
+TEST(SpatialGridTest, matches_linear_scan) {
+  std::srand(42);
+  for (int trial = 0; trial < 200; trial++) {
+    SpatialGrid grid(1 + std::rand() % 80);
+    std::vector<cv::Point> points;
+    for (int i = 0; i < 40; i++) {
+      points.emplace_back(cv::Point(std::rand() % 700 - 30, std::rand() % 500 - 30));
+      grid.insert(points.back(), i);
+    }
+    grid.build();
+
+    cv::Point query(std::rand() % 700 - 30, std::rand() % 500 - 30);
+    double radius = (std::rand() % 2000) / 10.0;
+
+    int expected = -1;
+    long long least_distance = 0;
+    for (int i = 0; i < (int) points.size(); i++) {
+      long long distance = SpatialGrid::squared_distance(query, points[i]);
+      if (distance < radius * radius && (expected < 0 || distance < least_distance)) {
+        expected = i;
+        least_distance = distance;
+      }
+    }
+    ASSERT_EQ(grid.find_nearest(query, radius), expected);
+  }
+}
@@ -0,0 +1,104 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "SpeedEventLog.hpp"
+
+class SpeedEventLogTest : public ::testing::Test {
+ protected:
+  const std::string path = "tests/speed_event_log/test_speed.log";
+
+  virtual void SetUp() {
+    std::remove(path.c_str());
+  }
+
+  virtual void TearDown() {
+    std::remove(path.c_str());
+  }
+
+  std::vector<std::string> read_lines() {
+    std::ifstream in_file(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in_file, line)) {
+      lines.push_back(line);
+    }
+    return lines;
+  }
+};
+
+static SpeedEvent make_event(unsigned int id, double speed) {
+  SpeedEvent event;
+  event.vehicle_id = id;
+  event.start_time = 10.0;
+  event.end_time = 11.25;
+  event.start_frame = 300;
+  event.end_frame = 337;
+  event.moving_left = true;
+  event.speed = speed;
+  event.speed_error = 0.5;
+  return event;
+}
+
+TEST_F(SpeedEventLogTest, writes_every_event_in_order_on_close) {
+  SpeedEventLog log;
+  log.set_path(path);
+  log.set_flush_interval(60.0);
+  log.set_flush_count(8);
+  ASSERT_TRUE(log.open());
+  for (unsigned int id = 1; id <= 20; id++) {
+    ASSERT_TRUE(log.log(make_event(id, 60)));
+  }
+  log.close();
+
+  std::vector<std::string> lines = read_lines();
+  ASSERT_EQ(lines.size(), 20u);
+  ASSERT_EQ(lines.front(), "1 60");
+  ASSERT_EQ(lines.back(), "20 60");
+  ASSERT_EQ(log.get_written(), 20u);
+  ASSERT_EQ(log.get_dropped(), 0u);
+  // Two full batches of 8, and the remaining 4 when closed
+  ASSERT_EQ(log.get_flushes(), 3u);
+}
+
+TEST_F(SpeedEventLogTest, csv_header_is_written_once) {
+  SpeedEventLog log;
+  log.set_path(path);
+  log.set_format(SpeedLogFormat::CSV);
+  ASSERT_TRUE(log.open());
+  log.log(make_event(1, 48.5));
+  log.close();
+  ASSERT_TRUE(log.open());
+  log.log(make_event(2, 52.0));
+  log.close();
+
+  std::vector<std::string> lines = read_lines();
+  ASSERT_EQ(lines.size(), 3u);
+  ASSERT_EQ(lines[0], "vehicle_id,start_time,end_time,start_frame,end_frame,direction,speed_kmh,speed_error_kmh");
+  ASSERT_EQ(lines[1], "1,10.000,11.250,300,337,left,48.50,0.50");
+  ASSERT_EQ(lines[2], "2,10.000,11.250,300,337,left,52.00,0.50");
+}
+
+TEST_F(SpeedEventLogTest, formats_json_lines) {
+  std::string line;
+  SpeedEventLog::format_event(make_event(7, 61.234), SpeedLogFormat::JSON_LINES, line);
+  ASSERT_EQ(line, "{\"vehicle_id\":7,\"start_time\":10.000,\"end_time\":11.250,\"start_frame\":300,"
+                  "\"end_frame\":337,\"direction\":\"left\",\"speed_kmh\":61.23,\"speed_error_kmh\":0.50}\n");
+
+  SpeedLogFormat format;
+  ASSERT_TRUE(SpeedEventLog::parse_format("jsonl", format));
+  ASSERT_EQ(format, SpeedLogFormat::JSON_LINES);
+  ASSERT_FALSE(SpeedEventLog::parse_format("xml", format));
+}
+
+TEST_F(SpeedEventLogTest, rejects_events_while_closed) {
+  SpeedEventLog log;
+  ASSERT_FALSE(log.log(make_event(1, 60)));
+
+  log.set_path("tests/speed_event_log/missing/speed.log");
+  ASSERT_FALSE(log.open());
+  ASSERT_FALSE(log.is_open());
+}
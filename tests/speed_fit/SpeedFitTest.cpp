@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include "SpeedFit.hpp"
+
+TEST(SpeedFitTest, recovers_constant_speed_exactly) {
+  SpeedFit fit;
+  // Driver timestamps are large, so precision must not depend on their magnitude
+  for (int i = 0; i < 10; i++) {
+    fit.add(86400.0 + i / 15.0, 600.0 - 20.0 * i);
+  }
+  ASSERT_TRUE(fit.is_valid());
+  ASSERT_EQ(fit.get_samples(), 10u);
+  ASSERT_NEAR(fit.get_slope(), -300.0, 1e-6);
+  ASSERT_NEAR(fit.get_slope_error(), 0.0, 1e-6);
+  ASSERT_NEAR(fit.get_residual(), 0.0, 1e-6);
+}
+
+TEST(SpeedFitTest, averages_out_position_noise) {
+  SpeedFit fit;
+  const double noise[] = {2.0, -3.0, 1.0, 0.0, -1.0, 3.0, -2.0, 1.0, -1.0, 0.0};
+  for (int i = 0; i < 10; i++) {
+    fit.add(i / 30.0, 100.0 + 10.0 * i + noise[i]);
+  }
+  // Timing the same pass from its first and last positions alone would give 293 px/s
+  ASSERT_NEAR(fit.get_slope(), 300.0, 15.0);
+  ASSERT_GT(fit.get_slope_error(), 0.0);
+  ASSERT_GT(fit.get_residual(), 1.0);
+  ASSERT_LT(fit.get_residual(), 3.0);
+}
+
+TEST(SpeedFitTest, needs_three_samples_at_distinct_times) {
+  SpeedFit fit;
+  fit.add(0.0, 0.0);
+  fit.add(0.1, 10.0);
+  ASSERT_FALSE(fit.is_valid());
+  ASSERT_NEAR(fit.get_slope(), 100.0, 1e-9);
+
+  fit.reset();
+  for (int i = 0; i < 5; i++) {
+    fit.add(1.0, i);
+  }
+  ASSERT_FALSE(fit.is_valid());
+  ASSERT_EQ(fit.get_slope(), 0.0);
+}
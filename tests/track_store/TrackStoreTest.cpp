@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "TrackStore.hpp"
+
+static Blob make_blob(int x, int y) {
+  std::vector<cv::Point> contour;
+  contour.emplace_back(cv::Point(x, y));
+  contour.emplace_back(cv::Point(x + 60, y));
+  contour.emplace_back(cv::Point(x + 60, y + 60));
+  contour.emplace_back(cv::Point(x, y + 60));
+  return Blob(contour);
+}
+
+TEST(TrackStoreTest, compact_retires_dead_blobs) {
+  TrackStore store;
+  store.get_blobs().push_back(make_blob(0, 0));
+  store.get_blobs().push_back(make_blob(100, 100));
+  store.get_blobs().push_back(make_blob(200, 200));
+  store.get_blobs().at(1).blnStillBeingTracked = false;
+
+  ASSERT_EQ(store.compact(), 1u);
+  ASSERT_EQ(store.get_blobs().size(), 2u);
+  ASSERT_EQ(store.get_blobs().at(1).currentBoundingRect.x, 200);
+  ASSERT_EQ(store.get_retired_count(), 1u);
+}
+
+TEST(TrackStoreTest, compact_caps_history) {
+  TrackStore store(5, 16 * 1024 * 1024);
+  Blob blob = make_blob(0, 0);
+  for (int i = 1; i < 20; i++) {
+    blob.centerPositions.push_back(cv::Point(30 + i, 30));
+  }
+  store.get_blobs().push_back(blob);
+
+  store.compact();
+  const Blob &stored = store.get_blobs().front();
+  ASSERT_EQ(stored.centerPositions.size(), 5u);
+  ASSERT_EQ(stored.centerPositions.back().x, 49);
+  ASSERT_EQ(stored.origin_position.x, 30);
+}
+
+TEST(TrackStoreTest, compact_respects_memory_ceiling) {
+  Blob stale = make_blob(0, 0);
+  stale.intNumOfConsecutiveFramesWithoutAMatch = 3;
+  Blob fresh = make_blob(100, 100);
+
+  TrackStore store(8, TrackStore::estimated_memory(fresh));
+  store.get_blobs().push_back(stale);
+  store.get_blobs().push_back(fresh);
+
+  ASSERT_EQ(store.compact(), 1u);
+  ASSERT_EQ(store.get_blobs().size(), 1u);
+  ASSERT_EQ(store.get_blobs().front().currentBoundingRect.x, 100);
+  ASSERT_LE(store.estimated_memory(), store.get_memory_ceiling());
+}
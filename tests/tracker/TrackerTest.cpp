@@ -15,8 +15,72 @@ class TrackerTest : public ::testing::Test {
   }
 };
 
+static Blob make_square_blob(int x, int y) {
+  std::vector<cv::Point> contour;
+  contour.emplace_back(cv::Point(x, y));
+  contour.emplace_back(cv::Point(x + 60, y));
+  contour.emplace_back(cv::Point(x + 60, y + 60));
+  contour.emplace_back(cv::Point(x, y + 60));
+  return Blob(contour);
+}
+
 TEST_F(TrackerTest, match_current_frame_to_existing_blobs) {
+  std::vector<Blob> existing_blobs;
+  existing_blobs.push_back(make_square_blob(100, 100));
+  existing_blobs.push_back(make_square_blob(400, 100));
 
+  // The first blob moved slightly, the second vanished and a new blob appeared far from both
+  std::vector<Blob> current_blobs;
+  current_blobs.push_back(make_square_blob(105, 100));
+  current_blobs.push_back(make_square_blob(250, 300));
+
+  tracker.match_current_frame_to_existing_blobs(existing_blobs, current_blobs);
+
+  ASSERT_EQ(existing_blobs.size(), 3u);
+  ASSERT_EQ(existing_blobs.at(0).currentBoundingRect.x, 105);
+  ASSERT_EQ(existing_blobs.at(0).centerPositions.size(), 2u);
+  ASSERT_TRUE(existing_blobs.at(0).blnCurrentMatchFoundOrNewBlob);
+  ASSERT_FALSE(existing_blobs.at(1).blnCurrentMatchFoundOrNewBlob);
+  ASSERT_EQ(existing_blobs.at(1).intNumOfConsecutiveFramesWithoutAMatch, 1);
+  ASSERT_EQ(existing_blobs.at(2).currentBoundingRect.x, 250);
+}
+
+TEST_F(TrackerTest, predicts_tracked_blobs_from_their_motion) {
+  std::vector<Blob> existing_blobs;
+  for (int frame = 0; frame < 10; frame++) {
+    std::vector<Blob> current_blobs;
+    current_blobs.push_back(make_square_blob(100 + 12 * frame, 100));
+    tracker.match_current_frame_to_existing_blobs(existing_blobs, current_blobs);
+  }
+
+  // A single track follows the blob and, having learnt its velocity, expects it one step further along
+  ASSERT_EQ(existing_blobs.size(), 1u);
+  std::vector<Blob> current_blobs;
+  current_blobs.push_back(make_square_blob(100 + 12 * 10, 100));
+  tracker.match_current_frame_to_existing_blobs(existing_blobs, current_blobs);
+  ASSERT_NEAR(existing_blobs.at(0).predictedNextPosition.x, 130 + 12 * 10, 2);
+  ASSERT_EQ(existing_blobs.at(0).predictedNextPosition.y, 130);
+  ASSERT_FALSE(existing_blobs.at(0).moving_left);
+}
+
+TEST_F(TrackerTest, global_matching_claims_each_track_once) {
+  tracker.set_matching_strategy(MatchingStrategy::GLOBAL);
+
+  std::vector<Blob> existing_blobs;
+  existing_blobs.push_back(make_square_blob(100, 100));
+
+  // Both blobs are within the gate of the single track, but only the closer one may continue it
+  std::vector<Blob> current_blobs;
+  current_blobs.push_back(make_square_blob(120, 100));
+  current_blobs.push_back(make_square_blob(105, 100));
+
+  tracker.match_current_frame_to_existing_blobs(existing_blobs, current_blobs);
+
+  ASSERT_EQ(existing_blobs.size(), 2u);
+  ASSERT_EQ(existing_blobs.at(0).currentBoundingRect.x, 105);
+  ASSERT_EQ(existing_blobs.at(0).centerPositions.size(), 2u);
+  ASSERT_EQ(existing_blobs.at(1).currentBoundingRect.x, 120);
+  ASSERT_EQ(existing_blobs.at(1).centerPositions.size(), 1u);
 }
 
 TEST_F(TrackerTest, add_new_blob) {
@@ -50,8 +114,11 @@ TEST_F(TrackerTest, add_blob_to_existing_blobs) {
   tracker.add_new_blob(test_blob, existing_blobs);
   tracker.add_new_blob(test_blob, existing_blobs);
 
+  // A match ends a run of frames without one
+  existing_blobs.at(0).intNumOfConsecutiveFramesWithoutAMatch = 3;
   int blob_idx = 0;
   tracker.add_blob_to_existing_blobs(test_blob, existing_blobs, blob_idx);
+  ASSERT_EQ(existing_blobs.at(0).intNumOfConsecutiveFramesWithoutAMatch, 0);
 
   blob_idx = 1;
   tracker.add_blob_to_existing_blobs(test_blob, existing_blobs, blob_idx);
@@ -91,6 +158,51 @@ TEST_F(TrackerTest, calculate_speed) {
   ASSERT_DOUBLE_EQ(test_blob.speed, TRUE_SPEED);
 }
 
+TEST_F(TrackerTest, calculate_speed_from_timestamps) {
+  tracker.set_fps(30);
+  std::vector<cv::Point> contour;
+  contour.emplace_back(cv::Point(381, 145));
+  contour.emplace_back(cv::Point(379, 140));
+  Blob test_blob(contour);
+  // 120 frames apart, but frames were dropped on the way so 4.5 seconds passed rather than 4
+  test_blob.start_frame = 10;
+  test_blob.end_frame = 130;
+  test_blob.start_time = 0.5;
+  test_blob.end_time = 5.0;
+  test_blob.start_dist = 381;
+  test_blob.currentBoundingRect.x = 600;
+  test_blob.currentBoundingRect.width = 60;
+
+  tracker.calculate_speed(test_blob, 15);
+  ASSERT_DOUBLE_EQ(test_blob.speed, 16.74);
+
+  tracker.set_speed_timing(SpeedTiming::TIMESTAMPS);
+  tracker.calculate_speed(test_blob, 15);
+  ASSERT_DOUBLE_EQ(test_blob.speed, 14.88);
+}
+
+TEST_F(TrackerTest, calculate_speed_from_fitted_positions) {
+  tracker.set_fps(30);
+  std::vector<cv::Point> contour;
+  contour.emplace_back(cv::Point(381, 145));
+  contour.emplace_back(cv::Point(379, 140));
+  Blob test_blob(contour);
+  test_blob.start_frame = 10;
+  test_blob.end_frame = 130;
+  test_blob.start_dist = 381;
+  test_blob.currentBoundingRect.x = 600;
+  test_blob.currentBoundingRect.width = 60;
+  // 15 m/s at 15 pixels per meter, sampled at 15 fps
+  for (int i = 0; i < 8; i++) {
+    test_blob.speed_fit.add(i / 15.0, 400 + 15 * i);
+  }
+
+  tracker.calculate_speed(test_blob, 15);
+  ASSERT_NEAR(test_blob.speed, 54.0, 1e-9);
+  ASSERT_NEAR(test_blob.speed_error, 0.0, 1e-6);
+  ASSERT_NEAR(test_blob.speed_residual, 0.0, 1e-6);
+}
+
 TEST_F(TrackerTest, track_car_speed) {
 
 }
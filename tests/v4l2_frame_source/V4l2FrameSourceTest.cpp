@@ -0,0 +1,129 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "V4l2FrameSource.hpp"
+
+namespace {
+/**
+ * Finds the vivid virtual camera, loaded with modprobe vivid. Tests which need a camera are skipped without one.
+ */
+std::string find_vivid() {
+  for (int i = 0; i < 64; i++) {
+    const std::string path = "/dev/video" + std::to_string(i);
+    if (V4l2FrameSource::is_vivid(path)) {
+      return path;
+    }
+  }
+  return "";
+}
+}
+
+TEST(V4l2FrameSourceTest, missing_device_fails_to_open) {
+  V4l2FrameSource source("/dev/video-missing");
+  ASSERT_FALSE(source.open());
+  ASSERT_FALSE(source.is_open());
+  SourceFrame frame;
+  ASSERT_FALSE(source.read(frame));
+}
+
+TEST(V4l2FrameSourceTest, streams_numbered_timestamped_frames) {
+  const std::string path = find_vivid();
+  if (path.empty()) {
+    GTEST_SKIP() << "no vivid device";
+  }
+  V4l2FrameSource source(path);
+  source.set_requested_size(cv::Size(640, 480));
+  source.set_raw_requested(true);
+  ASSERT_TRUE(source.open());
+  ASSERT_TRUE(source.is_raw());
+  ASSERT_EQ(source.get_frame_size(), cv::Size(640, 480));
+
+  SourceFrame frame;
+  unsigned int previous_index = 0;
+  double previous_timestamp = 0.0;
+  unsigned long long gaps = 0;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(source.read(frame));
+    ASSERT_EQ(frame.image.size(), source.get_frame_size());
+    ASSERT_TRUE(frame.image.type() == CV_8UC2 || frame.image.type() == CV_8UC1);
+    if (i == 0) {
+      ASSERT_EQ(frame.index, 0u);
+    } else {
+      ASSERT_GT(frame.index, previous_index);
+      ASSERT_GT(frame.timestamp, previous_timestamp);
+      gaps += frame.index - previous_index - 1;
+    }
+    previous_index = frame.index;
+    previous_timestamp = frame.timestamp;
+  }
+  ASSERT_EQ(source.get_dropped_frames(), gaps);
+  source.close();
+}
+
+TEST(V4l2FrameSourceTest, leased_buffers_return_to_driver) {
+  const std::string path = find_vivid();
+  if (path.empty()) {
+    GTEST_SKIP() << "no vivid device";
+  }
+  V4l2FrameSource source(path);
+  source.set_buffer_count(4);
+  source.set_reserved_buffers(1);
+  source.set_raw_requested(true);
+  ASSERT_TRUE(source.open());
+  const unsigned int mapped = source.get_mapped_buffers();
+  ASSERT_GE(mapped, 2u);
+
+  SourceFrame frame;
+  ASSERT_TRUE(source.read(frame));
+  ASSERT_NE(frame.lease, nullptr);
+  ASSERT_EQ(source.get_queued_buffers(), mapped - 1);
+
+  frame.lease.reset();
+  ASSERT_EQ(source.get_queued_buffers(), mapped);
+  source.close();
+}
+
+TEST(V4l2FrameSourceTest, copies_frames_rather_than_starve_the_driver) {
+  const std::string path = find_vivid();
+  if (path.empty()) {
+    GTEST_SKIP() << "no vivid device";
+  }
+  V4l2FrameSource source(path);
+  source.set_buffer_count(4);
+  source.set_reserved_buffers(2);
+  source.set_raw_requested(true);
+  ASSERT_TRUE(source.open());
+  const unsigned int mapped = source.get_mapped_buffers();
+
+  // Every frame is held, as a stalled pipeline would. The camera must keep delivering regardless.
+  std::vector<SourceFrame> held(mapped + 4);
+  for (SourceFrame &frame : held) {
+    ASSERT_TRUE(source.read(frame));
+    ASSERT_GE(source.get_queued_buffers(), 1u);
+  }
+  ASSERT_GT(source.get_copied_frames(), 0u);
+  ASSERT_EQ(held.back().lease, nullptr);
+
+  held.clear();
+  ASSERT_EQ(source.get_queued_buffers(), mapped);
+  source.close();
+}
+
+TEST(V4l2FrameSourceTest, converts_to_bgr_unless_raw_requested) {
+  const std::string path = find_vivid();
+  if (path.empty()) {
+    GTEST_SKIP() << "no vivid device";
+  }
+  V4l2FrameSource source(path);
+  ASSERT_TRUE(source.open());
+  ASSERT_FALSE(source.is_raw());
+
+  SourceFrame frame;
+  ASSERT_TRUE(source.read(frame));
+  ASSERT_EQ(frame.image.type(), CV_8UC3);
+  ASSERT_EQ(frame.lease, nullptr);
+  ASSERT_EQ(source.get_queued_buffers(), source.get_mapped_buffers());
+  source.close();
+}